@@ -45,10 +45,12 @@ namespace amr {
       struct Interval {
         int lo, hi;
       };
-      std::array<std::deque<Interval>, 3> intervals;
+      // at most two intervals per dimension, kept inline to avoid allocating
+      Interval intervals[3][2];
+      int interval_n[3] = {0, 0, 0};
       for (int d = 0; d < 3; ++d) {
         if (box.hi[d] - box.lo[d] >= sd.size()[d]) {
-          intervals[d].push_back( Interval{sd.lo[d], sd.hi[d]} );
+          intervals[d][interval_n[d]++] = Interval{sd.lo[d], sd.hi[d]};
         } else {
           // lambda to periodic-wrap x into [lo, hi)
           auto wrap_into = [](int x, int lo, int hi) {
@@ -58,16 +60,19 @@ namespace amr {
           int lo = wrap_into(box.lo[d], sd.lo[d]  , sd.hi[d]  ),
               hi = wrap_into(box.hi[d], sd.lo[d]+1, sd.hi[d]+1);
           if (lo <= hi) {
-            intervals[d].push_back( Interval{lo, hi} );
+            intervals[d][interval_n[d]++] = Interval{lo, hi};
           } else {
-            intervals[d].push_back( Interval{sd.lo[d], hi} );
-            intervals[d].push_back( Interval{lo, sd.hi[d]} );
+            intervals[d][interval_n[d]++] = Interval{sd.lo[d], hi};
+            intervals[d][interval_n[d]++] = Interval{lo, sd.hi[d]};
           }
         }
       }
-      for (auto int0 : intervals[0]) {
-        for (auto int1 : intervals[1]) {
-          for (auto int2 : intervals[2]) {
+      for (int i0 = 0; i0 < interval_n[0]; ++i0) {
+        for (int i1 = 0; i1 < interval_n[1]; ++i1) {
+          for (int i2 = 0; i2 < interval_n[2]; ++i2) {
+            const Interval &int0 = intervals[0][i0],
+                           &int1 = intervals[1][i1],
+                           &int2 = intervals[2][i2];
             ans.push_back( Box{ Pt<int>{ int0.lo, int1.lo, int2.lo },
                                 Pt<int>{ int0.hi, int1.hi, int2.hi } } );
           }
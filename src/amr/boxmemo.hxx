@@ -105,6 +105,9 @@ namespace amr {
   // Call with:
   //   memo(boxes, ix, args...)
   //
+  // or get every ix's result at once, as an array indexed by ix, with:
+  //   memo.all(boxes, args...)
+  //
   template<class ...Args>
   class BoxMemoBytes {
     typedef typename Weaken<std::tuple<Imm<BoxList>,Args...>>::type Key;
@@ -129,7 +132,16 @@ namespace amr {
     }
     BoxMemoBytes(BoxMemoBytes<Args...>&&) = default;
     
+  private:
+    Vals& _vals(const Imm<BoxList> &boxes, const Args&...args);
+    std::uint8_t* _fill(Vals &vals, const Imm<BoxList> &boxes, int ix, const Args&...args);
+    
+  public:
     std::uint8_t* operator()(const Imm<BoxList> &boxes, int ix, const Args&...args);
+    
+    // The array stays valid, and reading it touches nothing else, for as
+    // long as `boxes` and `args` live.
+    std::uint8_t* const* all(const Imm<BoxList> &boxes, const Args&...args);
   };
 
   
@@ -143,19 +155,25 @@ namespace amr {
   }
   
   template<class ...Args>
-  std::uint8_t* BoxMemoBytes<Args...>::operator()(
+  typename BoxMemoBytes<Args...>::Vals& BoxMemoBytes<Args...>::_vals(
       const Imm<BoxList> &boxes,
-      int ix,
       const Args &...args
     ) {
-    
-    Vals &vals = _map.at(
+    return _map.at(
       std::tuple<Imm<BoxList> const&, Args const&...>(boxes, args...),
       [&](void *p) {
         ::new(p) Vals(boxes->size());
       }
     );
-    
+  }
+  
+  template<class ...Args>
+  std::uint8_t* BoxMemoBytes<Args...>::_fill(
+      Vals &vals,
+      const Imm<BoxList> &boxes,
+      int ix,
+      const Args &...args
+    ) {
     if(vals.ptrs[ix] == nullptr) {
       vals.ptrs[ix] = _fn(
         [&](std::size_t sz) { return (std::uint8_t*)vals.pile.push(sz, 1); },
@@ -165,5 +183,25 @@ namespace amr {
     
     return vals.ptrs[ix];
   }
+  
+  template<class ...Args>
+  std::uint8_t* BoxMemoBytes<Args...>::operator()(
+      const Imm<BoxList> &boxes,
+      int ix,
+      const Args &...args
+    ) {
+    return _fill(_vals(boxes, args...), boxes, ix, args...);
+  }
+  
+  template<class ...Args>
+  std::uint8_t* const* BoxMemoBytes<Args...>::all(
+      const Imm<BoxList> &boxes,
+      const Args &...args
+    ) {
+    Vals &vals = _vals(boxes, args...);
+    for(std::size_t ix=0; ix < vals.n; ix++)
+      _fill(vals, boxes, int(ix), args...);
+    return vals.ptrs.get();
+  }
 }}
 #endif
@@ -2,11 +2,20 @@
 #include "boxmemo.hxx"
 #include "lowlevel/memo.hxx"
 
+#include <mutex>
+
 using namespace programr;
 using namespace programr::amr;
 using namespace programr::amr::boxtree;
 using namespace std;
 
+namespace {
+  // Guards the memo tables below, and the temporary Ref's their lookups
+  // build for keys. Queries handed boxtree::Lists skip the tables, and so
+  // this lock, entirely.
+  mutex memo_lock;
+}
+
 tuple<vector<Level>, Box>
 boxtree::make_octree_full(
     int lev_n,
@@ -146,6 +155,7 @@ namespace {
 }
 
 Level boxtree::coarsened(const Level &lev, int factor_log2) {
+  lock_guard<mutex> lock(memo_lock);
   return _m_coarsen(lev.boxes, lev.cell_scale_log2, lev.box_scale_log2, factor_log2);
 }
 
@@ -179,6 +189,7 @@ namespace {
 }
 
 ByteSeqPtr boxtree::siblings(const Level &lev, int ix, Boundary *bdry) {
+  lock_guard<mutex> lock(memo_lock);
   return ByteSeqPtr{_m_siblings(lev.boxes, ix, lev.cell_scale_log2, lev.box_scale_log2, bdry)};
 }
 
@@ -224,6 +235,7 @@ ByteSeqPtr boxtree::parents(
     Boundary *bdry,
     bool neighboring
   ) {
+  lock_guard<mutex> lock(memo_lock);
   return ByteSeqPtr{_m_parents(
     kids.boxes, kid_ix, neighboring,
     kids.cell_scale_log2, kids.box_scale_log2,
@@ -257,127 +269,156 @@ ByteSeqPtr boxtree::children(
     int par_ix
   ) {
   int delta_box_s = kids.box_scale_log2 - pars.box_scale_log2;
+  lock_guard<mutex> lock(memo_lock);
   return ByteSeqPtr{_m_children(pars.boxes, par_ix, delta_box_s, kids.boxes)};
 }
 
 
 ////////////////////////////////////////////////////////////////////////
-// boxtree::deps_halo
+// boxtree::lists_*
 
 namespace {
-  vector<tuple<int/*lev=0,-1*/, int/*box_ix*/, Box>>
-  _deps_halo(
-      Imm<BoxList> kids,
-      int kid_ix,
-      int8_t kids_cell_s, int8_t kids_box_s,
-      int8_t pars_cell_s, int8_t pars_box_s,
-      int8_t halo,
-      int8_t prolong_halo,
-      Imm<BoxList> pars,
-      Ref<Boundary> bdry,
-      bool flag_faces_only
-    ) {
-    
-    vector<tuple<int/*lev*/,int/*box_i*/,Box>> ans;
-    
-    Box kid_box = (*kids)[kid_ix];
-    
-    // inflate kid_box by halo and then map to the domain's interior
-    deque<Box> inside;
-    if (flag_faces_only) {
-      auto kid_fat = kid_box.inflated_faces((int)halo<<(kids_box_s-kids_cell_s));
-      inside = bdry->internalize(kids_box_s, kid_fat);
-    } else {
-      Box kid_fat = kid_box.inflated((int)halo<<(kids_box_s-kids_cell_s));
-      inside = bdry->internalize(kids_box_s, kid_fat);
-    }
-    deque<Box> gaps = inside;
-    
-    //cout << "halo kidbox " << kid_box << '\n';
-    
-    // walk siblings
-    boxtree::siblings(
-      Level{kids, kids_cell_s, kids_box_s},
-      kid_ix, bdry
-    )
-    .for_bit1(
-      [&](int sib_ix)->bool {
-        Box sib_box = (*kids)[sib_ix];
-        //cout << " sibbox " << sib_box << '\n';
-        for(const Box &x: inside) {
-          Box z = Box::intersection(x, sib_box);
-          if(!z.is_empty()) {
-            ans.push_back(make_tuple(0, sib_ix, z));
-            Box::subtract(gaps, z);
-          }
-        }
-        return true;
-      }
+  uint8_t* const* all_parents(const Level &kids, const Level &pars, Boundary *bdry) {
+    return _m_parents.all(
+      kids.boxes, /*neighboring=*/true,
+      kids.cell_scale_log2, kids.box_scale_log2,
+      pars.cell_scale_log2, pars.box_scale_log2,
+      pars.boxes, bdry
     );
-    
-    if(pars) {
-      // remove kid from gaps before ascending
-      Box::subtract(gaps, kid_box);
-      
-      deque<Box> par_gaps; // gaps projected to coarser level, inflated by prolong_halo, then unioned
-      for(Box x: gaps) {
-        // project boxes onto parent level
-        x = x.scaled_pow2(pars_box_s - kids_box_s);
-        
-        if(prolong_halo != 0) {
-          // inflate by prolong halo
-          x = x.inflated((int)prolong_halo<<(pars_box_s-pars_cell_s));
-          // add to par_gaps
-          Box::unify(par_gaps, x);
-        }
-        else // performance shortcut
-          par_gaps.push_back(x);
-      }
-      
-      // walk over parents of kid
-      boxtree::parents(
-        Level{kids, kids_cell_s, kids_box_s},
-        Level{pars, pars_cell_s, pars_box_s},
-        kid_ix, bdry, /*neighboring=*/true
-      )
-      .for_bit1([&](int par_ix)->bool {
-        Box par_box = (*pars)[par_ix];
-        //cout << " parbox " << par_box << '\n';
-        for(Box x: par_gaps) {
-          Box z = Box::intersection(x, par_box);
-          if(!z.is_empty()) {
-            //cout << "  isect " << z << '\n';
-            ans.push_back(make_tuple(-1, par_ix, z));
-          }
-        }
-        return true;
-      });
-    }
-    
-    return ans;
   }
 }
 
+Lists boxtree::lists_halo(const Level &kids, const Level *pars, Boundary *bdry) {
+  lock_guard<mutex> lock(memo_lock);
+  Lists ans;
+  ans.siblings = _m_siblings.all(kids.boxes, kids.cell_scale_log2, kids.box_scale_log2, bdry);
+  if(pars)
+    ans.parents = all_parents(kids, *pars, bdry);
+  return ans;
+}
+
+Lists boxtree::lists_restrict(const Level &kids, const Level &pars) {
+  int delta_box_s = kids.box_scale_log2 - pars.box_scale_log2;
+  lock_guard<mutex> lock(memo_lock);
+  Lists ans;
+  ans.children = _m_children.all(pars.boxes, delta_box_s, kids.boxes);
+  return ans;
+}
+
+Lists boxtree::lists_prolong(const Level &kids, const Level &pars, Boundary *bdry) {
+  lock_guard<mutex> lock(memo_lock);
+  Lists ans;
+  ans.parents = all_parents(kids, pars, bdry);
+  return ans;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// boxtree::deps_halo
+
 vector<tuple<int,int,Box>>
 boxtree::deps_halo(
     const Level &kids,
     const Level *pars,
-    int kid_ix, // child level box index
+    int kid_ix,
     int halo,
     Boundary *bdry,
     int prolong_halo,
     bool flag_faces_only
   ) {
-  return _deps_halo(
-    kids.boxes, kid_ix,
-    kids.cell_scale_log2, kids.box_scale_log2,
-    pars ? pars->cell_scale_log2 : 0,
-    pars ? pars->box_scale_log2 : 0,
-    halo, prolong_halo,
-    pars ? pars->boxes : nullptr,
-    bdry,
-    flag_faces_only
+  vector<tuple<int,int,Box>> ans;
+  deps_halo(ans, kids, pars, kid_ix, halo, bdry, prolong_halo, flag_faces_only);
+  return ans;
+}
+
+void boxtree::deps_halo(
+    vector<tuple<int/*lev*/,int/*box_i*/,Box>> &ans,
+    const Level &kids,
+    const Level *pars,
+    int kid_ix,
+    int halo,
+    Boundary *bdry,
+    int prolong_halo,
+    bool flag_faces_only,
+    const Lists *lists
+  ) {
+  // works on the callers' levels by reference and never copies a Ref,
+  // so given `lists` this may run concurrently on Workers threads
+  
+  // per thread scratch, reused to spare the allocator
+  thread_local deque<Box> inside, gaps, par_gaps;
+  inside.clear();
+  
+  int kids_cell_s = kids.cell_scale_log2, kids_box_s = kids.box_scale_log2;
+  
+  Box kid_box = (*kids.boxes)[kid_ix];
+  
+  // inflate kid_box by halo and then map to the domain's interior
+  if (flag_faces_only) {
+    for (const Box &face: kid_box.inflated_faces(halo<<(kids_box_s-kids_cell_s)))
+      bdry->internalize(inside, kids_box_s, face);
+  } else {
+    Box kid_fat = kid_box.inflated(halo<<(kids_box_s-kids_cell_s));
+    bdry->internalize(inside, kids_box_s, kid_fat);
+  }
+  gaps = inside;
+  
+  //cout << "halo kidbox " << kid_box << '\n';
+  
+  // walk siblings
+  (lists ? ByteSeqPtr{lists->siblings[kid_ix]} : boxtree::siblings(kids, kid_ix, bdry))
+  .for_bit1(
+    [&](int sib_ix)->bool {
+      Box sib_box = (*kids.boxes)[sib_ix];
+      //cout << " sibbox " << sib_box << '\n';
+      for(const Box &x: inside) {
+        Box z = Box::intersection(x, sib_box);
+        if(!z.is_empty()) {
+          ans.push_back(make_tuple(0, sib_ix, z));
+          Box::subtract(gaps, z);
+        }
+      }
+      return true;
+    }
   );
+  
+  if(pars) {
+    int pars_cell_s = pars->cell_scale_log2, pars_box_s = pars->box_scale_log2;
+    
+    // remove kid from gaps before ascending
+    Box::subtract(gaps, kid_box);
+    
+    // gaps projected to coarser level, inflated by prolong_halo, then unioned
+    par_gaps.clear();
+    for(Box x: gaps) {
+      // project boxes onto parent level
+      x = x.scaled_pow2(pars_box_s - kids_box_s);
+      
+      if(prolong_halo != 0) {
+        // inflate by prolong halo
+        x = x.inflated(prolong_halo<<(pars_box_s-pars_cell_s));
+        // add to par_gaps
+        Box::unify(par_gaps, x);
+      }
+      else // performance shortcut
+        par_gaps.push_back(x);
+    }
+    
+    // walk over parents of kid
+    (lists ? ByteSeqPtr{lists->parents[kid_ix]} : boxtree::parents(kids, *pars, kid_ix, bdry, /*neighboring=*/true))
+    .for_bit1([&](int par_ix)->bool {
+      Box par_box = (*pars->boxes)[par_ix];
+      //cout << " parbox " << par_box << '\n';
+      for(Box x: par_gaps) {
+        Box z = Box::intersection(x, par_box);
+        if(!z.is_empty()) {
+          //cout << "  isect " << z << '\n';
+          ans.push_back(make_tuple(-1, par_ix, z));
+        }
+      }
+      return true;
+    });
+  }
 }
 
 
@@ -391,10 +432,21 @@ boxtree::deps_restrict(
     int par_ix
   ) {
   vector<pair<int/*box_ix*/,Box>> ans;
+  deps_restrict(ans, kids, pars, par_ix);
+  return ans;
+}
+
+void boxtree::deps_restrict(
+    vector<pair<int/*box_ix*/,Box>> &ans,
+    const Level &kids,
+    const Level &pars,
+    int par_ix,
+    const Lists *lists
+  ) {
   Box shadow = (*pars.boxes)[par_ix].scaled_pow2(kids.box_scale_log2 - pars.box_scale_log2);
   
   // walk children
-  boxtree::children(kids, pars, par_ix)
+  (lists ? ByteSeqPtr{lists->children[par_ix]} : boxtree::children(kids, pars, par_ix))
   .for_bit1([&](int kid_ix)->bool {
     Box kid_box = (*kids.boxes)[kid_ix];
     Box z = Box::intersection(kid_box, shadow);
@@ -402,8 +454,6 @@ boxtree::deps_restrict(
       ans.push_back(make_pair(kid_ix, z));
     return true;
   });
-  
-  return ans;
 }
 
 
@@ -418,13 +468,24 @@ boxtree::deps_prolong(
     Boundary *bdry,
     int interp_halo
   ) {
-  
   vector<pair<int/*box_ix*/,Box>> ans;
-  
+  deps_prolong(ans, kids, pars, kid_ix, bdry, interp_halo);
+  return ans;
+}
+
+void boxtree::deps_prolong(
+    vector<pair<int/*box_ix*/,Box>> &ans,
+    const Level &kids,
+    const Level &pars,
+    int kid_ix,
+    Boundary *bdry,
+    int interp_halo,
+    const Lists *lists
+  ) {
   Box shadow = (*kids.boxes)[kid_ix].scaled_pow2(pars.box_scale_log2 - kids.box_scale_log2);
   shadow = shadow.inflated(interp_halo<<(pars.box_scale_log2 - pars.cell_scale_log2));
   
-  boxtree::parents(kids, pars, kid_ix, bdry, /*neighboring=*/true)
+  (lists ? ByteSeqPtr{lists->parents[kid_ix]} : boxtree::parents(kids, pars, kid_ix, bdry, /*neighboring=*/true))
   .for_bit1([&](int par_ix)->bool {
     Box par_box = (*pars.boxes)[par_ix];
     Box z = Box::intersection(par_box, shadow);
@@ -432,6 +493,4 @@ boxtree::deps_prolong(
       ans.push_back(make_pair(par_ix, z));
     return true;
   });
-  
-  return ans;
 }
@@ -55,6 +55,19 @@ namespace boxtree {
   ByteSeqPtr parents(const Level &kids, const Level &pars, int kid_ix, Boundary *bdry, bool neighboring);
   ByteSeqPtr children(const Level &kids, const Level &pars, int par_ix);
   
+  // The lists above for every box of a level at once, by box ix. Getting
+  // them fills the memo tables, so do that serially; the deps_* queries
+  // handed them then read them without locking, and so may run on
+  // Workers threads while the levels live.
+  struct Lists {
+    std::uint8_t *const *siblings = nullptr; // by kid_ix
+    std::uint8_t *const *parents = nullptr;  // neighboring, by kid_ix
+    std::uint8_t *const *children = nullptr; // by par_ix
+  };
+  Lists lists_halo(const Level &kids, const Level *pars/*nullable*/, Boundary *bdry);
+  Lists lists_restrict(const Level &kids, const Level &pars);
+  Lists lists_prolong(const Level &kids, const Level &pars, Boundary *bdry);
+  
   // does not list `kid_ix` in output dependencies
   std::vector<std::tuple<int/*lev=0,-1*/,int/*ix*/,Box>>
   deps_halo(
@@ -66,6 +79,18 @@ namespace boxtree {
     int prolong_halo,
     bool flag_faces_only = true
   );
+  // same, but appends onto `push_on`, reading `lists` if given
+  void deps_halo(
+    std::vector<std::tuple<int/*lev=0,-1*/,int/*ix*/,Box>> &push_on,
+    const Level &kids,
+    const Level *pars/*nullable*/,
+    int kid_ix,
+    int halo,
+    Boundary *bdry,
+    int prolong_halo,
+    bool flag_faces_only = true,
+    const Lists *lists = nullptr
+  );
 #if 0  
   std::vector<std::tuple<
   sats_halo(
@@ -83,6 +108,14 @@ namespace boxtree {
     const Level &pars,
     int par_ix
   );
+  // same, but appends onto `push_on`, reading `lists` if given
+  void deps_restrict(
+    std::vector<std::pair<int/*box_ix*/,Box>> &push_on,
+    const Level &kids,
+    const Level &pars,
+    int par_ix,
+    const Lists *lists = nullptr
+  );
   
   std::vector<std::pair<int/*box_ix*/,Box>>
   deps_prolong(
@@ -92,6 +125,16 @@ namespace boxtree {
     Boundary *bdry,
     int interp_halo
   );
+  // same, but appends onto `push_on`, reading `lists` if given
+  void deps_prolong(
+    std::vector<std::pair<int/*box_ix*/,Box>> &push_on,
+    const Level &kids,
+    const Level &pars,
+    int kid_ix,
+    Boundary *bdry,
+    int interp_halo,
+    const Lists *lists = nullptr
+  );
 }}}
 
 namespace std {
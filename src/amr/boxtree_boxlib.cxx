@@ -1,6 +1,7 @@
 #include "boxtree_boxlib.hxx"
 #include "lowlevel/bitops.hxx"
 #include "boxmap.hxx"
+#include "env.hxx"
 
 #include <new>
 #include <fstream>
@@ -58,6 +59,8 @@ namespace {
     expect(is, string(lit));
   }
   
+  istream& operator>>(istream &i, Pt<int> &x);
+
   template<class T>
   void expect(istream &is, const T &lit) {
     T x;
@@ -153,8 +156,9 @@ boxtree::load_boxlib(const char *file) {
   int lev = 0;
   int lev_ix0 = 0;
   int cell_scale_log2 = 0;
-  // TODO: can read this in from environment
-  const bool force_ordered_rank = true;
+  // file_ranks=1 keeps the file's distribution, otherwise each box is its
+  // own rank in file order
+  const bool force_ordered_rank = !env<bool>("file_ranks", false);
   int box_id = 0;
   
   while(true) {
@@ -0,0 +1,237 @@
+#include "partition.hxx"
+#include "diagnostic.hxx"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <limits>
+#include <queue>
+
+using namespace programr;
+using namespace programr::amr;
+using namespace std;
+
+namespace {
+  // spreads the low 21 bits of x to every third bit
+  uint64_t spread3(uint64_t x) {
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffull;
+    x = (x | x << 16) & 0x1f0000ff0000ffull;
+    x = (x | x << 8) & 0x100f00f00f00f00full;
+    x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+    x = (x | x << 2) & 0x1249249249249249ull;
+    return x;
+  }
+
+  struct Item {
+    uint64_t key;
+    uint32_t lev, ix;
+    double cost;
+  };
+
+  bool by_key(const Item &a, const Item &b) {
+    if(a.key != b.key) return a.key < b.key;
+    if(a.lev != b.lev) return a.lev < b.lev;
+    return a.ix < b.ix;
+  }
+
+  bool by_cost_down(const Item &a, const Item &b) {
+    if(a.cost != b.cost) return a.cost > b.cost;
+    return by_key(a, b);
+  }
+
+  // sorts a slice per worker, then merges neighbouring slices pairwise
+  void parallel_sort(Item *b, Item *e, Workers &pool, bool(*less)(const Item&, const Item&)) {
+    size_t n = e - b;
+    int part_n = pool.size();
+    if(part_n == 1 || n < (1<<14)) {
+      std::sort(b, e, less);
+      return;
+    }
+    vector<size_t> at(part_n + 1);
+    for(int p=0; p <= part_n; p++)
+      at[p] = n*p/part_n;
+    pool.parallel_for(part_n, 1, [&](size_t p, int) {
+      std::sort(b + at[p], b + at[p+1], less);
+    });
+    for(int width=1; width < part_n; width *= 2) {
+      size_t pair_n = (part_n + 2*width - 1)/(2*width);
+      pool.parallel_for(pair_n, 1, [&](size_t q, int) {
+        size_t lo = at[2*width*q];
+        size_t mid = at[std::min<size_t>(part_n, 2*width*q + width)];
+        size_t hi = at[std::min<size_t>(part_n, 2*width*(q+1))];
+        std::inplace_merge(b + lo, b + mid, b + hi, less);
+      });
+    }
+  }
+
+  // cuts curve ordered items into rank_n runs of about equal cost
+  void split_sorted(const Item *b, const Item *e, int rank_n, Workers &pool, vector<vector<int>> &ranks) {
+    size_t n = e - b;
+    vector<double> before(n);
+    double total = 0;
+    for(size_t i=0; i < n; i++) {
+      before[i] = total;
+      total += b[i].cost;
+    }
+    pool.parallel_for(n, 4096, [&](size_t i, int) {
+      double mid = before[i] + b[i].cost/2;
+      int rank = total > 0 ? int(mid/total*rank_n) : 0;
+      ranks[b[i].lev][b[i].ix] = std::min(rank, rank_n - 1);
+    });
+  }
+
+  // heaviest first onto the least loaded rank, ties to the lowest rank
+  void knapsack(Item *b, Item *e, int rank_n, Workers &pool, vector<vector<int>> &ranks) {
+    parallel_sort(b, e, pool, by_cost_down);
+    typedef pair<double,int> Load;
+    priority_queue<Load, vector<Load>, greater<Load>> least;
+    for(int r=0; r < rank_n; r++)
+      least.push(Load(0, r));
+    for(Item *it=b; it != e; it++) {
+      Load l = least.top();
+      least.pop();
+      ranks[it->lev][it->ix] = l.second;
+      least.push(Load(l.first + it->cost, l.second));
+    }
+  }
+}
+
+uint64_t programr::amr::morton_key(uint32_t x, uint32_t y, uint32_t z) {
+  return spread3(x) << 2 | spread3(y) << 1 | spread3(z);
+}
+
+// Skilling's transpose form, "Programming the Hilbert curve" (2004):
+// undo the excess work of the curve's rotations, Gray encode, then
+// interleave like morton.
+uint64_t programr::amr::hilbert_key(uint32_t x, uint32_t y, uint32_t z, int bits) {
+  if(bits <= 0)
+    return 0;
+  uint32_t X[3] = {x, y, z};
+  uint32_t m = uint32_t(1) << (bits-1);
+  for(uint32_t q=m; q > 1; q >>= 1) {
+    uint32_t p = q - 1;
+    for(int i=0; i < 3; i++) {
+      if(X[i] & q)
+        X[0] ^= p;
+      else {
+        uint32_t t = (X[0] ^ X[i]) & p;
+        X[0] ^= t;
+        X[i] ^= t;
+      }
+    }
+  }
+  for(int i=1; i < 3; i++)
+    X[i] ^= X[i-1];
+  uint32_t t = 0;
+  for(uint32_t q=m; q > 1; q >>= 1) {
+    if(X[2] & q)
+      t ^= q - 1;
+  }
+  for(int i=0; i < 3; i++)
+    X[i] ^= t;
+  return morton_key(X[0], X[1], X[2]);
+}
+
+PartitionMethod programr::amr::partition_method(const std::string &name) {
+  if(name == "morton") return PartitionMethod::morton;
+  if(name == "hilbert") return PartitionMethod::hilbert;
+  USER_ASSERT_F(name == "knapsack", "Unknown partition method: " << name);
+  return PartitionMethod::knapsack;
+}
+
+std::vector<Ref<BoxMap<int>>> programr::amr::partition(
+    const std::vector<boxtree::Level> &levels,
+    int rank_n,
+    PartitionMethod method,
+    bool per_level,
+    Workers &pool,
+    const perf::Stencil3DParams &cost
+  ) {
+  USER_ASSERT(rank_n > 0, "Partitioning needs at least one rank.");
+  int lev_n = levels.size();
+
+  vector<size_t> lev_at(lev_n + 1, 0);
+  int top_scale_log2 = numeric_limits<int>::min();
+  for(int l=0; l < lev_n; l++) {
+    lev_at[l+1] = lev_at[l] + levels[l].boxes->size();
+    // centers need one more bit than the finest level: (lo+hi)/2
+    top_scale_log2 = std::max(top_scale_log2, levels[l].box_scale_log2 + 1);
+  }
+  size_t n = lev_at[lev_n];
+  vector<Item> items(n);
+  vector<Pt<int>> centers(n);
+  vector<vector<int>> ranks(lev_n);
+
+  for(int l=0; l < lev_n; l++) {
+    const boxtree::Level &lev = levels[l];
+    ranks[l].resize(lev.boxes->size());
+    int center_shift = top_scale_log2 - lev.box_scale_log2 - 1;
+    int cell_shift = lev.unit_per_cell_log2();
+
+    pool.parallel_for(lev.boxes->size(), 1024, [&](size_t ix, int) {
+      const Box &box = (*lev.boxes)[ix];
+      Item &it = items[lev_at[l] + ix];
+      it.lev = l;
+      it.ix = ix;
+      // as lev.geom_centers(top_scale_log2)
+      centers[lev_at[l] + ix] = (box.lo + box.hi) << center_shift;
+      Pt<int> sz = box.hi - box.lo;
+      std::array<int,3> cells;
+      for(int d=0; d < 3; d++)
+        cells[d] = std::max(1, sz[d] >> cell_shift);
+      it.cost = perf::compute_s(cost, cells);
+    });
+  }
+
+  // shift the centers to start at 0 and fit 21 bits a dimension
+  Pt<int> lo(numeric_limits<int>::max()), hi(numeric_limits<int>::min());
+  for(const Pt<int> &c: centers) {
+    for(int d=0; d < 3; d++) {
+      lo[d] = std::min(lo[d], c[d]);
+      hi[d] = std::max(hi[d], c[d]);
+    }
+  }
+  int bits = 0;
+  for(int d=0; d < 3; d++) {
+    while(n != 0 && (int64_t(hi[d]) - lo[d]) >> bits != 0)
+      bits += 1;
+  }
+  int drop = std::max(0, bits - 21);
+  bits -= drop;
+
+  pool.parallel_for(n, 4096, [&](size_t i, int) {
+    uint32_t x[3];
+    for(int d=0; d < 3; d++)
+      x[d] = uint32_t(int64_t(centers[i][d]) - lo[d]) >> drop;
+    items[i].key = method == PartitionMethod::morton
+      ? morton_key(x[0], x[1], x[2])
+      : hilbert_key(x[0], x[1], x[2], bits);
+  });
+
+  // the slices of items balanced on their own
+  vector<pair<size_t,size_t>> slices;
+  if(per_level) {
+    for(int l=0; l < lev_n; l++)
+      slices.push_back(make_pair(lev_at[l], lev_at[l+1]));
+  }
+  else
+    slices.push_back(make_pair(size_t(0), n));
+
+  for(auto s: slices) {
+    Item *b = items.data() + s.first, *e = items.data() + s.second;
+    if(method == PartitionMethod::knapsack)
+      knapsack(b, e, rank_n, pool, ranks);
+    else {
+      parallel_sort(b, e, pool, by_key);
+      split_sorted(b, e, rank_n, pool, ranks);
+    }
+  }
+
+  vector<Ref<BoxMap<int>>> maps(lev_n);
+  for(int l=0; l < lev_n; l++) {
+    const vector<int> &r = ranks[l];
+    maps[l] = BoxMap<int>::make_by_ix(levels[l].boxes, [&](int ix) { return r[ix]; });
+  }
+  return maps;
+}
@@ -0,0 +1,48 @@
+#ifndef _e2a7c4f9_5b13_4d86_9f0a_6c3d1b8e27a4
+#define _e2a7c4f9_5b13_4d86_9f0a_6c3d1b8e27a4
+
+# include "boxtree.hxx"
+# include "lowlevel/workers.hxx"
+# include "perfmodel/perfmodel.hxx"
+
+# include <cstdint>
+# include <string>
+# include <vector>
+
+/* Partitioners assigning the boxes of a hierarchy to `rank_n` ranks, each
+ * box weighted by the modeled seconds of `cost` over its cells:
+ *
+ *   morton, hilbert: boxes ordered along the curve through their centers,
+ *     at the finest level's resolution so levels interleave, then cut into
+ *     rank_n contiguous runs of about equal cost. A box goes to the run
+ *     holding the middle of its cost.
+ *   knapsack: heaviest box first onto the least loaded rank, balancing
+ *     best but ignoring locality.
+ *
+ * With `per_level` every level is spread over all the ranks on its own,
+ * otherwise the hierarchy is balanced as a whole. Keys, costs and the
+ * sort run on `pool`. Ranks get no boxes when there are fewer boxes than
+ * ranks, or a few boxes outweigh the rest.
+ */
+namespace programr {
+namespace amr {
+  enum class PartitionMethod { morton, hilbert, knapsack };
+
+  // USER_ASSERTs on names other than morton, hilbert and knapsack
+  PartitionMethod partition_method(const std::string &name);
+
+  // a rank map per level
+  std::vector<Ref<BoxMap<int>>> partition(
+    const std::vector<boxtree::Level> &levels,
+    int rank_n,
+    PartitionMethod method,
+    bool per_level,
+    Workers &pool,
+    const perf::Stencil3DParams &cost = perf::smooth
+  );
+
+  // positions along the curves through a 2^bits cube, bits <= 21
+  std::uint64_t morton_key(std::uint32_t x, std::uint32_t y, std::uint32_t z);
+  std::uint64_t hilbert_key(std::uint32_t x, std::uint32_t y, std::uint32_t z, int bits);
+}}
+#endif
@@ -32,6 +32,88 @@ namespace {
   }
   const bool flag_counter = false;
   std::unordered_map<std::string, std::size_t> counter;
+  
+  // boxes handed to a worker at a time
+  const std::size_t box_grain = 16;
+  
+  struct BoxDeps {
+    int worker;
+    size_t off, n; // range in worker's dependency buffer
+    double seconds;
+  };
+  
+  // slab ops execute one at a time so they can all share this, and it
+  // keeps its capacity from level to level
+  struct {
+    vector<BoxDeps> box_deps;
+    vector<vector<Dependency>> worker_deps;
+    TaskBatch batch;
+  } task_map_scratch;
+  
+  // Builds res->task_map with one task per box of res->level.
+  // `f_box(ix, box, deps)` pushes the box's dependencies and returns its
+  // compute seconds. It runs on cxt.workers() and so may be called
+  // concurrently; everything it touches must be read-only, so boxtree
+  // queries are handed boxtree::Lists got beforehand. Each worker
+  // appends to its own dependency buffer, and the boxes are then gathered
+  // in order into one TaskBatch, so a level's task ids always form one
+  // contiguous run and the trace does not depend on the thread count.
+  template<class F>
+  Ref<BoxMap<uint64_t>> make_task_map(
+      Expr::ExecCxt &cxt,
+      const Slab *res,
+      const std::string &note,
+      const F &f_box
+    ) {
+    const Imm<BoxList> &boxes = res->level.boxes;
+    int box_n = boxes->size();
+    
+    vector<BoxDeps> &box_deps = task_map_scratch.box_deps;
+    vector<vector<Dependency>> &worker_deps = task_map_scratch.worker_deps;
+    TaskBatch &batch = task_map_scratch.batch;
+    
+    box_deps.resize(box_n);
+    worker_deps.resize(cxt.workers().size());
+    for(vector<Dependency> &deps: worker_deps)
+      deps.clear();
+    
+    cxt.workers().parallel_for(box_n, box_grain,
+      [&](size_t ix, int worker) {
+        vector<Dependency> &deps = worker_deps[worker];
+        BoxDeps &bd = box_deps[ix];
+        bd.worker = worker;
+        bd.off = deps.size();
+        bd.seconds = f_box(int(ix), (*boxes)[ix], deps);
+        bd.n = deps.size() - bd.off;
+      }
+    );
+    
+    batch.clear();
+    batch.data_id = res->data->id;
+    
+    uint32_t note_op = TaskNote::intern(note);
+    int note_lev = res->level.cell_scale_log2;
+    
+    for(int ix=0; ix < box_n; ix++) {
+      const BoxDeps &bd = box_deps[ix];
+      const Dependency *deps = worker_deps[bd.worker].data() + bd.off;
+      batch.deps.insert(batch.deps.end(), deps, deps + bd.n);
+      batch.add(
+        /*rank*/(*res->rank_map)(boxes, ix),
+        /*note*/TaskNote{note_op, note_lev, ix},
+        /*seconds*/bd.seconds
+      );
+    }
+    
+    uint64_t task_id0 = cxt.tasks(batch);
+    
+    return BoxMap<uint64_t>::make_by_ix(
+      boxes,
+      [&](int ix) {
+        return task_id0 + ix;
+      }
+    );
+  }
 }
 
 
@@ -61,16 +143,9 @@ void Expr_Slab_Literal::show(std::ostream &o) const {
 
 void Expr_Slab_Literal::execute(Expr::ExecCxt &cxt) {
   Slab *res = (Slab*)this->result;
-  res->task_map = BoxMap<uint64_t>::make_by_ix(
-    res->level.boxes,
-    [&](int ix) {
-      return cxt.task(
-        /*rank*/(*res->rank_map)(res->level.boxes, ix),
-        /*data*/res->data->id,
-        /*deps*/{},
-        /*note*/note + " lev="+to_string(res->level.cell_scale_log2)+" box="+to_string(ix),
-        /*seconds*/0.0
-      );
+  res->task_map = make_task_map(cxt, res, note,
+    [&](int ix, const Box &box, vector<Dependency> &deps) {
+      return 0.0;
     }
   );
   
@@ -105,24 +180,18 @@ void Expr_Slab_Migrate::execute(Expr::ExecCxt &cxt) {
   res->rank_map = new_ranks;
   res->elmt_sz = x->elmt_sz;
   
-  res->task_map = BoxMap<uint64_t>::make_by_ix_box(
-    res->level.boxes,
-    [&](int ix, Box box) {
-      return cxt.task(
-        /*rank*/(*res->rank_map)(res->level.boxes, ix),
-        /*data*/res->data->id,
-        /*deps*/{
-          make_dependency_cells(
-            /*data_id*/x->data->id,
-            /*box*/box,
-            /*unit_per_cell_log2*/x->level.unit_per_cell_log2(),
-            /*src_task*/(*x->task_map)(res->level.boxes, ix),
-            /*elmt_sz*/res->elmt_sz
-          )
-        },
-        /*note*/note + " lev="+to_string(res->level.cell_scale_log2)+" box="+to_string(ix),
-        /*seconds*/0.0
+  res->task_map = make_task_map(cxt, res, note,
+    [&](int ix, const Box &box, vector<Dependency> &deps) {
+      deps.push_back(
+        make_dependency_cells(
+          /*data_id*/x->data->id,
+          /*box*/box,
+          /*unit_per_cell_log2*/x->level.unit_per_cell_log2(),
+          /*src_task*/(*x->task_map)(res->level.boxes, ix),
+          /*elmt_sz*/res->elmt_sz
+        )
       );
+      return 0.0;
     }
   );
   
@@ -176,10 +245,8 @@ void Expr_Slab_Op::execute(Expr::ExecCxt &cxt) {
     }
   }
   
-  res->task_map = BoxMap<uint64_t>::make_by_ix_box(
-    res->level.boxes,
-    [&](int ix, Box box) {
-      vector<Dependency> deps;
+  res->task_map = make_task_map(cxt, res, note,
+    [&](int ix, const Box &box, vector<Dependency> &deps) {
       int arg_n = args.size();
       
       for(int a=0; a < arg_n; a++) {
@@ -197,20 +264,14 @@ void Expr_Slab_Op::execute(Expr::ExecCxt &cxt) {
       
       Pt<int> box_sz = box.size();
       
-      return cxt.task(
-        /*rank*/(*res->rank_map)(res->level.boxes, ix),
-        /*data*/res->data->id,
-        /*deps*/deps,
-        /*note*/note + " lev="+to_string(res->level.cell_scale_log2)+" box="+to_string(ix),
-        /*seconds*/this->perf_wflops == 0.0 ? 0.0 : perf::compute_s(
-          perf::Stencil3DParams(
-            this->perf_wflops,
-            /*ro*/{(double)arg_n,(double)arg_n,(double)arg_n,(double)arg_n},
-            /*wo*/{1,1,1,1},
-            /*rw*/{0,0,0,0}
-          ),
-          {box_sz[0], box_sz[1], box_sz[2]}
-        )
+      return this->perf_wflops == 0.0 ? 0.0 : perf::compute_s(
+        perf::Stencil3DParams(
+          this->perf_wflops,
+          /*ro*/{(double)arg_n,(double)arg_n,(double)arg_n,(double)arg_n},
+          /*wo*/{1,1,1,1},
+          /*rw*/{0,0,0,0}
+        ),
+        {box_sz[0], box_sz[1], box_sz[2]}
       );
     }
   );
@@ -253,10 +314,10 @@ void Expr_Slab_Halo::execute(Expr::ExecCxt &cxt) {
   res->rank_map = kid->rank_map;
   res->elmt_sz = kid->elmt_sz;
   
-  res->task_map = BoxMap<uint64_t>::make_by_ix_box(
-    res->level.boxes, // == kid->level.boxes
-    [&](int ix, Box box) {
-      vector<Dependency> task_deps;
+  boxtree::Lists lists = boxtree::lists_halo(kid->level, par ? &par->level : nullptr, res->bdry);
+  
+  res->task_map = make_task_map(cxt, res, note, // res->level.boxes == kid->level.boxes
+    [&](int ix, const Box &box, vector<Dependency> &task_deps) {
       
       // self dependency on interior
       task_deps.push_back(
@@ -269,13 +330,17 @@ void Expr_Slab_Halo::execute(Expr::ExecCxt &cxt) {
         )
       );
       
-      auto halo_deps = boxtree::deps_halo(
+      thread_local vector<tuple<int,int,Box>> halo_deps;
+      halo_deps.clear();
+      boxtree::deps_halo(halo_deps,
         /*kids*/kid->level,
         /*pars*/par ? &par->level : nullptr,
         /*kid_ix*/ix,
         /*halo*/halo_n,
         /*bdry*/res->bdry,
-        /*prolong_halo*/prolong_halo_n
+        /*prolong_halo*/prolong_halo_n,
+        /*flag_faces_only*/true,
+        &lists
       );
       
       for(auto halo_dep: halo_deps) {
@@ -295,13 +360,7 @@ void Expr_Slab_Halo::execute(Expr::ExecCxt &cxt) {
         );
       }
       
-      return cxt.task(
-        /*rank*/(*res->rank_map)(res->level.boxes, ix),
-        /*data*/res->data->id,
-        /*deps*/task_deps,
-        /*note*/note + " lev="+to_string(res->level.cell_scale_log2)+" box="+to_string(ix),
-        /*seconds*/0.0
-      );
+      return 0.0;
     }
   );
 
@@ -352,10 +411,10 @@ void Expr_Slab_Halo2::execute(Expr::ExecCxt &cxt) {
   res->rank_map = kid->rank_map;
   res->elmt_sz = kid->elmt_sz;
   
-  res->task_map = BoxMap<uint64_t>::make_by_ix_box(
-    res->level.boxes, // == kid->level.boxes
-    [&](int ix, Box box) {
-      vector<Dependency> task_deps;
+  boxtree::Lists lists = boxtree::lists_halo(kid->level, par0 ? &par0->level : nullptr, res->bdry);
+  
+  res->task_map = make_task_map(cxt, res, note, // res->level.boxes == kid->level.boxes
+    [&](int ix, const Box &box, vector<Dependency> &task_deps) {
       
       // self dependency on interior
       task_deps.push_back(
@@ -368,13 +427,17 @@ void Expr_Slab_Halo2::execute(Expr::ExecCxt &cxt) {
         )
       );
       
-      auto halo_deps = boxtree::deps_halo(
+      thread_local vector<tuple<int,int,Box>> halo_deps;
+      halo_deps.clear();
+      boxtree::deps_halo(halo_deps,
         /*kids*/kid->level,
         /*pars*/par0 ? &par0->level : nullptr,
         /*kid_ix*/ix,
         /*halo*/halo_n,
         /*bdry*/res->bdry,
-        /*prolong_halo*/prolong_halo_n
+        /*prolong_halo*/prolong_halo_n,
+        /*flag_faces_only*/true,
+        &lists
       );
       
       for(auto halo_dep: halo_deps) {
@@ -407,13 +470,7 @@ void Expr_Slab_Halo2::execute(Expr::ExecCxt &cxt) {
         }
       }
       
-      return cxt.task(
-        /*rank*/(*res->rank_map)(res->level.boxes, ix),
-        /*data*/res->data->id,
-        /*deps*/task_deps,
-        /*note*/note + " lev="+to_string(res->level.cell_scale_log2)+" box="+to_string(ix),
-        /*seconds*/0.0
-      );
+      return 0.0;
     }
   );
 
@@ -450,28 +507,22 @@ void Expr_Slab_Stencil::execute(Expr::ExecCxt &cxt) {
   res->rank_map = x->rank_map;
   res->elmt_sz = x->elmt_sz;
   
-  res->task_map = BoxMap<uint64_t>::make_by_ix_box(
-    res->level.boxes,
-    [&](int ix, Box box) {
+  res->task_map = make_task_map(cxt, res, note,
+    [&](int ix, const Box &box, vector<Dependency> &deps) {
       Pt<int> box_sz = box.size();
-      return cxt.task(
-        /*rank*/(*res->rank_map)(res->level.boxes, ix),
-        /*data*/res->data->id,
-        /*deps*/{
-          make_dependency_cells(
-            /*data_id*/x->data->id,
-            /*box*/box.inflated(x->halo_n << x->level.unit_per_cell_log2()),
-            /*unit_per_cell_log2*/x->level.unit_per_cell_log2(),
-            /*src_task*/(*x->task_map)(res->level.boxes, ix),
-            /*elmt_sz*/x->elmt_sz
-          )
-        },
-        /*note*/note + " lev="+to_string(res->level.cell_scale_log2)+" box="+to_string(ix),
-        /*seconds*/perf::compute_s(
-          this->perf_stencil,
-          {box_sz[0], box_sz[1], box_sz[2]}
+      deps.push_back(
+        make_dependency_cells(
+          /*data_id*/x->data->id,
+          /*box*/box.inflated(x->halo_n << x->level.unit_per_cell_log2()),
+          /*unit_per_cell_log2*/x->level.unit_per_cell_log2(),
+          /*src_task*/(*x->task_map)(res->level.boxes, ix),
+          /*elmt_sz*/x->elmt_sz
         )
       );
+      return perf::compute_s(
+        this->perf_stencil,
+        {box_sz[0], box_sz[1], box_sz[2]}
+      );
     }
   );
   
@@ -508,10 +559,10 @@ void Expr_Slab_Restrict::execute(Expr::ExecCxt &cxt) {
   res->rank_map = par->rank_map;
   res->elmt_sz = kid->elmt_sz;
   
-  res->task_map = BoxMap<uint64_t>::make_by_ix_box(
-    par->level.boxes,
-    [&](int par_ix, Box par_box) {
-      vector<Dependency> deps;
+  boxtree::Lists lists = boxtree::lists_restrict(kid->level, par->level);
+  
+  res->task_map = make_task_map(cxt, res, note, // res->level.boxes == par->level.boxes
+    [&](int par_ix, const Box &par_box, vector<Dependency> &deps) {
       
       // dependency on parent
       deps.push_back(
@@ -525,10 +576,15 @@ void Expr_Slab_Restrict::execute(Expr::ExecCxt &cxt) {
       );
       
       // children
-      for(auto rest_dep: boxtree::deps_restrict(
-          kid->level,
-          par->level, par_ix
-        )) {
+      thread_local vector<pair<int,Box>> rest_deps;
+      rest_deps.clear();
+      boxtree::deps_restrict(rest_deps,
+        kid->level,
+        par->level, par_ix,
+        &lists
+      );
+      
+      for(auto rest_dep: rest_deps) {
         int kid_ix; Box kid_box;
         tie(kid_ix, kid_box) = rest_dep;
         
@@ -553,13 +609,7 @@ void Expr_Slab_Restrict::execute(Expr::ExecCxt &cxt) {
       }
       
       Pt<int> box_sz = par_box.size();
-      return cxt.task(
-        /*rank*/(*res->rank_map)(res->level.boxes, par_ix),
-        /*data*/res->data->id,
-        /*deps*/deps,
-        /*note*/note + " lev="+to_string(res->level.cell_scale_log2)+" box="+to_string(par_ix),
-        /*seconds*/perf::compute_s(this->perf_stencil, {box_sz[0], box_sz[1], box_sz[2]})
-      );
+      return perf::compute_s(this->perf_stencil, {box_sz[0], box_sz[1], box_sz[2]});
     }
   );
   
@@ -596,18 +646,23 @@ void Expr_Slab_Prolong::execute(Expr::ExecCxt &cxt) {
   res->rank_map = kid->rank_map;
   res->elmt_sz = par->elmt_sz;
   
-  res->task_map = BoxMap<uint64_t>::make_by_ix_box(
-    kid->level.boxes,
-    [&](int kid_ix, Box kid_box) {
-      vector<Dependency> deps;
+  boxtree::Lists lists = boxtree::lists_prolong(kid->level, par->level, res->bdry);
+  
+  res->task_map = make_task_map(cxt, res, note, // res->level.boxes == kid->level.boxes
+    [&](int kid_ix, const Box &kid_box, vector<Dependency> &deps) {
       
-      for(auto pro_dep: boxtree::deps_prolong(
-          /*kids*/kid->level,
-          /*pars*/par->level,
-          /*kid_ix*/kid_ix,
-          /*bdry*/res->bdry,
-          /*interp_halo*/prolong_halo_n
-        )) {
+      thread_local vector<pair<int,Box>> pro_deps;
+      pro_deps.clear();
+      boxtree::deps_prolong(pro_deps,
+        /*kids*/kid->level,
+        /*pars*/par->level,
+        /*kid_ix*/kid_ix,
+        /*bdry*/res->bdry,
+        /*interp_halo*/prolong_halo_n,
+        &lists
+      );
+      
+      for(auto pro_dep: pro_deps) {
         int par_ix; Box par_box;
         tie(par_ix, par_box) = pro_dep;
         
@@ -623,13 +678,7 @@ void Expr_Slab_Prolong::execute(Expr::ExecCxt &cxt) {
       }
       
       Pt<int> box_sz = kid_box.size();
-      return cxt.task(
-        /*rank*/(*res->rank_map)(res->level.boxes, kid_ix),
-        /*data*/res->data->id,
-        /*deps*/deps,
-        /*note*/note + " lev="+to_string(res->level.cell_scale_log2)+" box="+to_string(kid_ix),
-        /*seconds*/perf::compute_s(this->perf_stencil, {box_sz[0], box_sz[1], box_sz[2]})
-      );
+      return perf::compute_s(this->perf_stencil, {box_sz[0], box_sz[1], box_sz[2]});
     }
   );
   
@@ -0,0 +1,286 @@
+#include "blockwriter.hxx"
+#include "diagnostic.hxx"
+#include "lowlevel/lz.hxx"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  const char block_magic[8] = {'P','R','G','M','R','L','Z','B'};
+
+  void put_le(string &buf, uint64_t x, int n) {
+    for(int i=0; i < n; i++)
+      buf.push_back(char(x >> 8*i));
+  }
+
+  bool get_le(istream &in, uint64_t &x, int n) {
+    unsigned char b[8];
+    if(!in.read(reinterpret_cast<char*>(b), n))
+      return false;
+    x = 0;
+    for(int i=0; i < n; i++)
+      x |= uint64_t(b[i]) << 8*i;
+    return true;
+  }
+
+  // bytes from the read position to the end, false if `in` can't seek
+  bool stream_left(istream &in, uint64_t &left) {
+    istream::pos_type at = in.tellg();
+    if(at == istream::pos_type(-1))
+      return false;
+    if(!in.seekg(0, ios::end)) {
+      in.clear();
+      return false;
+    }
+    istream::pos_type end = in.tellg();
+    in.seekg(at);
+    left = uint64_t(end - at);
+    return true;
+  }
+}
+
+BlockEventWriter::BlockEventWriter(std::ostream *file, std::string index_file, std::size_t block_bytes):
+  _file(file),
+  _index_file(std::move(index_file)),
+  _block_bytes(block_bytes),
+  _xml(&_raw) {
+
+  string head(block_magic, 8);
+  put_le(head, version, 4);
+  put_le(head, 0, 4);
+  _file->write(head.data(), head.size());
+  _offset = header_bytes;
+}
+
+void BlockEventWriter::comm(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    int from, int to,
+    size_t bytes,
+    uint64_t epoch
+  ) {
+  _xml.comm(id, deps, dep_n, from, to, bytes, epoch);
+}
+
+void BlockEventWriter::comp(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    int at,
+    double seconds,
+    uint64_t epoch,
+    const TaskNote *note
+  ) {
+  _xml.comp(id, deps, dep_n, at, seconds, epoch, note);
+}
+
+void BlockEventWriter::coll(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    const int *team, size_t team_n,
+    size_t bytes,
+    uint64_t epoch
+  ) {
+  _xml.coll(id, deps, dep_n, team, team_n, bytes, epoch);
+}
+
+void BlockEventWriter::epoch_begin(uint64_t comp_epoch) {
+  if(_xml.offset() >= _block_bytes)
+    _cut();
+  _epoch = comp_epoch;
+  if(_raw.tellp() == 0)
+    _block_epoch = comp_epoch;
+}
+
+void BlockEventWriter::_cut() {
+  _xml.offset(); // flushes into _raw
+  string raw = _raw.str();
+  _raw.str("");
+
+  if(!raw.empty()) {
+    _packed.clear();
+    put_le(_packed, raw.size(), 4);
+    put_le(_packed, 0, 4); // compressed size, below
+    put_le(_packed, _block_epoch, 8);
+    lz_compress(raw.data(), raw.size(), _packed);
+
+    size_t packed_n = _packed.size() - block_header_bytes;
+    USER_ASSERT(raw.size() <= block_max_bytes && packed_n <= block_max_bytes,
+      "Compressed trace block over 1GB, lower compress_block.");
+    for(int i=0; i < 4; i++)
+      _packed[4+i] = char(packed_n >> 8*i);
+
+    _file->write(_packed.data(), _packed.size());
+    _blocks.push_back({_block_epoch, _offset, uint32_t(packed_n), uint32_t(raw.size())});
+    _offset += _packed.size();
+  }
+
+  _block_epoch = _epoch;
+}
+
+void BlockEventWriter::finish() {
+  _xml.finish();
+  _cut();
+  _file->flush();
+
+  ofstream idx(_index_file);
+  USER_ASSERT_F(idx, "Could not open file: " << _index_file);
+  idx << "programr-block-index 1\n"
+      << "blocks " << _blocks.size() << '\n';
+  for(const BlockIndexEntry &b: _blocks)
+    idx << b.epoch << ' ' << b.offset << ' ' << b.packed_n << ' ' << b.raw_n << '\n';
+}
+
+uint64_t BlockEventWriter::offset() {
+  _cut();
+  _file->flush();
+  return _offset;
+}
+
+void BlockEventWriter::checkpoint_save(std::ostream &o) {
+  o << "blocks " << _epoch << ' ' << _blocks.size() << '\n';
+  for(const BlockIndexEntry &b: _blocks)
+    o << b.epoch << ' ' << b.offset << ' ' << b.packed_n << ' ' << b.raw_n << '\n';
+}
+
+void BlockEventWriter::checkpoint_load(std::istream &i, uint64_t offset) {
+  string word;
+  size_t block_n;
+  i >> word >> _epoch >> block_n;
+  USER_ASSERT(i && word == "blocks", "Bad checkpoint file: not for a compressed trace.");
+
+  _blocks.resize(block_n);
+  for(BlockIndexEntry &b: _blocks)
+    i >> b.epoch >> b.offset >> b.packed_n >> b.raw_n;
+  USER_ASSERT(i, "Bad checkpoint file: compressed trace blocks.");
+
+  // drop the "<events>" our _xml wrote, the checkpointed run has it
+  _xml.checkpoint_load(i, 0);
+  _raw.str("");
+  _block_epoch = _epoch;
+
+  rewind_to(_file, offset);
+  _offset = offset;
+}
+
+bool programr::read_block_index(std::istream &in, std::vector<BlockIndexEntry> &blocks, std::string &err) {
+  string word;
+  int ver;
+  size_t n;
+  in >> word >> ver;
+  if(!in || word != "programr-block-index" || ver != 1) {
+    err = "not a block index";
+    return false;
+  }
+  in >> word >> n;
+  if(!in || word != "blocks") {
+    err = "bad block count";
+    return false;
+  }
+  blocks.resize(n);
+  for(BlockIndexEntry &b: blocks)
+    in >> b.epoch >> b.offset >> b.packed_n >> b.raw_n;
+  if(!in) {
+    err = "truncated block index";
+    return false;
+  }
+  return true;
+}
+
+bool programr::read_block_header(std::istream &in, std::string &err) {
+  char magic[8];
+  uint64_t ver, zero;
+  if(!in.read(magic, 8) || !std::equal(magic, magic+8, block_magic) ||
+     !get_le(in, ver, 4) || !get_le(in, zero, 4)) {
+    err = "not a compressed trace";
+    return false;
+  }
+  if(ver != BlockEventWriter::version) {
+    err = "unsupported compressed trace version " + to_string(ver);
+    return false;
+  }
+  return true;
+}
+
+bool programr::read_block(std::istream &in, std::string &raw, std::uint64_t &epoch, std::string &err) {
+  err.clear();
+  uint64_t raw_n, packed_n;
+  if(!get_le(in, raw_n, 4)) {
+    if(in.gcount() != 0)
+      err = "truncated block header";
+    return false;
+  }
+  if(!get_le(in, packed_n, 4) || !get_le(in, epoch, 8)) {
+    err = "truncated block header";
+    return false;
+  }
+
+  // lz expands input by at most a byte in 255 plus a little, and one
+  // byte of input decodes to at most about 255 bytes
+  uint64_t left;
+  USER_ASSERT_F(raw_n <= BlockEventWriter::block_max_bytes &&
+                packed_n <= raw_n + raw_n/255 + 16 &&
+                raw_n <= 256*(packed_n + 16),
+    "Bad compressed trace: block at epoch " << epoch << " claims " << packed_n <<
+    " bytes packing " << raw_n << '.');
+  USER_ASSERT_F(!stream_left(in, left) || packed_n <= left,
+    "Bad compressed trace: block at epoch " << epoch << " runs " << packed_n - left <<
+    " bytes past the end of the file.");
+
+  string packed(packed_n, '\0');
+  if(!in.read(&packed[0], packed_n)) {
+    err = "truncated block";
+    return false;
+  }
+
+  raw.resize(raw_n);
+  if(!lz_decompress(packed.data(), packed.size(), &raw[0], raw_n)) {
+    err = "corrupt block at epoch " + to_string(epoch);
+    return false;
+  }
+  return true;
+}
+
+bool programr::read_block_window(std::istream &in, const std::vector<BlockIndexEntry> &blocks,
+                                 std::uint64_t lo, std::uint64_t hi, std::ostream &out, std::string &err) {
+  string raw;
+  uint64_t epoch;
+  err.clear();
+
+  // events stamped with epoch e were emitted in compute epoch e-1 or e
+  out << "<events>\n";
+  for(size_t b=0; b < blocks.size(); b++) {
+    uint64_t first = blocks[b].epoch;
+    bool past_lo = b+1 == blocks.size() || blocks[b+1].epoch + 1 > lo;
+    if(first > hi || !past_lo)
+      continue;
+
+    in.clear();
+    in.seekg(blocks[b].offset);
+    if(!read_block(in, raw, epoch, err)) {
+      if(err.empty())
+        err = "index points past the end of the file";
+      return false;
+    }
+
+    // the lines of `raw` that are events with an epoch in [lo,hi]
+    size_t pos = 0;
+    while(pos < raw.size()) {
+      size_t end = raw.find('\n', pos);
+      end = end == string::npos ? raw.size() : end + 1;
+
+      size_t at = raw.find(" epoch=\"", pos);
+      if(at < end) {
+        uint64_t e = strtoull(raw.c_str() + at + 8, nullptr, 10);
+        if(lo <= e && e <= hi)
+          out.write(raw.data() + pos, end - pos);
+      }
+      pos = end;
+    }
+  }
+  out << "</events>\n";
+  return true;
+}
@@ -0,0 +1,114 @@
+#ifndef _5321c43c_e477_4174_8f5a_9d9b918005a6
+#define _5321c43c_e477_4174_8f5a_9d9b918005a6
+
+# include "eventwriter.hxx"
+
+# include <cstdint>
+# include <iostream>
+# include <sstream>
+# include <string>
+# include <vector>
+
+/* BlockEventWriter produces events.xml compressed in independent blocks
+ * (lowlevel/lz), cut only where TracerXml's compute epoch advances, plus
+ * a side index of where each block is. A reader can then pull out a
+ * window of epochs by decompressing just the blocks covering it.
+ *
+ * The file is "PRGMRLZB", u32 version, u32 zero, then blocks of:
+ *   u32 raw bytes, u32 compressed bytes, u64 first compute epoch, data
+ * all little endian. Concatenating the decompressed blocks gives the
+ * events.xml TracerXml would have written.
+ *
+ * The index, written by finish(), is text:
+ *   programr-block-index 1
+ *   blocks <n>
+ *   <first compute epoch> <file offset> <compressed bytes> <raw bytes>
+ *   ... one line per block, in file order.
+ *
+ * A block holds the events emitted while the compute epoch was in
+ * [its first epoch, the next block's first epoch). Comps are stamped
+ * one past the compute epoch they were emitted in, so events with
+ * epoch="e" are all in blocks covering compute epochs e-1 and e.
+ */
+namespace programr {
+  struct BlockIndexEntry {
+    std::uint64_t epoch; // first compute epoch
+    std::uint64_t offset; // of the block's header in the file
+    std::uint32_t packed_n, raw_n;
+  };
+
+  class BlockEventWriter: public EventWriter {
+    std::ostream *_file;
+    std::string _index_file;
+    std::size_t _block_bytes;
+    std::ostringstream _raw; // xml not yet in a block
+    XmlEventWriter _xml; // writes to _raw
+    std::string _packed;
+    std::vector<BlockIndexEntry> _blocks;
+    std::uint64_t _offset; // bytes written to _file
+    std::uint64_t _epoch = 0; // current compute epoch
+    std::uint64_t _block_epoch = 0; // compute epoch of _raw's first event
+
+  public:
+    static constexpr std::uint32_t version = 1;
+    static constexpr std::size_t header_bytes = 16;
+    static constexpr std::size_t block_header_bytes = 16;
+    // largest block written or read, so a corrupt header can't make a
+    // reader allocate gigabytes
+    static constexpr std::size_t block_max_bytes = std::size_t(1)<<30;
+
+    // cuts a block at the first epoch boundary after `block_bytes` of xml
+    BlockEventWriter(std::ostream *file, std::string index_file, std::size_t block_bytes=1<<22);
+
+    void comm(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      int from, int to,
+      std::size_t bytes,
+      std::uint64_t epoch
+    );
+    void comp(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      int at,
+      double seconds,
+      std::uint64_t epoch,
+      const TaskNote *note
+    );
+    void coll(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      const int *team, std::size_t team_n,
+      std::size_t bytes,
+      std::uint64_t epoch
+    );
+    void epoch_begin(std::uint64_t comp_epoch);
+    void finish();
+
+    // cuts a block so the checkpoint lands on a block boundary
+    std::uint64_t offset();
+    void checkpoint_save(std::ostream &o);
+    void checkpoint_load(std::istream &i, std::uint64_t offset);
+
+  private:
+    void _cut();
+  };
+
+  // Reads an index written by BlockEventWriter, false with a message in
+  // `err` if it can't.
+  bool read_block_index(std::istream &in, std::vector<BlockIndexEntry> &blocks, std::string &err);
+
+  // Reads the block at the file's current position into `raw`, false
+  // with a message in `err` if it is malformed, and also at the end of
+  // the file with `err` left empty. A header whose sizes no block could
+  // have, or that run past the end of a seekable file, is a user error.
+  bool read_block(std::istream &in, std::string &raw, std::uint64_t &epoch, std::string &err);
+  // Checks the file header, leaving `in` at the first block.
+  bool read_block_header(std::istream &in, std::string &err);
+  // Writes to `out` an events.xml of just the events with an epoch in
+  // [lo,hi], decompressing only the blocks `blocks` says can hold them.
+  // False with a message in `err` if a block can't be read.
+  bool read_block_window(std::istream &in, const std::vector<BlockIndexEntry> &blocks,
+                         std::uint64_t lo, std::uint64_t hi, std::ostream &out, std::string &err);
+}
+#endif
@@ -0,0 +1,236 @@
+#include "commmatrix.hxx"
+
+#include <algorithm>
+
+using namespace programr;
+using namespace std;
+
+constexpr std::uint32_t CommMatrix::version;
+
+namespace {
+  const char csr_magic[8] = {'P','R','G','M','R','C','S','R'};
+
+  void put_le(string &buf, uint64_t x, int byte_n) {
+    for(int b=0; b < byte_n; b++)
+      buf.push_back(char(x >> 8*b));
+  }
+
+  bool get_le(istream &i, uint64_t &x, int byte_n) {
+    unsigned char tmp[8];
+    if(!i.read((char*)tmp, byte_n))
+      return false;
+    x = 0;
+    for(int b=0; b < byte_n; b++)
+      x |= uint64_t(tmp[b]) << 8*b;
+    return true;
+  }
+
+  // bytes from the read position to the end, false if `i` can't seek
+  bool stream_left(istream &i, uint64_t &left) {
+    istream::pos_type at = i.tellg();
+    if(at == istream::pos_type(-1))
+      return false;
+    if(!i.seekg(0, ios::end)) {
+      i.clear();
+      return false;
+    }
+    istream::pos_type end = i.tellg();
+    i.seekg(at);
+    left = uint64_t(end - at);
+    return true;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////
+// CommMatrix
+
+uint64_t CommMatrix::bytes_at(int src, int dst) const {
+  if(src < 0 || src >= rank_n || dst < 0)
+    return 0;
+  auto b = cols.begin() + row_at[src];
+  auto e = cols.begin() + row_at[src+1];
+  auto got = std::lower_bound(b, e, uint32_t(dst));
+  return got != e && *got == uint32_t(dst) ? bytes[got - cols.begin()] : 0;
+}
+
+void CommMatrix::write_tsv(std::ostream &o) const {
+  for(int dst=0; dst < rank_n; dst++)
+    o << '\t' << dst;
+  o << '\n';
+  for(int src=0; src < rank_n; src++) {
+    o << src;
+    // walk the row's entries alongside the columns
+    uint64_t k = row_at[src];
+    for(int dst=0; dst < rank_n; dst++) {
+      uint64_t b = 0;
+      if(k < row_at[src+1] && cols[k] == uint32_t(dst))
+        b = bytes[k++];
+      o << '\t' << b;
+    }
+    o << '\n';
+  }
+}
+
+void CommMatrix::write_mtx(std::ostream &o) const {
+  o << "%%MatrixMarket matrix coordinate integer general\n"
+    << "% bytes sent, row is source rank + 1, column destination rank + 1\n"
+    << rank_n << ' ' << rank_n << ' ' << nnz() << '\n';
+  for(int src=0; src < rank_n; src++) {
+    for(uint64_t k=row_at[src]; k < row_at[src+1]; k++)
+      o << src+1 << ' ' << cols[k]+1 << ' ' << bytes[k] << '\n';
+  }
+}
+
+void CommMatrix::write_csr(std::ostream &o) const {
+  string buf;
+  buf.append(csr_magic, 8);
+  put_le(buf, version, 4);
+  put_le(buf, 0, 4);
+  put_le(buf, rank_n, 8);
+  put_le(buf, nnz(), 8);
+  for(uint64_t x: row_at)
+    put_le(buf, x, 8);
+  for(uint32_t x: cols)
+    put_le(buf, x, 4);
+  for(uint64_t x: bytes)
+    put_le(buf, x, 8);
+  for(uint64_t x: msgs)
+    put_le(buf, x, 8);
+  o.write(buf.data(), buf.size());
+}
+
+bool CommMatrix::read_csr(std::istream &i, CommMatrix &m, std::string &err) {
+  char magic[8];
+  uint64_t ver, pad, rank_n, nnz;
+  if(!i.read(magic, 8) || !std::equal(magic, magic+8, csr_magic)) {
+    err = "not a comm matrix";
+    return false;
+  }
+  if(!get_le(i, ver, 4) || !get_le(i, pad, 4) || ver != version) {
+    err = "unknown comm matrix version";
+    return false;
+  }
+  if(!get_le(i, rank_n, 8) || !get_le(i, nnz, 8) || rank_n > (1u<<31)) {
+    err = "truncated comm matrix header";
+    return false;
+  }
+
+  // the counts come from the file, so check them against what a seekable
+  // stream holds before reading, and otherwise grow the arrays only as
+  // entries actually arrive
+  const uint64_t entry_bytes = 4 + 8 + 8;
+  uint64_t left;
+  if(stream_left(i, left) &&
+     (left / 8 < rank_n + 1 || (left - 8*(rank_n + 1)) / entry_bytes < nnz)) {
+    err = "truncated comm matrix";
+    return false;
+  }
+
+  m.rank_n = int(rank_n);
+  m.row_at.clear();
+  m.cols.clear();
+  m.bytes.clear();
+  m.msgs.clear();
+  uint64_t x;
+  bool ok = true;
+  for(uint64_t r=0; ok && r <= rank_n; r++) {
+    ok = get_le(i, x, 8);
+    m.row_at.push_back(x);
+  }
+  for(uint64_t k=0; ok && k < nnz; k++) {
+    ok = get_le(i, x, 4);
+    m.cols.push_back(uint32_t(x));
+  }
+  for(uint64_t k=0; ok && k < nnz; k++) {
+    ok = get_le(i, x, 8);
+    m.bytes.push_back(x);
+  }
+  for(uint64_t k=0; ok && k < nnz; k++) {
+    ok = get_le(i, x, 8);
+    m.msgs.push_back(x);
+  }
+  if(!ok) {
+    err = "truncated comm matrix";
+    return false;
+  }
+
+  if(m.row_at[0] != 0 || m.row_at[rank_n] != nnz) {
+    err = "comm matrix rows don't cover its entries";
+    return false;
+  }
+  for(uint64_t r=0; r < rank_n; r++) {
+    if(m.row_at[r] > m.row_at[r+1]) {
+      err = "comm matrix rows out of order";
+      return false;
+    }
+  }
+  for(uint64_t r=0; r < rank_n; r++) {
+    // bytes_at() binary searches a row's columns
+    for(uint64_t k=m.row_at[r]; k < m.row_at[r+1]; k++) {
+      if(m.cols[k] >= rank_n || (k != m.row_at[r] && m.cols[k-1] >= m.cols[k])) {
+        err = "comm matrix row " + std::to_string(r) + " has columns out of range or order";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+// CommMatrixBuilder
+
+void CommMatrixBuilder::_compact() {
+  if(_sorted_n == _entries.size())
+    return;
+  auto less = [](const Entry &a, const Entry &b) {
+    return a.src != b.src ? a.src < b.src : a.dst < b.dst;
+  };
+  auto mid = _entries.begin() + _sorted_n;
+  std::sort(mid, _entries.end(), less);
+  std::inplace_merge(_entries.begin(), mid, _entries.end(), less);
+
+  size_t n = 0;
+  for(size_t i=0; i < _entries.size(); i++) {
+    const Entry &e = _entries[i];
+    if(n != 0 && _entries[n-1].src == e.src && _entries[n-1].dst == e.dst) {
+      _entries[n-1].bytes += e.bytes;
+      _entries[n-1].msgs += e.msgs;
+    }
+    else
+      _entries[n++] = e;
+  }
+  _entries.resize(n);
+  _sorted_n = n;
+}
+
+void CommMatrixBuilder::merge(const CommMatrixBuilder &that) {
+  _entries.insert(_entries.end(), that._entries.begin(), that._entries.end());
+  _compact();
+}
+
+const std::vector<CommMatrixBuilder::Entry>& CommMatrixBuilder::entries() {
+  _compact();
+  return _entries;
+}
+
+CommMatrix CommMatrixBuilder::build(int rank_n) {
+  _compact();
+  for(const Entry &e: _entries)
+    rank_n = std::max(rank_n, std::max(e.src, e.dst) + 1);
+
+  CommMatrix m;
+  m.rank_n = rank_n;
+  m.row_at.assign(rank_n + 1, 0);
+  m.cols.reserve(_entries.size());
+  m.bytes.reserve(_entries.size());
+  m.msgs.reserve(_entries.size());
+  for(const Entry &e: _entries) {
+    m.row_at[e.src + 1] += 1;
+    m.cols.push_back(e.dst);
+    m.bytes.push_back(e.bytes);
+    m.msgs.push_back(e.msgs);
+  }
+  for(int r=0; r < rank_n; r++)
+    m.row_at[r+1] += m.row_at[r];
+  return m;
+}
@@ -0,0 +1,81 @@
+#ifndef _c5e1a2d7_6b38_4f0e_9a41_7d2f8e3b9c06
+#define _c5e1a2d7_6b38_4f0e_9a41_7d2f8e3b9c06
+
+# include <cstdint>
+# include <iostream>
+# include <string>
+# include <vector>
+
+/* CommMatrix holds the bytes and messages each rank sent each other rank,
+ * in compressed sparse row form: the ranks `src` sent to are
+ * cols[row_at[src]] up to cols[row_at[src+1]], ascending, with their
+ * totals at the same positions of bytes and msgs. Memory is in the pairs
+ * that talked, never rank_n^2.
+ *
+ * CommMatrixBuilder gathers the totals as messages are seen. Entries are
+ * appended and every so often sorted and summed in place, so it holds at
+ * most about twice the distinct pairs. Builders filled separately, say
+ * one per thread, merge() into one before build().
+ *
+ * Export formats:
+ *   tsv: the dense table comm_totals.tsv always had, a header row of
+ *     destinations then a row of bytes per source. rank_n^2 cells, so
+ *     only for small runs.
+ *   mtx: MatrixMarket coordinate, 1-based, of bytes.
+ *   csr: binary, fixed width little endian so it can be mapped as is:
+ *     "PRGMRCSR" u32 version u32 0 u64 rank_n u64 nnz
+ *     u64 row_at[rank_n+1] u32 cols[nnz] u64 bytes[nnz] u64 msgs[nnz]
+ */
+namespace programr {
+  struct CommMatrix {
+    static constexpr std::uint32_t version = 1;
+
+    int rank_n = 0;
+    std::vector<std::uint64_t> row_at{0};
+    std::vector<std::uint32_t> cols;
+    std::vector<std::uint64_t> bytes, msgs;
+
+    std::size_t nnz() const { return cols.size(); }
+    // bytes `src` sent `dst`, 0 if none
+    std::uint64_t bytes_at(int src, int dst) const;
+
+    void write_tsv(std::ostream &o) const;
+    void write_mtx(std::ostream &o) const;
+    void write_csr(std::ostream &o) const;
+    // reads what write_csr() wrote, false with `err` set if it can't
+    static bool read_csr(std::istream &i, CommMatrix &m, std::string &err);
+  };
+
+  class CommMatrixBuilder {
+  public:
+    struct Entry {
+      int src, dst;
+      std::uint64_t bytes, msgs;
+    };
+
+  private:
+    std::vector<Entry> _entries;
+    std::size_t _sorted_n = 0; // entries sorted and summed from the front
+
+  public:
+    void add(int src, int dst, std::uint64_t bytes, std::uint64_t msgs=1) {
+      _entries.push_back(Entry{src, dst, bytes, msgs});
+      if(_entries.size() >= 2*_sorted_n + 1024)
+        _compact();
+    }
+
+    // folds in everything `that` gathered
+    void merge(const CommMatrixBuilder &that);
+
+    // distinct pairs, sorted by (src, dst)
+    const std::vector<Entry>& entries();
+    void clear() { _entries.clear(); _sorted_n = 0; }
+
+    // ranks past the largest seen are added up to `rank_n`
+    CommMatrix build(int rank_n=0);
+
+  private:
+    void _compact();
+  };
+}
+#endif
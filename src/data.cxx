@@ -1,3 +1,4 @@
 #include "data.hxx"
 
 std::uint64_t programr::Data::_id_next = 0;
+std::uint64_t programr::Data::live_n = 0;
@@ -8,12 +8,13 @@
 namespace programr {
   struct Data: Referent {
     static std::uint64_t _id_next;
+    static std::uint64_t live_n; // datas constructed but not yet destructed
     
     const std::uint64_t id;
     std::function<void(Data*)> retirer;
     
-    Data(): id(_id_next++) {}
-    ~Data() { if(retirer) retirer(this); }
+    Data(): id(_id_next++) { live_n += 1; }
+    ~Data() { live_n -= 1; if(retirer) retirer(this); }
   };
 }
 #endif
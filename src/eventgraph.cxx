@@ -0,0 +1,388 @@
+#include "eventgraph.hxx"
+#include "templatewriter.hxx"
+#include "lowlevel/mappedfile.hxx"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+using namespace programr;
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////
+// EventGraph
+
+const uint32_t EventGraph::no_team;
+
+void EventGraph::add(uint64_t id, const uint64_t *dep_ids, size_t dep_n) {
+  add_comp(id, dep_ids, dep_n, -1, 0, 0);
+}
+
+void EventGraph::add_comm(uint64_t id, const uint64_t *dep_ids, size_t dep_n, int from, int to, uint64_t bytes, uint64_t epoch) {
+  ids.push_back(id);
+  deps.insert(deps.end(), dep_ids, dep_ids + dep_n);
+  dep_at.push_back(deps.size());
+  kinds.push_back(EventKind::comm);
+  ranks.push_back(from);
+  peers.push_back(to);
+  sizes.push_back(bytes);
+  times.push_back(0);
+  epochs.push_back(epoch);
+  team.push_back(no_team);
+}
+
+void EventGraph::add_comp(uint64_t id, const uint64_t *dep_ids, size_t dep_n, int at, double seconds, uint64_t epoch) {
+  ids.push_back(id);
+  deps.insert(deps.end(), dep_ids, dep_ids + dep_n);
+  dep_at.push_back(deps.size());
+  kinds.push_back(EventKind::comp);
+  ranks.push_back(at);
+  peers.push_back(-1);
+  sizes.push_back(0);
+  times.push_back(seconds);
+  epochs.push_back(epoch);
+  team.push_back(no_team);
+}
+
+void EventGraph::add_coll(uint64_t id, const uint64_t *dep_ids, size_t dep_n, const int *members, size_t member_n, uint64_t bytes, uint64_t epoch) {
+  ids.push_back(id);
+  deps.insert(deps.end(), dep_ids, dep_ids + dep_n);
+  dep_at.push_back(deps.size());
+  kinds.push_back(EventKind::coll);
+  ranks.push_back(-1);
+  peers.push_back(-1);
+  sizes.push_back(bytes);
+  times.push_back(0);
+  epochs.push_back(epoch);
+  team.push_back(teams.intern(members, member_n));
+}
+
+void EventGraph::append(const EventGraph &that) {
+  size_t base = deps.size();
+  ids.insert(ids.end(), that.ids.begin(), that.ids.end());
+  deps.insert(deps.end(), that.deps.begin(), that.deps.end());
+  for(size_t i=1; i < that.dep_at.size(); i++)
+    dep_at.push_back(base + that.dep_at[i]);
+
+  kinds.insert(kinds.end(), that.kinds.begin(), that.kinds.end());
+  ranks.insert(ranks.end(), that.ranks.begin(), that.ranks.end());
+  peers.insert(peers.end(), that.peers.begin(), that.peers.end());
+  sizes.insert(sizes.end(), that.sizes.begin(), that.sizes.end());
+  times.insert(times.end(), that.times.begin(), that.times.end());
+  epochs.insert(epochs.end(), that.epochs.begin(), that.epochs.end());
+
+  vector<uint32_t> remap(that.teams.size());
+  for(uint32_t t=0; t < remap.size(); t++) {
+    const vector<int> &r = that.teams.ranks(t);
+    remap[t] = teams.intern(r.data(), r.size());
+  }
+  for(uint32_t t: that.team)
+    team.push_back(t == no_team ? no_team : remap[t]);
+}
+
+vector<int64_t> EventGraph::index_by_id() const {
+  uint64_t id_max = 0;
+  for(uint64_t id: ids)
+    id_max = std::max(id_max, id);
+
+  vector<int64_t> ix(ids.empty() ? 0 : id_max+1, -1);
+  for(size_t i=0; i < ids.size(); i++) {
+    if(ix[ids[i]] == -1)
+      ix[ids[i]] = i;
+  }
+  return ix;
+}
+
+vector<int64_t> EventGraph::dep_indices(Workers &pool) const {
+  vector<int64_t> ix = index_by_id();
+  vector<int64_t> dix(deps.size());
+  pool.parallel_for(deps.size(), 1<<14, [&](size_t d, int) {
+    dix[d] = deps[d] < ix.size() ? ix[deps[d]] : -1;
+  });
+  return dix;
+}
+
+////////////////////////////////////////////////////////////////////////
+// events.xml scanner
+
+namespace {
+  const uint32_t team_is_ref = uint32_t(1) << 31;
+
+  // The events of one chunk of text. Team lists are interned locally;
+  // an event's team is its local id, or team_is_ref|n for team="tn".
+  struct Chunk {
+    EventGraph g;
+    vector<pair<uint64_t,uint32_t>> team_defs; // <team id="tn">: n, local id
+    string err;
+  };
+
+  bool number(const char *lo, const char *hi, uint64_t &x) {
+    x = 0;
+    const char *p = lo;
+    while(p != hi && *p >= '0' && *p <= '9')
+      x = 10*x + (*p++ - '0');
+    return p != lo && p == hi;
+  }
+
+  bool number(const char *lo, const char *hi, int &x) {
+    bool neg = lo != hi && *lo == '-';
+    uint64_t u;
+    if(!number(lo + neg, hi, u))
+      return false;
+    x = neg ? -int(u) : int(u);
+    return true;
+  }
+
+  // the value is always followed by its closing quote, which stops strtod
+  bool number(const char *lo, const char *hi, double &x) {
+    uint64_t u;
+    if(number(lo, hi, u)) {
+      x = double(u);
+      return true;
+    }
+    char *end;
+    x = strtod(lo, &end);
+    return lo != hi && end == hi;
+  }
+
+  // "e1,e2,.." or "1,2,.." with `prefix` the letter before each number
+  bool number_list(const char *lo, const char *hi, char prefix, vector<uint64_t> &xs) {
+    xs.clear();
+    while(lo != hi) {
+      if(prefix && *lo++ != prefix)
+        return false;
+      uint64_t x = 0;
+      const char *p = lo;
+      while(p != hi && *p >= '0' && *p <= '9')
+        x = 10*x + (*p++ - '0');
+      if(p == lo)
+        return false;
+      xs.push_back(x);
+      lo = p;
+      if(lo != hi && *lo++ != ',')
+        return false;
+    }
+    return true;
+  }
+
+  // parses the event lines in text[lo,hi), which holds whole lines
+  void scan_lines(const char *text, size_t lo, size_t hi, Chunk &ch) {
+    EventGraph &g = ch.g;
+    vector<uint64_t> dep_ids, list;
+    vector<int> team_ranks;
+
+    const char *p = text + lo, *end = text + hi;
+    while(p < end) {
+      const char *nl = static_cast<const char*>(memchr(p, '\n', end - p));
+      const char *eol = nl ? nl : end;
+      const char *line = p;
+      p = eol + 1;
+
+      if(eol - line < 6 || line[0] != '<' || line[5] != ' ')
+        continue;
+      int tag;
+      if(!memcmp(line, "<comp", 5)) tag = 0;
+      else if(!memcmp(line, "<comm", 5)) tag = 1;
+      else if(!memcmp(line, "<coll", 5)) tag = 2;
+      else if(!memcmp(line, "<team", 5)) tag = 3;
+      else continue;
+
+      bool has_id = false, has_dep = false, has_team = false, is_ref = false;
+      uint64_t id = 0, size = 0, epoch = 0, team_ref = 0;
+      int at = -1, to = -1;
+      double time = 0;
+      bool ok = true;
+
+      // name="value" pairs up to the closing />
+      const char *q = line + 5;
+      while(ok) {
+        while(q < eol && *q == ' ')
+          q++;
+        if(q == eol || *q == '/' || *q == '>')
+          break;
+        const char *name = q;
+        const char *eq = static_cast<const char*>(memchr(q, '=', eol - q));
+        if(!eq || eq + 1 == eol || eq[1] != '"') {
+          ok = false;
+          break;
+        }
+        const char *v = eq + 2;
+        const char *v_end = static_cast<const char*>(memchr(v, '"', eol - v));
+        if(!v_end) {
+          ok = false;
+          break;
+        }
+        q = v_end + 1;
+
+        size_t name_n = eq - name;
+        #define NAME_IS(s) (name_n == sizeof(s)-1 && !memcmp(name, s, name_n))
+        if(NAME_IS("id")) {
+          has_id = true;
+          ok = v != v_end && *v == (tag == 3 ? 't' : 'e') && number(v+1, v_end, id);
+        }
+        else if(NAME_IS("dep")) {
+          has_dep = true;
+          ok = number_list(v, v_end, 'e', dep_ids);
+        }
+        else if(NAME_IS("at") || NAME_IS("from"))
+          ok = number(v, v_end, at);
+        else if(NAME_IS("to"))
+          ok = number(v, v_end, to);
+        else if(NAME_IS("time"))
+          ok = number(v, v_end, time);
+        else if(NAME_IS("size"))
+          ok = number(v, v_end, size);
+        else if(NAME_IS("epoch"))
+          ok = number(v, v_end, epoch);
+        else if(NAME_IS("team") || NAME_IS("ranks")) {
+          has_team = true;
+          if(v != v_end && *v == 't') {
+            is_ref = true;
+            ok = number(v+1, v_end, team_ref) && team_ref < team_is_ref;
+          }
+          else {
+            ok = number_list(v, v_end, 0, list);
+            team_ranks.assign(list.begin(), list.end());
+          }
+        }
+        #undef NAME_IS
+      }
+
+      if(!ok || !has_id || (tag == 3 ? !has_team : !has_dep) || (tag == 2 && !has_team)) {
+        ch.err = "bad event: " + string(line, eol - line);
+        return;
+      }
+
+      switch(tag) {
+      case 0:
+        g.add_comp(id, dep_ids.data(), dep_ids.size(), at, time, epoch);
+        break;
+      case 1:
+        g.add_comm(id, dep_ids.data(), dep_ids.size(), at, to, size, epoch);
+        break;
+      case 2:
+        if(is_ref) {
+          g.add_comm(id, dep_ids.data(), dep_ids.size(), -1, -1, size, epoch);
+          g.kinds.back() = EventKind::coll;
+          g.team.back() = team_is_ref | uint32_t(team_ref);
+        }
+        else
+          g.add_coll(id, dep_ids.data(), dep_ids.size(), team_ranks.data(), team_ranks.size(), size, epoch);
+        break;
+      case 3:
+        ch.team_defs.emplace_back(id, g.teams.intern(team_ranks.data(), team_ranks.size()));
+        break;
+      }
+    }
+  }
+}
+
+bool programr::parse_event_graph_xml(const char *text, size_t n, Workers &pool, EventGraph &graph, string &err) {
+  // cut the text at line breaks into a few chunks per worker
+  size_t chunk_n = 8*pool.size();
+  vector<size_t> cut{0};
+  for(size_t c=1; c < chunk_n; c++) {
+    size_t at = std::max(cut.back(), n*c/chunk_n);
+    const char *nl = at < n ? static_cast<const char*>(memchr(text + at, '\n', n - at)) : nullptr;
+    at = nl ? nl - text + 1 : n;
+    cut.push_back(at);
+  }
+  cut.push_back(n);
+
+  vector<Chunk> chunks(chunk_n);
+  pool.parallel_for(chunk_n, 1, [&](size_t c, int) {
+    scan_lines(text, cut[c], cut[c+1], chunks[c]);
+  });
+
+  // teams in file order: intern each chunk's lists into the graph's table
+  // and resolve references, which always follow their <team>
+  vector<vector<uint32_t>> team_map(chunk_n);
+  vector<uint32_t> refs; // team="tn" -> graph team
+  for(size_t c=0; c < chunk_n; c++) {
+    Chunk &ch = chunks[c];
+    if(!ch.err.empty()) {
+      err = ch.err;
+      return false;
+    }
+    for(uint32_t t=0; t < ch.g.teams.size(); t++) {
+      const vector<int> &r = ch.g.teams.ranks(t);
+      team_map[c].push_back(graph.teams.intern(r.data(), r.size()));
+    }
+    for(const pair<uint64_t,uint32_t> &def: ch.team_defs) {
+      if(def.first >= refs.size())
+        refs.resize(def.first+1, EventGraph::no_team);
+      refs[def.first] = team_map[c][def.second];
+    }
+    for(uint32_t &t: ch.g.team) {
+      if(t != EventGraph::no_team && (t & team_is_ref)) {
+        uint32_t r = t & ~team_is_ref;
+        if(r >= refs.size() || refs[r] == EventGraph::no_team) {
+          err = "team t" + to_string(r) + " used before it is listed";
+          return false;
+        }
+        t = refs[r] | team_is_ref;
+      }
+    }
+  }
+
+  // lay the chunks end to end, in parallel
+  vector<size_t> ev_at{graph.size()}, dep_base{graph.deps.size()};
+  for(size_t c=0; c < chunk_n; c++) {
+    ev_at.push_back(ev_at.back() + chunks[c].g.size());
+    dep_base.push_back(dep_base.back() + chunks[c].g.deps.size());
+  }
+  size_t ev_n = ev_at.back();
+  graph.ids.resize(ev_n);
+  graph.dep_at.resize(ev_n + 1);
+  graph.deps.resize(dep_base.back());
+  graph.kinds.resize(ev_n);
+  graph.ranks.resize(ev_n);
+  graph.peers.resize(ev_n);
+  graph.sizes.resize(ev_n);
+  graph.times.resize(ev_n);
+  graph.epochs.resize(ev_n);
+  graph.team.resize(ev_n);
+
+  pool.parallel_for(chunk_n, 1, [&](size_t c, int) {
+    const EventGraph &g = chunks[c].g;
+    size_t at = ev_at[c];
+    std::copy(g.ids.begin(), g.ids.end(), graph.ids.begin() + at);
+    std::copy(g.deps.begin(), g.deps.end(), graph.deps.begin() + dep_base[c]);
+    for(size_t i=0; i < g.size(); i++)
+      graph.dep_at[at + i + 1] = dep_base[c] + g.dep_at[i+1];
+    std::copy(g.kinds.begin(), g.kinds.end(), graph.kinds.begin() + at);
+    std::copy(g.ranks.begin(), g.ranks.end(), graph.ranks.begin() + at);
+    std::copy(g.peers.begin(), g.peers.end(), graph.peers.begin() + at);
+    std::copy(g.sizes.begin(), g.sizes.end(), graph.sizes.begin() + at);
+    std::copy(g.times.begin(), g.times.end(), graph.times.begin() + at);
+    std::copy(g.epochs.begin(), g.epochs.end(), graph.epochs.begin() + at);
+    for(size_t i=0; i < g.size(); i++) {
+      uint32_t t = g.team[i];
+      if(t != EventGraph::no_team)
+        t = (t & team_is_ref) ? t & ~team_is_ref : team_map[c][t];
+      graph.team[at + i] = t;
+    }
+  });
+  return true;
+}
+
+bool programr::read_event_graph(const string &path, Workers &pool, EventGraph &graph, string &err) {
+  MappedFile file;
+  if(!file.open(path, err))
+    return false;
+
+  bool binary = file.size() >= 8 && !memcmp(file.data(), "PRGMRBIN", 8);
+  if(binary || is_templated_xml(file.data(), file.size())) {
+    // both are read front to back, expanding into events as they go
+    file.close();
+    ifstream in(path, ios::in | ios::binary);
+    EventGraphWriter collect;
+    collect.graph = std::move(graph);
+    bool ok = binary ? read_binary_events(in, collect, err) : read_templated_events(in, collect, err);
+    graph = std::move(collect.graph);
+    return ok;
+  }
+
+  return parse_event_graph_xml(file.data(), file.size(), pool, graph, err);
+}
@@ -0,0 +1,104 @@
+#ifndef _da3496d8_c47f_4e38_9462_b136381601cf
+#define _da3496d8_c47f_4e38_9462_b136381601cf
+
+# include "eventwriter.hxx"
+# include "teamtable.hxx"
+# include "lowlevel/workers.hxx"
+
+# include <cstdint>
+# include <string>
+# include <vector>
+
+/* EventGraph holds a whole trace in memory for analysis passes: the
+ * dependencies in CSR form and every event's attributes in parallel
+ * arrays indexed by event. read_event_graph() loads one from an
+ * events.xml, mapping the file and scanning it over a pool of threads,
+ * or from a binary trace.
+ */
+namespace programr {
+  enum class EventKind: std::uint8_t { comp = 0, comm = 1, coll = 2 };
+
+  // Event i has id ids[i] and deps deps[dep_at[i], dep_at[i+1]). The
+  // attribute a kind of event doesn't have is -1 for ranks, 0 otherwise.
+  struct EventGraph {
+    static const std::uint32_t no_team = ~std::uint32_t(0);
+
+    std::vector<std::uint64_t> ids;
+    std::vector<std::size_t> dep_at{0};
+    std::vector<std::uint64_t> deps;
+
+    std::vector<EventKind> kinds;
+    std::vector<int> ranks; // comp: at, comm: from
+    std::vector<int> peers; // comm: to
+    std::vector<std::uint64_t> sizes; // comm and coll bytes
+    std::vector<double> times; // comp seconds
+    std::vector<std::uint64_t> epochs;
+    std::vector<std::uint32_t> team; // coll: its team in `teams`, else no_team
+    TeamTable teams;
+
+    std::size_t size() const { return ids.size(); }
+    std::size_t dep_n(std::size_t i) const { return dep_at[i+1] - dep_at[i]; }
+
+    // a comp with no attributes, for building graphs by hand
+    void add(std::uint64_t id, const std::uint64_t *deps, std::size_t dep_n);
+    void add_comm(std::uint64_t id, const std::uint64_t *deps, std::size_t dep_n, int from, int to, std::uint64_t bytes, std::uint64_t epoch);
+    void add_comp(std::uint64_t id, const std::uint64_t *deps, std::size_t dep_n, int at, double seconds, std::uint64_t epoch);
+    void add_coll(std::uint64_t id, const std::uint64_t *deps, std::size_t dep_n, const int *team, std::size_t team_n, std::uint64_t bytes, std::uint64_t epoch);
+
+    // appends `that`'s events, say the next shard of a sharded trace
+    void append(const EventGraph &that);
+
+    // the index of the event with each id, -1 for ids with no event. An
+    // id defined twice maps to its first event.
+    std::vector<std::int64_t> index_by_id() const;
+    // deps as event indices, parallel to `deps`, -1 for undefined ones
+    std::vector<std::int64_t> dep_indices(Workers &pool) const;
+  };
+
+  // Collects the events written to it into `graph`.
+  struct EventGraphWriter: EventWriter {
+    EventGraph graph;
+
+    void comm(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      int from, int to,
+      std::size_t bytes,
+      std::uint64_t epoch
+    ) {
+      graph.add_comm(id, deps, dep_n, from, to, bytes, epoch);
+    }
+    void comp(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      int at,
+      double seconds,
+      std::uint64_t epoch,
+      const TaskNote *note
+    ) {
+      graph.add_comp(id, deps, dep_n, at, seconds, epoch);
+    }
+    void coll(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      const int *team, std::size_t team_n,
+      std::size_t bytes,
+      std::uint64_t epoch
+    ) {
+      graph.add_coll(id, deps, dep_n, team, team_n, bytes, epoch);
+    }
+    void finish() {}
+    std::uint64_t offset() { return 0; }
+    void checkpoint_load(std::istream &i, std::uint64_t offset) {}
+  };
+
+  // Parses the events in events.xml text, splitting the text over
+  // `pool`, and appends them to `graph`. Understands team references
+  // (teams=ref). False with a message in `err` on a malformed event.
+  bool parse_event_graph_xml(const char *text, std::size_t n, Workers &pool, EventGraph &graph, std::string &err);
+
+  // Loads an events.xml, a templated one (templates=1) or a binary trace
+  // (format=bin) into `graph`.
+  bool read_event_graph(const std::string &path, Workers &pool, EventGraph &graph, std::string &err);
+}
+#endif
@@ -0,0 +1,793 @@
+#include "eventwriter.hxx"
+#include "diagnostic.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+using namespace programr;
+using namespace std;
+
+void programr::rewind_to(ostream *file, uint64_t offset) {
+  file->flush();
+  file->seekp(0, std::ios::end);
+  USER_ASSERT_F(*file && (uint64_t)file->tellp() >= offset,
+    "Output is shorter than the " << offset << " bytes written when the checkpoint was made."
+  );
+  file->seekp(offset);
+  USER_ASSERT_F(*file, "Could not seek output to offset " << offset << " of checkpoint.");
+}
+
+////////////////////////////////////////////////////////////////////////
+// TeamRefs
+
+uint64_t TeamRefs::ref(const int *team, size_t n, bool &fresh) {
+  _key.assign(reinterpret_cast<const char*>(team), n*sizeof(int));
+  auto got = _ids.find(_key);
+  fresh = got == _ids.end();
+  if(!fresh)
+    return got->second;
+
+  uint64_t id = _lists.size();
+  _ids.emplace(_key, id);
+  _lists.emplace_back(team, team + n);
+  return id;
+}
+
+void TeamRefs::checkpoint_save(std::ostream &o) const {
+  o << "teams " << _lists.size() << '\n';
+  for(const vector<int> &list: _lists) {
+    o << list.size();
+    for(int rank: list)
+      o << ' ' << rank;
+    o << '\n';
+  }
+}
+
+void TeamRefs::checkpoint_load(std::istream &i) {
+  string word;
+  size_t n;
+  i >> word >> n;
+  USER_ASSERT(i && word == "teams", "Bad checkpoint file: expected written teams.");
+
+  _ids.clear();
+  _lists.clear();
+  vector<int> list;
+  for(size_t t=0; t < n; t++) {
+    size_t rank_n;
+    i >> rank_n;
+    list.resize(rank_n);
+    for(int &rank: list)
+      i >> rank;
+    bool fresh;
+    ref(list.data(), list.size(), fresh);
+  }
+  USER_ASSERT(i, "Bad checkpoint file: written teams.");
+}
+
+////////////////////////////////////////////////////////////////////////
+// XmlEventWriter
+
+namespace {
+  // `_buf` is handed to the stream once it gets this big
+  const size_t xml_flush_bytes = 1<<16;
+
+  template<size_t n>
+  inline void put_lit(string &buf, const char (&lit)[n]) {
+    buf.append(lit, n-1);
+  }
+
+  inline void put_uint(string &buf, uint64_t x) {
+    char tmp[20];
+    int n = 0;
+    do {
+      tmp[n++] = char('0' + x%10);
+      x /= 10;
+    } while(x != 0);
+    while(n != 0)
+      buf.push_back(tmp[--n]);
+  }
+
+  inline void put_int(string &buf, int64_t x) {
+    if(x < 0) {
+      buf.push_back('-');
+      put_uint(buf, 0 - uint64_t(x));
+    }
+    else
+      put_uint(buf, uint64_t(x));
+  }
+
+  // formats like ostream's default for doubles, which is printf's %g
+  inline void put_double(string &buf, double x) {
+    // whole numbers below 1e6 print as plain integers under %g
+    if(x >= 0 && x < 1e6 && x == double(uint64_t(x)) && !(x == 0 && std::signbit(x)))
+      put_uint(buf, uint64_t(x));
+    else {
+      char tmp[32];
+      int n = std::snprintf(tmp, sizeof(tmp), "%g", x);
+      buf.append(tmp, n);
+    }
+  }
+
+  inline void put_event_ids(string &buf, const uint64_t *ids, size_t n) {
+    for(size_t i=0; i < n; i++) {
+      if(i != 0) buf.push_back(',');
+      buf.push_back('e');
+      put_uint(buf, ids[i]);
+    }
+  }
+}
+
+void programr::put_xml_comm(
+    string &b,
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    int from, int to,
+    size_t bytes,
+    uint64_t epoch
+  ) {
+  put_lit(b, "<comm id=\"e");
+  put_uint(b, id);
+  put_lit(b, "\" dep=\"");
+  put_event_ids(b, deps, dep_n);
+  put_lit(b, "\" from=\"");
+  put_int(b, from);
+  put_lit(b, "\" to=\"");
+  put_int(b, to);
+  put_lit(b, "\" size=\"");
+  put_uint(b, bytes);
+  put_lit(b, "\" epoch=\"");
+  put_uint(b, epoch);
+  put_lit(b, "\" />\n");
+}
+
+void programr::put_xml_comp(
+    string &b,
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    int at,
+    double seconds,
+    uint64_t epoch,
+    const TaskNote *note
+  ) {
+  put_lit(b, "<comp id=\"e");
+  put_uint(b, id);
+  put_lit(b, "\" dep=\"");
+  put_event_ids(b, deps, dep_n);
+  put_lit(b, "\" at=\"");
+  put_int(b, at);
+  put_lit(b, "\" time=\"");
+  put_double(b, seconds);
+  put_lit(b, "\" epoch=\"");
+  put_uint(b, epoch);
+  put_lit(b, "\" ");
+  if(note) {
+    // "<name> lev=<lev> box=<box>", as TaskNote prints
+    put_lit(b, "note=\"");
+    b += TaskNote::name(note->op);
+    put_lit(b, " lev=");
+    put_int(b, note->lev);
+    put_lit(b, " box=");
+    put_int(b, note->box);
+    put_lit(b, "\" ");
+  }
+  put_lit(b, "/>\n");
+}
+
+void programr::put_xml_coll(
+    string &b,
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    const int *team, size_t team_n,
+    size_t bytes,
+    uint64_t epoch,
+    int64_t team_ref
+  ) {
+  put_lit(b, "<coll id=\"e");
+  put_uint(b, id);
+  put_lit(b, "\" dep=\"");
+  put_event_ids(b, deps, dep_n);
+  put_lit(b, "\" type=\"ALLREDUCE\" team=\"");
+  if(team_ref >= 0) {
+    b.push_back('t');
+    put_uint(b, uint64_t(team_ref));
+  }
+  else {
+    for(size_t i=0; i < team_n; i++) {
+      if(i != 0) b.push_back(',');
+      put_int(b, team[i]);
+    }
+  }
+  put_lit(b, "\" size=\"");
+  put_uint(b, bytes);
+  put_lit(b, "\" epoch=\"");
+  put_uint(b, epoch);
+  put_lit(b, "\" />\n");
+}
+
+XmlEventWriter::XmlEventWriter(std::ostream *file, bool team_refs):
+  _file(file),
+  _team_refs(team_refs) {
+  _buf.reserve(xml_flush_bytes + 1024);
+  put_lit(_buf, "<events>\n");
+}
+
+void XmlEventWriter::_flush() {
+  _file->write(_buf.data(), _buf.size());
+  _buf.clear();
+}
+
+void XmlEventWriter::comm(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    int from, int to,
+    size_t bytes,
+    uint64_t epoch
+  ) {
+  put_xml_comm(_buf, id, deps, dep_n, from, to, bytes, epoch);
+  if(_buf.size() >= xml_flush_bytes)
+    _flush();
+}
+
+void XmlEventWriter::comp(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    int at,
+    double seconds,
+    uint64_t epoch,
+    const TaskNote *note
+  ) {
+  put_xml_comp(_buf, id, deps, dep_n, at, seconds, epoch, note);
+  if(_buf.size() >= xml_flush_bytes)
+    _flush();
+}
+
+void XmlEventWriter::coll(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    const int *team, size_t team_n,
+    size_t bytes,
+    uint64_t epoch
+  ) {
+  string &b = _buf;
+  int64_t team_ref = -1;
+  if(_team_refs) {
+    bool fresh;
+    team_ref = int64_t(_teams.ref(team, team_n, fresh));
+    if(fresh) {
+      put_lit(b, "<team id=\"t");
+      put_uint(b, uint64_t(team_ref));
+      put_lit(b, "\" ranks=\"");
+      for(size_t i=0; i < team_n; i++) {
+        if(i != 0) b.push_back(',');
+        put_int(b, team[i]);
+      }
+      put_lit(b, "\" />\n");
+    }
+  }
+
+  put_xml_coll(b, id, deps, dep_n, team, team_n, bytes, epoch, team_ref);
+  if(b.size() >= xml_flush_bytes)
+    _flush();
+}
+
+void XmlEventWriter::finish() {
+  put_lit(_buf, "</events>\n");
+  _flush();
+  _file->flush();
+}
+
+void XmlEventWriter::text(const string &s) {
+  _buf += s;
+  if(_buf.size() >= xml_flush_bytes)
+    _flush();
+}
+
+uint64_t XmlEventWriter::offset() {
+  _flush();
+  _file->flush();
+  return (uint64_t)_file->tellp();
+}
+
+void XmlEventWriter::checkpoint_save(std::ostream &o) {
+  if(_team_refs)
+    _teams.checkpoint_save(o);
+}
+
+void XmlEventWriter::checkpoint_load(std::istream &i, uint64_t offset) {
+  if(_team_refs)
+    _teams.checkpoint_load(i);
+  _buf.clear();
+  rewind_to(_file, offset);
+}
+
+////////////////////////////////////////////////////////////////////////
+// BinaryEventWriter
+
+namespace {
+  const char bin_magic[8] = {'P','R','G','M','R','B','I','N'};
+
+  // `_buf` is handed to the stream once it gets this big
+  const size_t bin_flush_bytes = 1<<16;
+  // most distinct seconds values remembered for repeating
+  const size_t bin_secs_max = 1<<16;
+
+  void put_le(string &buf, uint64_t x, int byte_n) {
+    for(int b=0; b < byte_n; b++)
+      buf.push_back(char(x >> 8*b));
+  }
+}
+
+BinaryEventWriter::BinaryEventWriter(std::ostream *file, int rank_n):
+  _file(file),
+  _rank_n(rank_n) {
+  _buf.reserve(bin_flush_bytes + 1024);
+  _header();
+}
+
+BinaryEventWriter::~BinaryEventWriter() {
+  _flush();
+}
+
+void BinaryEventWriter::_header() {
+  _buf.append(bin_magic, 8);
+  put_le(_buf, version, 4);
+  put_le(_buf, 0, 4);
+  put_le(_buf, _rank_n, 8);
+  put_le(_buf, _epoch_n, 8);
+  put_le(_buf, _event_n, 8);
+}
+
+void BinaryEventWriter::_flush() {
+  _file->write(_buf.data(), _buf.size());
+  _flushed += _buf.size();
+  _buf.clear();
+}
+
+void BinaryEventWriter::_put_u64(uint64_t x) {
+  while(x >= 0x80) {
+    _buf.push_back(char(0x80 | (x & 0x7f)));
+    x >>= 7;
+  }
+  _buf.push_back(char(x));
+}
+
+void BinaryEventWriter::_put_id(uint64_t id) {
+  uint64_t lane = id % 3;
+  int64_t d = int64_t(id/3 - _prev_n[lane]);
+  _put_u64(3*((uint64_t(d) << 1) ^ uint64_t(d >> 63)) + lane);
+}
+
+void BinaryEventWriter::_put_id_deps(uint64_t id, const uint64_t *deps, size_t dep_n) {
+  _put_id(id);
+
+  _put_u64(dep_n);
+  for(size_t i=0; i < dep_n; i++)
+    _put_id(deps[i]);
+
+  _prev_n[id % 3] = id/3;
+  _event_n += 1;
+}
+
+void BinaryEventWriter::_put_seconds(double seconds) {
+  uint64_t bits;
+  std::memcpy(&bits, &seconds, 8);
+
+  auto got = _secs.find(bits);
+  if(got != _secs.end())
+    _put_u64(got->second + 1);
+  else {
+    _put_u64(0);
+    put_le(_buf, bits, 8);
+    if(_secs_list.size() < bin_secs_max) {
+      _secs[bits] = _secs_list.size();
+      _secs_list.push_back(bits);
+    }
+  }
+}
+
+void BinaryEventWriter::_put_epoch(uint64_t epoch) {
+  _put_s64(int64_t(epoch - _prev_epoch));
+  _prev_epoch = epoch;
+  _epoch_n = std::max(_epoch_n, epoch + 1);
+}
+
+void BinaryEventWriter::_put_rank(int rank) {
+  _put_u64(uint64_t(rank));
+  _rank_n = std::max(_rank_n, rank + 1);
+}
+
+void BinaryEventWriter::comm(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    int from, int to,
+    size_t bytes,
+    uint64_t epoch
+  ) {
+  _buf.push_back(char(tag_comm));
+  _put_id_deps(id, deps, dep_n);
+  _put_rank(from);
+  _put_rank(to);
+  _put_u64(bytes);
+  _put_epoch(epoch);
+
+  if(_buf.size() >= bin_flush_bytes)
+    _flush();
+}
+
+void BinaryEventWriter::comp(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    int at,
+    double seconds,
+    uint64_t epoch,
+    const TaskNote *note
+  ) {
+  uint64_t op_num = 0;
+  if(note) {
+    auto got = _ops.find(note->op);
+    if(got == _ops.end()) {
+      op_num = _op_list.size();
+      _ops[note->op] = op_num;
+      _op_list.push_back(note->op);
+
+      const string &name = TaskNote::name(note->op);
+      _buf.push_back(char(tag_op));
+      _put_u64(name.size());
+      _buf.append(name);
+    }
+    else
+      op_num = got->second;
+  }
+
+  _buf.push_back(char(note ? tag_comp_noted : tag_comp));
+  _put_id_deps(id, deps, dep_n);
+  _put_rank(at);
+  _put_seconds(seconds);
+  _put_epoch(epoch);
+
+  if(note) {
+    _put_u64(op_num);
+    _put_s64(note->lev);
+    _put_s64(note->box);
+  }
+
+  if(_buf.size() >= bin_flush_bytes)
+    _flush();
+}
+
+void BinaryEventWriter::coll(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    const int *team, size_t team_n,
+    size_t bytes,
+    uint64_t epoch
+  ) {
+  _buf.push_back(char(tag_coll));
+  _put_id_deps(id, deps, dep_n);
+
+  bool fresh;
+  uint64_t team_id = _teams.ref(team, team_n, fresh);
+  if(fresh) {
+    _put_u64(0);
+    _put_u64(team_n);
+    for(size_t i=0; i < team_n; i++)
+      _put_rank(team[i]);
+  }
+  else
+    _put_u64(team_id + 1);
+
+  _put_u64(bytes);
+  _put_epoch(epoch);
+
+  if(_buf.size() >= bin_flush_bytes)
+    _flush();
+}
+
+void BinaryEventWriter::finish() {
+  _buf.push_back(char(tag_end));
+  _flush();
+
+  // fill in the header's counts
+  uint64_t end = _flushed;
+  _header();
+  _file->seekp(0);
+  _file->write(_buf.data(), _buf.size());
+  _buf.clear();
+  _file->seekp(end);
+  _file->flush();
+}
+
+uint64_t BinaryEventWriter::offset() {
+  _flush();
+  _file->flush();
+  return _flushed;
+}
+
+void BinaryEventWriter::checkpoint_save(std::ostream &o) {
+  o << "bin " << _rank_n << ' ' << _epoch_n << ' ' << _event_n << ' '
+    << _prev_n[0] << ' ' << _prev_n[1] << ' ' << _prev_n[2] << ' ' << _prev_epoch << '\n';
+  
+  o << _secs_list.size();
+  for(uint64_t bits: _secs_list)
+    o << ' ' << bits;
+  o << '\n';
+  
+  o << _op_list.size() << '\n';
+  for(uint32_t op: _op_list)
+    o << TaskNote::name(op) << '\n';
+
+  _teams.checkpoint_save(o);
+}
+
+void BinaryEventWriter::checkpoint_load(std::istream &i, uint64_t offset) {
+  string word;
+  size_t secs_n, op_n;
+  i >> word >> _rank_n >> _epoch_n >> _event_n >> _prev_n[0] >> _prev_n[1] >> _prev_n[2] >> _prev_epoch;
+  USER_ASSERT(i && word == "bin", "Bad checkpoint file: not for a binary trace.");
+
+  i >> secs_n;
+  _secs.clear();
+  _secs_list.clear();
+  for(size_t n=0; n < secs_n; n++) {
+    uint64_t bits;
+    i >> bits;
+    _secs[bits] = n;
+    _secs_list.push_back(bits);
+  }
+
+  i >> op_n >> std::ws;
+  USER_ASSERT(i, "Bad checkpoint file: binary trace state.");
+  _ops.clear();
+  _op_list.clear();
+  for(size_t n=0; n < op_n; n++) {
+    string name;
+    std::getline(i, name);
+    uint32_t op = TaskNote::intern(name);
+    _ops[op] = n;
+    _op_list.push_back(op);
+  }
+  _teams.checkpoint_load(i);
+
+  _buf.clear();
+  rewind_to(_file, offset);
+  _flushed = offset;
+}
+
+////////////////////////////////////////////////////////////////////////
+// read_binary_events
+
+namespace {
+  struct BinReader {
+    istream &in;
+    vector<char> buf;
+    size_t pos = 0, end = 0;
+
+    BinReader(istream &in): in(in), buf(1<<16) {}
+
+    bool byte(uint8_t &b) {
+      if(pos == end) {
+        in.read(buf.data(), buf.size());
+        end = (size_t)in.gcount();
+        pos = 0;
+        if(end == 0)
+          return false;
+      }
+      b = uint8_t(buf[pos++]);
+      return true;
+    }
+
+    bool u64(uint64_t &x) {
+      x = 0;
+      for(int shift=0; shift < 64; shift += 7) {
+        uint8_t b;
+        if(!byte(b))
+          return false;
+        x |= uint64_t(b & 0x7f) << shift;
+        if(!(b & 0x80))
+          return true;
+      }
+      return false;
+    }
+
+    bool s64(int64_t &x) {
+      uint64_t u;
+      if(!u64(u))
+        return false;
+      x = int64_t(u >> 1) ^ -int64_t(u & 1);
+      return true;
+    }
+
+    bool le(uint64_t &x, int byte_n) {
+      x = 0;
+      for(int b=0; b < byte_n; b++) {
+        uint8_t c;
+        if(!byte(c))
+          return false;
+        x |= uint64_t(c) << 8*b;
+      }
+      return true;
+    }
+  };
+}
+
+bool programr::read_binary_events(std::istream &in, EventWriter &to, std::string &err) {
+  BinReader r(in);
+
+  for(int i=0; i < 8; i++) {
+    uint8_t b;
+    if(!r.byte(b) || char(b) != bin_magic[i]) {
+      err = "not a binary event trace";
+      return false;
+    }
+  }
+
+  uint64_t ver, pad, rank_n, epoch_n, event_n;
+  if(!r.le(ver, 4) || !r.le(pad, 4) || !r.le(rank_n, 8) || !r.le(epoch_n, 8) || !r.le(event_n, 8)) {
+    err = "truncated header";
+    return false;
+  }
+  if(ver != BinaryEventWriter::version) {
+    err = "unsupported version " + to_string(ver);
+    return false;
+  }
+
+  uint64_t prev_n[3] = {0, 0, 0}, prev_epoch = 0;
+  vector<uint64_t> deps;
+  vector<int> team;
+  vector<vector<int>> teams; // by reference number
+  vector<uint32_t> ops;
+  vector<double> secs;
+
+  auto get_id = [&](uint64_t &id)->bool {
+    uint64_t x;
+    if(!r.u64(x))
+      return false;
+    uint64_t lane = x % 3, z = x / 3;
+    int64_t d = int64_t(z >> 1) ^ -int64_t(z & 1);
+    id = 3*(prev_n[lane] + uint64_t(d)) + lane;
+    return true;
+  };
+  auto get_id_deps = [&](uint64_t &id)->bool {
+    uint64_t n;
+    if(!get_id(id) || !r.u64(n))
+      return false;
+
+    // counts aren't trusted for sizing, every dep takes at least a byte
+    // so a bad count runs out of input before it runs out of memory
+    deps.clear();
+    for(uint64_t i=0; i < n; i++) {
+      uint64_t dep;
+      if(!get_id(dep))
+        return false;
+      deps.push_back(dep);
+    }
+    prev_n[id % 3] = id/3;
+    return true;
+  };
+  auto get_seconds = [&](double &seconds)->bool {
+    uint64_t x, bits;
+    if(!r.u64(x))
+      return false;
+    if(x != 0) {
+      if(x > secs.size())
+        return false;
+      seconds = secs[x-1];
+      return true;
+    }
+    if(!r.le(bits, 8))
+      return false;
+    std::memcpy(&seconds, &bits, 8);
+    if(secs.size() < bin_secs_max)
+      secs.push_back(seconds);
+    return true;
+  };
+  auto get_epoch = [&](uint64_t &epoch)->bool {
+    int64_t d;
+    if(!r.s64(d))
+      return false;
+    epoch = prev_epoch + uint64_t(d);
+    prev_epoch = epoch;
+    return true;
+  };
+  auto get_rank = [&](int &rank)->bool {
+    uint64_t x;
+    if(!r.u64(x) || x > uint64_t(std::numeric_limits<int>::max()))
+      return false;
+    rank = int(x);
+    return true;
+  };
+
+  while(true) {
+    uint8_t tag;
+    if(!r.byte(tag)) {
+      err = "missing end record";
+      return false;
+    }
+
+    bool ok = true;
+    uint64_t id, epoch, bytes;
+
+    switch(tag) {
+    case BinaryEventWriter::tag_comm: {
+      int from, to_;
+      ok = get_id_deps(id) && get_rank(from) && get_rank(to_) && r.u64(bytes) && get_epoch(epoch);
+      if(ok)
+        to.comm(id, deps.data(), deps.size(), from, to_, bytes, epoch);
+    } break;
+
+    case BinaryEventWriter::tag_comp:
+    case BinaryEventWriter::tag_comp_noted: {
+      int at;
+      double seconds;
+      ok = get_id_deps(id) && get_rank(at) && get_seconds(seconds) && get_epoch(epoch);
+
+      TaskNote note;
+      bool noted = tag == BinaryEventWriter::tag_comp_noted;
+      if(ok && noted) {
+        uint64_t op;
+        int64_t lev, box;
+        ok = r.u64(op) && r.s64(lev) && r.s64(box) && op < ops.size();
+        note = TaskNote{ok ? ops[op] : 0, int32_t(lev), int32_t(box)};
+      }
+      if(ok)
+        to.comp(id, deps.data(), deps.size(), at, seconds, epoch, noted ? &note : nullptr);
+    } break;
+
+    case BinaryEventWriter::tag_coll: {
+      uint64_t team_ref, team_n;
+      ok = get_id_deps(id) && r.u64(team_ref);
+      if(ok && team_ref == 0) {
+        ok = r.u64(team_n);
+        if(ok) {
+          team.clear();
+          for(uint64_t i=0; ok && i < team_n; i++) {
+            int rank;
+            ok = get_rank(rank);
+            if(ok)
+              team.push_back(rank);
+          }
+          if(ok)
+            teams.push_back(team);
+        }
+      }
+      else if(ok)
+        ok = team_ref <= teams.size();
+      ok = ok && r.u64(bytes) && get_epoch(epoch);
+      if(ok) {
+        const vector<int> &t = team_ref == 0 ? team : teams[team_ref-1];
+        to.coll(id, deps.data(), deps.size(), t.data(), t.size(), bytes, epoch);
+      }
+    } break;
+
+    case BinaryEventWriter::tag_op: {
+      uint64_t n;
+      ok = r.u64(n);
+      string name;
+      for(uint64_t i=0; ok && i < n; i++) {
+        uint8_t c;
+        ok = r.byte(c);
+        if(ok)
+          name.push_back(char(c));
+      }
+      if(ok)
+        ops.push_back(TaskNote::intern(name));
+    } break;
+
+    case BinaryEventWriter::tag_end:
+      to.finish();
+      return true;
+
+    default:
+      err = "unknown record tag " + to_string(int(tag));
+      return false;
+    }
+
+    if(!ok) {
+      err = "truncated record";
+      return false;
+    }
+  }
+}
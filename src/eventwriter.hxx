@@ -0,0 +1,263 @@
+#ifndef _577c2ca6_2836_47e3_9e15_c57e847c9c2d
+#define _577c2ca6_2836_47e3_9e15_c57e847c9c2d
+
+# include "tasknote.hxx"
+
+# include <cstdint>
+# include <iostream>
+# include <string>
+# include <unordered_map>
+# include <vector>
+
+/* An EventWriter lays out the comm, comp and coll events TracerXml
+ * generates. XmlEventWriter produces the events.xml schema, and
+ * BinaryEventWriter a compact encoding that read_binary_events() turns
+ * back into the same calls, so converting a binary trace through an
+ * XmlEventWriter reproduces the XML trace byte for byte.
+ *
+ * Event ids are passed as the numbers behind the "e<id>" names.
+ */
+namespace programr {
+  struct EventWriter {
+    virtual ~EventWriter() {}
+
+    virtual void comm(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      int from, int to,
+      std::size_t bytes,
+      std::uint64_t epoch
+    ) = 0;
+
+    // `note` is null when notes aren't recorded
+    virtual void comp(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      int at,
+      double seconds,
+      std::uint64_t epoch,
+      const TaskNote *note
+    ) = 0;
+
+    // an ALLREDUCE among `team`
+    virtual void coll(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      const int *team, std::size_t team_n,
+      std::size_t bytes,
+      std::uint64_t epoch
+    ) = 0;
+
+    // the compute epoch advanced to `comp_epoch`
+    virtual void epoch_begin(std::uint64_t comp_epoch) {}
+
+    // no event from here on depends on event `id`
+    virtual void retire(std::uint64_t id) {}
+
+    // called once after the last event
+    virtual void finish() = 0;
+
+    // checkpointing, see TracerXml::checkpoint_save. offset() is how many
+    // bytes have been written, and load() rewinds the output to it.
+    virtual std::uint64_t offset() = 0;
+    virtual void checkpoint_save(std::ostream &o) {}
+    virtual void checkpoint_load(std::istream &i, std::uint64_t offset) = 0;
+  };
+
+  // Numbers the distinct team lists a writer has seen, so repeats can be
+  // written as a reference. Lists are compared in order, which keeps
+  // traces written with references exactly convertible to ones without.
+  class TeamRefs {
+    std::unordered_map<std::string, std::uint64_t> _ids; // list bytes -> id
+    std::vector<std::vector<int>> _lists; // by id
+    std::string _key;
+
+  public:
+    // the id of the list, `fresh` says whether this is its first sighting
+    std::uint64_t ref(const int *team, std::size_t n, bool &fresh);
+    void checkpoint_save(std::ostream &o) const;
+    void checkpoint_load(std::istream &i);
+  };
+
+  // Append the events.xml line of one event to `buf`. `team_ref` >= 0
+  // names the team as t<team_ref> instead of listing it.
+  void put_xml_comm(
+    std::string &buf,
+    std::uint64_t id,
+    const std::uint64_t *deps, std::size_t dep_n,
+    int from, int to,
+    std::size_t bytes,
+    std::uint64_t epoch
+  );
+  void put_xml_comp(
+    std::string &buf,
+    std::uint64_t id,
+    const std::uint64_t *deps, std::size_t dep_n,
+    int at,
+    double seconds,
+    std::uint64_t epoch,
+    const TaskNote *note
+  );
+  void put_xml_coll(
+    std::string &buf,
+    std::uint64_t id,
+    const std::uint64_t *deps, std::size_t dep_n,
+    const int *team, std::size_t team_n,
+    std::size_t bytes,
+    std::uint64_t epoch,
+    std::int64_t team_ref=-1
+  );
+
+  // Formats straight into a buffer that is written out in large chunks,
+  // producing exactly what streaming each field with `<<` would.
+  class XmlEventWriter: public EventWriter {
+    std::ostream *_file;
+    std::string _buf;
+    bool _team_refs;
+    TeamRefs _teams;
+
+  public:
+    // with `team_refs` a team is listed once, as <team id="t<n>" ranks=..>
+    // before the first coll of it, and colls name it as team="t<n>"
+    XmlEventWriter(std::ostream *file, bool team_refs=false);
+
+    void comm(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      int from, int to,
+      std::size_t bytes,
+      std::uint64_t epoch
+    );
+    void comp(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      int at,
+      double seconds,
+      std::uint64_t epoch,
+      const TaskNote *note
+    );
+    void coll(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      const int *team, std::size_t team_n,
+      std::size_t bytes,
+      std::uint64_t epoch
+    );
+    void finish();
+
+    // writes `s` as is between events, for formats layered on this one
+    void text(const std::string &s);
+
+    std::uint64_t offset();
+    void checkpoint_save(std::ostream &o);
+    void checkpoint_load(std::istream &i, std::uint64_t offset);
+
+  private:
+    void _flush();
+  };
+
+  /* The binary format is little endian throughout:
+   *   header: "PRGMRBIN", u32 version, u32 zero, then u64 rank count,
+   *     u64 epoch count and u64 event count, which are filled in by
+   *     finish().
+   *   records, each starting with a tag byte:
+   *     comm: id, deps, from, to, bytes, epoch
+   *     comp: id, deps, at, seconds, epoch
+   *     coll: id, deps, team, bytes, epoch
+   *     comp_noted: as comp, then the note's op, lev, box
+   *     op: a note op name, given the next free op number
+   *     end: last record
+   * Numbers are LEB128 varints. Ids are split into three lanes by
+   * id%3 (tasks, comms and reductions in TracerXml's numbering), and an
+   * id or dep is written as 3*zigzag(n - last n of the lane) + lane, with
+   * n = id/3 and the lane's last n taken from its previous record. Epochs
+   * are zigzag deltas from the previous record's epoch. Deps and teams
+   * are prefixed by their count. Seconds are 0 followed by the f64 for a
+   * new value, or i+1 to repeat the i'th new value. Teams likewise are 0
+   * followed by the rank count and ranks of a new list, or i+1 to repeat
+   * the i'th new list.
+   */
+  class BinaryEventWriter: public EventWriter {
+    std::ostream *_file;
+    std::string _buf;
+    std::uint64_t _flushed = 0; // bytes of _file preceding _buf
+
+    int _rank_n;
+    std::uint64_t _epoch_n = 0;
+    std::uint64_t _event_n = 0;
+    std::uint64_t _prev_n[3] = {0, 0, 0};
+    std::uint64_t _prev_epoch = 0;
+    // f64 bits -> index of seconds values seen so far
+    std::unordered_map<std::uint64_t, std::uint64_t> _secs;
+    std::vector<std::uint64_t> _secs_list; // inverse of _secs
+    // TaskNote op -> its number in this file
+    std::unordered_map<std::uint32_t, std::uint64_t> _ops;
+    std::vector<std::uint32_t> _op_list; // inverse of _ops
+    TeamRefs _teams;
+
+  public:
+    enum: std::uint8_t {
+      tag_comm = 1,
+      tag_comp = 2,
+      tag_comp_noted = 3,
+      tag_coll = 4,
+      tag_op = 5,
+      tag_end = 0xff
+    };
+    static constexpr std::uint32_t version = 2;
+
+    BinaryEventWriter(std::ostream *file, int rank_n=0);
+    ~BinaryEventWriter();
+
+    void comm(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      int from, int to,
+      std::size_t bytes,
+      std::uint64_t epoch
+    );
+    void comp(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      int at,
+      double seconds,
+      std::uint64_t epoch,
+      const TaskNote *note
+    );
+    void coll(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      const int *team, std::size_t team_n,
+      std::size_t bytes,
+      std::uint64_t epoch
+    );
+    void finish();
+
+    std::uint64_t offset();
+    void checkpoint_save(std::ostream &o);
+    void checkpoint_load(std::istream &i, std::uint64_t offset);
+
+  private:
+    void _flush();
+    void _header();
+    void _put_u64(std::uint64_t x);
+    void _put_s64(std::int64_t x) {
+      _put_u64((std::uint64_t(x) << 1) ^ std::uint64_t(x >> 63));
+    }
+    void _put_id(std::uint64_t id);
+    void _put_id_deps(std::uint64_t id, const std::uint64_t *deps, std::size_t dep_n);
+    void _put_seconds(double seconds);
+    void _put_epoch(std::uint64_t epoch);
+    void _put_rank(int rank);
+  };
+
+  // Seeks `file` to `offset` for checkpoint_load(), after checking the
+  // output has that many bytes.
+  void rewind_to(std::ostream *file, std::uint64_t offset);
+
+  // Reads a BinaryEventWriter file, replaying its events into `to`
+  // (including finish()). Returns false with a message in `err` if the
+  // file is malformed.
+  bool read_binary_events(std::istream &in, EventWriter &to, std::string &err);
+}
+#endif
@@ -3,7 +3,16 @@
 using namespace programr;
 using namespace std;
 
+std::uint64_t Expr::live_n = 0;
+
 Expr::~Expr() {
+  live_n -= 1;
+  
+  if(rdxn_holds) {
+    for(uint64_t rdxn_id: dep_rdxn_ids)
+      rdxn_holds->drop(rdxn_id);
+  }
+  
   Succs *p = succs;
   while(p) {
     Succs *p_next = p->tail;
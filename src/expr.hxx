@@ -4,10 +4,12 @@
 # include "data.hxx"
 # include "diagnostic.hxx"
 # include "list.hxx"
+# include "tasknote.hxx"
 # include "lowlevel/digest.hxx"
 # include "lowlevel/ref.hxx"
 # include "lowlevel/linkedlist.hxx"
 # include "lowlevel/pool.hxx"
+# include "lowlevel/workers.hxx"
 
 # include <cstdint>
 # include <functional>
@@ -39,20 +41,66 @@ namespace programr {
     std::size_t size;
   };
   
+  // A run of tasks emitted together by ExecCxt::tasks(), all producing
+  // data `data_id`, laid out as flat arrays. Task i runs on ranks[i] and
+  // its dependencies are deps[dep_off[i]] up to deps[dep_off[i+1]].
+  struct TaskBatch {
+    std::uint64_t data_id = 0;
+    std::vector<int> ranks;
+    std::vector<double> seconds;
+    std::vector<TaskNote> notes;
+    std::vector<std::size_t> dep_off{0};
+    std::vector<Dependency> deps;
+    
+    std::size_t size() const { return ranks.size(); }
+    
+    // empty the batch but keep its capacity
+    void clear() {
+      ranks.clear();
+      seconds.clear();
+      notes.clear();
+      dep_off.resize(1);
+      deps.clear();
+    }
+    
+    // append a task whose dependencies were just pushed onto `deps`
+    void add(int rank, TaskNote note, double secs) {
+      ranks.push_back(rank);
+      notes.push_back(note);
+      seconds.push_back(secs);
+      dep_off.push_back(deps.size());
+    }
+  };
+  
   struct Result: Referent {
     // get all datas exposed in this result
     virtual void datas(std::vector<Data*> &add_to) const = 0;
   };
 
+  // How many exprs hold each reduction id in their dep_rdxn_ids. Kept by
+  // the runtime in streaming mode so the tracer learns when an id can no
+  // longer reach any future task.
+  struct RdxnHolds: Referent {
+    virtual void hold(std::uint64_t rdxn_id) = 0;
+    virtual void drop(std::uint64_t rdxn_id) = 0;
+  };
+  
   struct Expr: Referent {
     SourceLocation sloc;
     
-    Expr(SourceLocation sloc={}): sloc(sloc) {}
+    static std::uint64_t live_n; // exprs constructed but not yet destructed
+    
+    Expr(SourceLocation sloc={}): sloc(sloc) { live_n += 1; }
     ~Expr();
     
     struct ExecCxt {
-      virtual std::uint64_t task(int rank, std::uint64_t data_id, const std::vector<Dependency> &deps, std::string note, double seconds) = 0;
+      virtual std::uint64_t task(int rank, std::uint64_t data_id, const std::vector<Dependency> &deps, TaskNote note, double seconds) = 0;
+      // emit every task in the batch, returns the id of the first. the
+      // rest follow consecutively.
+      virtual std::uint64_t tasks(const TaskBatch &batch) = 0;
       virtual void reduction(std::size_t bytes, const std::vector<std::uint64_t> &dep_tasks) = 0;
+      // thread pool available for data parallel work inside execute()
+      virtual Workers& workers() = 0;
     };
     
     // set by execute() iff this expr does not get continued
@@ -81,6 +129,8 @@ namespace programr {
     int pred_n; // predecessor (aka sub-expression) count
     Links<Expr> links;
     std::vector<std::uint64_t> dep_rdxn_ids;
+    // counts the ids in dep_rdxn_ids, if set
+    Ref<RdxnHolds> rdxn_holds;
     
     struct Succs {
       RefWeak<Expr> head;
@@ -19,7 +19,7 @@
 #endif
 
 #ifndef KNOB_XML_VERIFY
-# define KNOB_XML_VERIFY 0
+# define KNOB_XML_VERIFY 1
 #endif
 
 #ifndef KNOB_METIS
@@ -29,3 +29,11 @@
 #ifndef KNOB_AMRWEIGHT
 # define KNOB_AMRWEIGHT 1
 #endif
+
+#ifndef KNOB_ALLOC_COUNT
+# define KNOB_ALLOC_COUNT 0
+#endif
+
+#ifndef KNOB_REGION
+# define KNOB_REGION 0
+#endif
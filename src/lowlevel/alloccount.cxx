@@ -0,0 +1,44 @@
+#include "alloccount.hxx"
+
+#if KNOB_ALLOC_COUNT
+# include <atomic>
+# include <cstdlib>
+# include <new>
+
+namespace {
+  std::atomic<std::uint64_t> the_count{0};
+  
+  void* counted_alloc(std::size_t size) {
+    the_count.fetch_add(1, std::memory_order_relaxed);
+    
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if(!p)
+      throw std::bad_alloc();
+    return p;
+  }
+}
+
+void* operator new(std::size_t size) {
+  return counted_alloc(size);
+}
+void* operator new[](std::size_t size) {
+  return counted_alloc(size);
+}
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+void operator delete[](void *p) noexcept {
+  std::free(p);
+}
+
+std::uint64_t programr::alloc_count() {
+  return the_count.load(std::memory_order_relaxed);
+}
+
+#else
+
+std::uint64_t programr::alloc_count() {
+  return 0;
+}
+
+#endif
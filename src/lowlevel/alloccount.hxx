@@ -0,0 +1,14 @@
+#ifndef _0946eda7_7404_4910_8b09_d8f4707d59ac
+#define _0946eda7_7404_4910_8b09_d8f4707d59ac
+
+# include "knobs.hxx"
+
+# include <cstdint>
+
+namespace programr {
+  // Number of calls to the global operator new so far. Only counted when
+  // built with KNOB_ALLOC_COUNT, which swaps in a counting operator new;
+  // otherwise always zero.
+  std::uint64_t alloc_count();
+}
+#endif
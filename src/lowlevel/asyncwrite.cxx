@@ -0,0 +1,111 @@
+#include "asyncwrite.hxx"
+
+using namespace programr;
+using namespace std;
+
+AsyncWriteBuf::AsyncWriteBuf(streambuf *to, size_t buf_bytes, int buf_n):
+  _to(to),
+  _buf_bytes(buf_bytes < 1 ? 1 : buf_bytes),
+  _buf_n(buf_n < 2 ? 2 : buf_n),
+  _bufs(new unique_ptr<char[]>[_buf_n]),
+  _lens(new size_t[_buf_n]) {
+
+  for(int b=0; b < _buf_n; b++)
+    _bufs[b].reset(new char[_buf_bytes]);
+
+  setp(_bufs[0].get(), _bufs[0].get() + _buf_bytes);
+
+  _thread = thread([=]() { this->_thread_main(); });
+}
+
+AsyncWriteBuf::~AsyncWriteBuf() {
+  _drain();
+  {
+    unique_lock<mutex> lock(_lock);
+    _quit = true;
+  }
+  _wake.notify_all();
+  _thread.join();
+}
+
+void AsyncWriteBuf::_handoff() {
+  unique_lock<mutex> lock(_lock);
+
+  int fill = (_head + _queued_n) % _buf_n;
+  _lens[fill] = pptr() - pbase();
+  _queued_n += 1;
+  _wake.notify_all();
+
+  // the next buffer is free once fewer than all are queued
+  while(_queued_n == _buf_n)
+    _done.wait(lock);
+
+  fill = (fill + 1) % _buf_n;
+  setp(_bufs[fill].get(), _bufs[fill].get() + _buf_bytes);
+}
+
+bool AsyncWriteBuf::_drain() {
+  if(pptr() != pbase())
+    _handoff();
+
+  unique_lock<mutex> lock(_lock);
+  while(_queued_n != 0)
+    _done.wait(lock);
+  return !_failed;
+}
+
+void AsyncWriteBuf::_thread_main() {
+  while(true) {
+    int b;
+    {
+      unique_lock<mutex> lock(_lock);
+      while(!_quit && _queued_n == 0)
+        _wake.wait(lock);
+      if(_queued_n == 0)
+        return;
+      b = _head;
+    }
+
+    bool ok = _to->sputn(_bufs[b].get(), _lens[b]) == streamsize(_lens[b]);
+
+    {
+      unique_lock<mutex> lock(_lock);
+      _failed |= !ok;
+      _head = (_head + 1) % _buf_n;
+      _queued_n -= 1;
+      _done.notify_all();
+    }
+  }
+}
+
+AsyncWriteBuf::int_type AsyncWriteBuf::overflow(int_type c) {
+  _handoff();
+  {
+    unique_lock<mutex> lock(_lock);
+    if(_failed)
+      return traits_type::eof();
+  }
+  if(!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+int AsyncWriteBuf::sync() {
+  if(!_drain())
+    return -1;
+  return _to->pubsync();
+}
+
+AsyncWriteBuf::pos_type AsyncWriteBuf::seekoff(off_type off, ios_base::seekdir dir, ios_base::openmode which) {
+  if(!_drain())
+    return pos_type(off_type(-1));
+  return _to->pubseekoff(off, dir, which);
+}
+
+AsyncWriteBuf::pos_type AsyncWriteBuf::seekpos(pos_type pos, ios_base::openmode which) {
+  if(!_drain())
+    return pos_type(off_type(-1));
+  return _to->pubseekpos(pos, which);
+}
@@ -0,0 +1,62 @@
+#ifndef _34d735ef_a460_4190_b3c2_ce204502ee5d
+#define _34d735ef_a460_4190_b3c2_ce204502ee5d
+
+# include <condition_variable>
+# include <cstdint>
+# include <memory>
+# include <mutex>
+# include <streambuf>
+# include <thread>
+# include <vector>
+
+/* AsyncWriteBuf is a streambuf that hands its output to a background
+ * thread, which writes it on to another streambuf. Output is gathered in
+ * a ring of `buf_n` buffers of `buf_bytes` each: once the buffer being
+ * filled is full it is queued for the thread and filling moves on to the
+ * next free one, so the writer only blocks when every other buffer is
+ * still queued.
+ *
+ * Flushing (sync) waits for everything queued to be written, and seeking
+ * or asking the position drains first and then forwards to the target,
+ * so an ostream over an AsyncWriteBuf behaves like one over the target
+ * apart from when the bytes land. A failed write of the target fails
+ * every later overflow and sync, and so sets badbit on the ostream. The
+ * destructor drains too but has nowhere to report a failure, so flush
+ * the stream before destroying the buffer to learn of one.
+ */
+namespace programr {
+  class AsyncWriteBuf: public std::streambuf {
+    std::streambuf *_to;
+    std::size_t _buf_bytes;
+    int _buf_n;
+    std::unique_ptr<std::unique_ptr<char[]>[]> _bufs;
+    std::unique_ptr<std::size_t[]> _lens;
+
+    std::mutex _lock;
+    std::condition_variable _wake, _done;
+    // buffers _head, _head+1, ... _head+_queued_n-1 (mod _buf_n) are
+    // waiting to be written, the one after them is being filled
+    int _head = 0, _queued_n = 0;
+    bool _failed = false;
+    bool _quit = false;
+    std::thread _thread;
+
+  public:
+    AsyncWriteBuf(std::streambuf *to, std::size_t buf_bytes=1<<20, int buf_n=2);
+    AsyncWriteBuf(const AsyncWriteBuf&) = delete;
+    AsyncWriteBuf& operator=(const AsyncWriteBuf&) = delete;
+    ~AsyncWriteBuf();
+
+  protected:
+    int_type overflow(int_type c);
+    int sync();
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which);
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+
+  private:
+    void _handoff();
+    bool _drain();
+    void _thread_main();
+  };
+}
+#endif
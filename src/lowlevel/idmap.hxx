@@ -0,0 +1,100 @@
+#ifndef _d34f961c_fded_4726_80c3_5b5c36f04fe5
+#define _d34f961c_fded_4726_80c3_5b5c36f04fe5
+
+# include <cstdint>
+# include <memory>
+# include <unordered_map>
+
+/* IdMap<T> maps integer ids to T's, for ids that are handed out densely
+ * like task ids. Values live in fixed size pages, so only the first id
+ * touched on a page allocates, and a page is freed once every id on it
+ * has been erased. Like unordered_map, operator[] on an absent id makes
+ * it present with a value initialized T.
+ */
+namespace programr {
+  template<class T, int page_log2=10>
+  class IdMap {
+    static constexpr int page_n = 1<<page_log2;
+
+    struct Page {
+      T vals[page_n];
+      std::uint64_t has[(page_n+63)/64];
+      int live_n;
+    };
+
+    std::unordered_map<std::uint64_t, std::unique_ptr<Page>> _pages;
+    // most recently used page
+    std::uint64_t _last_key = ~std::uint64_t(0);
+    Page *_last = nullptr;
+    std::size_t _size = 0;
+
+  public:
+    T& operator[](std::uint64_t id) {
+      Page *p = _page(id >> page_log2);
+      int i = id & (page_n-1);
+
+      std::uint64_t bit = std::uint64_t(1) << (i & 63);
+      if(!(p->has[i>>6] & bit)) {
+        p->has[i>>6] |= bit;
+        p->live_n += 1;
+        _size += 1;
+      }
+      return p->vals[i];
+    }
+    
+    // the value of `id`, null if absent
+    const T* find(std::uint64_t id) const {
+      std::uint64_t key = id >> page_log2;
+      const Page *p = _last;
+      if(key != _last_key) {
+        auto got = _pages.find(key);
+        if(got == _pages.end())
+          return nullptr;
+        p = got->second.get();
+      }
+      int i = id & (page_n-1);
+      return p->has[i>>6] >> (i & 63) & 1 ? &p->vals[i] : nullptr;
+    }
+
+    // number of ids present
+    std::size_t size() const { return _size; }
+
+    void erase(std::uint64_t id) {
+      std::uint64_t key = id >> page_log2;
+      auto got = _pages.find(key);
+      if(got == _pages.end())
+        return;
+
+      Page *p = got->second.get();
+      int i = id & (page_n-1);
+
+      std::uint64_t bit = std::uint64_t(1) << (i & 63);
+      if(p->has[i>>6] & bit) {
+        p->has[i>>6] &= ~bit;
+        p->vals[i] = T();
+        _size -= 1;
+
+        if(0 == --p->live_n) {
+          if(_last == p) {
+            _last_key = ~std::uint64_t(0);
+            _last = nullptr;
+          }
+          _pages.erase(got);
+        }
+      }
+    }
+
+  private:
+    Page* _page(std::uint64_t key) {
+      if(key != _last_key) {
+        std::unique_ptr<Page> &p = _pages[key];
+        if(!p)
+          p.reset(new Page()); // value initialized
+        _last_key = key;
+        _last = p.get();
+      }
+      return _last;
+    }
+  };
+}
+#endif
@@ -0,0 +1,135 @@
+#include "lz.hxx"
+
+#include <cstring>
+#include <memory>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  const int hash_log2 = 16;
+  const size_t min_match = 4;
+  const size_t max_offset = 65535;
+  // a match may not start in the last bytes, they're always literals
+  const size_t tail_literals = 5;
+
+  inline uint32_t read32(const char *p) {
+    uint32_t x;
+    memcpy(&x, p, 4);
+    return x;
+  }
+
+  inline uint32_t hash4(uint32_t x) {
+    return (x * 2654435761u) >> (32 - hash_log2);
+  }
+
+  void put_count(string &out, size_t n) {
+    while(n >= 255) {
+      out.push_back(char(255));
+      n -= 255;
+    }
+    out.push_back(char(n));
+  }
+
+  void put_sequence(string &out, const char *lit, size_t lit_n, size_t off, size_t match_n) {
+    size_t m = match_n == 0 ? 0 : match_n - min_match;
+    out.push_back(char(((lit_n < 15 ? lit_n : 15) << 4) | (m < 15 ? m : 15)));
+    if(lit_n >= 15)
+      put_count(out, lit_n - 15);
+    out.append(lit, lit_n);
+
+    if(match_n != 0) {
+      out.push_back(char(off & 0xff));
+      out.push_back(char(off >> 8));
+      if(m >= 15)
+        put_count(out, m - 15);
+    }
+  }
+}
+
+void programr::lz_compress(const char *in, size_t n, string &out) {
+  unique_ptr<uint32_t[]> table(new uint32_t[size_t(1) << hash_log2]());
+
+  size_t lit = 0; // start of pending literals
+  size_t i = 0;
+
+  if(n > tail_literals + min_match) {
+    size_t last = n - tail_literals - min_match;
+
+    while(i <= last) {
+      uint32_t x = read32(in + i);
+      uint32_t h = hash4(x);
+      size_t cand = table[h];
+      table[h] = uint32_t(i);
+
+      if(cand < i && i - cand <= max_offset && read32(in + cand) == x) {
+        size_t len = min_match;
+        size_t end = n - tail_literals;
+        while(i + len < end && in[cand + len] == in[i + len])
+          len += 1;
+
+        put_sequence(out, in + lit, i - lit, i - cand, len);
+
+        i += len;
+        lit = i;
+      }
+      else
+        i += 1;
+    }
+  }
+
+  put_sequence(out, in + lit, n - lit, 0, 0);
+}
+
+bool programr::lz_decompress(const char *in, size_t n, char *out, size_t out_n) {
+  const unsigned char *p = reinterpret_cast<const unsigned char*>(in);
+  const unsigned char *p_end = p + n;
+  size_t o = 0;
+
+  auto get_count = [&](size_t &len)->bool {
+    while(true) {
+      if(p == p_end)
+        return false;
+      unsigned char b = *p++;
+      len += b;
+      if(b != 255)
+        return true;
+    }
+  };
+
+  while(true) {
+    if(p == p_end)
+      return false;
+    unsigned char token = *p++;
+
+    size_t lit_n = token >> 4;
+    if(lit_n == 15 && !get_count(lit_n))
+      return false;
+    if(size_t(p_end - p) < lit_n || out_n - o < lit_n)
+      return false;
+    memcpy(out + o, p, lit_n);
+    p += lit_n;
+    o += lit_n;
+
+    if(p == p_end) // the last sequence
+      return o == out_n;
+
+    if(p_end - p < 2)
+      return false;
+    size_t off = size_t(p[0]) | size_t(p[1]) << 8;
+    p += 2;
+
+    size_t len = token & 15;
+    if(len == 15 && !get_count(len))
+      return false;
+    len += min_match;
+
+    if(off == 0 || off > o || out_n - o < len)
+      return false;
+
+    // byte at a time, the source may overlap what's being written
+    for(size_t k=0; k < len; k++)
+      out[o + k] = out[o - off + k];
+    o += len;
+  }
+}
@@ -0,0 +1,23 @@
+#ifndef _99cad9e1_84b4_4cd6_8092_72173ac0f14a
+#define _99cad9e1_84b4_4cd6_8092_72173ac0f14a
+
+# include <cstdint>
+# include <string>
+
+/* A small LZ77 codec for compressing independent blocks, in the layout
+ * of LZ4's block format: a sequence is a token byte whose high nibble is
+ * the literal count and low nibble the match length less 4 (a nibble of
+ * 15 continues in following bytes, each adding up to 255), the literals,
+ * then a 2 byte little endian match offset. The last sequence has only
+ * literals. Matches are found greedily through a hash of the next 4
+ * bytes, so compression is fast and the ratio modest.
+ */
+namespace programr {
+  // appends the compressed form of `in[0,n)` to `out`
+  void lz_compress(const char *in, std::size_t n, std::string &out);
+
+  // decompresses `in[0,n)` into exactly `out_n` bytes at `out`, returns
+  // false if the input is malformed or decompresses to another size
+  bool lz_decompress(const char *in, std::size_t n, char *out, std::size_t out_n);
+}
+#endif
@@ -0,0 +1,52 @@
+#include "mappedfile.hxx"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace programr;
+using namespace std;
+
+bool MappedFile::open(const string &path, string &err) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0) {
+    err = strerror(errno);
+    return false;
+  }
+
+  struct stat st;
+  if(fstat(fd, &st) != 0) {
+    err = strerror(errno);
+    ::close(fd);
+    return false;
+  }
+
+  if(st.st_size != 0) {
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(p == MAP_FAILED) {
+      err = strerror(errno);
+      ::close(fd);
+      return false;
+    }
+    // read front to back by the scanners
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+    _data = static_cast<const char*>(p);
+    _size = st.st_size;
+  }
+
+  ::close(fd);
+  return true;
+}
+
+void MappedFile::close() {
+  if(_data)
+    munmap(const_cast<char*>(_data), _size);
+  _data = nullptr;
+  _size = 0;
+}
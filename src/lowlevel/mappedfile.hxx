@@ -0,0 +1,27 @@
+#ifndef _9b0dd534_1cca_42fd_9f61_20c7f8308f25
+#define _9b0dd534_1cca_42fd_9f61_20c7f8308f25
+
+# include <cstddef>
+# include <string>
+
+namespace programr {
+  // A whole file mapped read only into memory.
+  class MappedFile {
+    const char *_data = nullptr;
+    std::size_t _size = 0;
+
+  public:
+    MappedFile() {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    // false with a message in `err` if the file can't be mapped
+    bool open(const std::string &path, std::string &err);
+    void close();
+
+    const char* data() const { return _data; }
+    std::size_t size() const { return _size; }
+  };
+}
+#endif
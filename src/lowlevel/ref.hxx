@@ -6,6 +6,10 @@
 
 # include "digest.hxx"
 
+# if KNOB_REGION
+#  include "region.hxx"
+# endif
+
 # include <cstdint>
 # include <iostream>
 
@@ -34,6 +38,28 @@ namespace programr {
     void _decref();
     void _decweak();
     
+# if KNOB_REGION
+    static void* operator new(std::size_t size) { return region_alloc(size); }
+    static void operator delete(void *p) { region_dealloc(p); }
+# endif
+    
+    // raw storage for referents built by placement new, matches operator
+    // delete. _dealloc releases the storage of one already destructed.
+    static void* _alloc(std::size_t size) {
+# if KNOB_REGION
+      return region_alloc(size);
+# else
+      return ::operator new(size);
+# endif
+    }
+    static void _dealloc(void *p) {
+# if KNOB_REGION
+      region_dealloc(p);
+# else
+      ::operator delete(p);
+# endif
+    }
+    
     Referent(const Referent&) = delete;
     Referent& operator=(const Referent&) = delete;
     Referent(Referent&&) = delete;
@@ -57,7 +83,7 @@ namespace programr {
   inline void Referent::_decweak() {
     _weak_n -= 1;
     if(0 == _weak_n && ~0u == _ref_n)
-      ::operator delete(this);
+      _dealloc(this);
   }
   
   // Base class of all reference like classes
@@ -165,7 +191,7 @@ namespace programr {
       if(0x1 < reinterpret_cast<std::uintptr_t>(_obj) && ~0u == _obj->_ref_n) {
         if(0 == --_obj->_weak_n) {
           //Say() << "Weak delete";
-          ::operator delete(_obj);
+          Referent::_dealloc(_obj);
         }
         _obj = reinterpret_cast<T*>(std::uintptr_t(0x1));
       }
@@ -476,7 +502,7 @@ namespace programr {
     std::size_t off = sizeof(Boxed<T[],immutable>);
     off = (off + alignof(T)-1) & -alignof(T);
     
-    return ::new(operator new(off + n*sizeof(T)))
+    return ::new(Referent::_alloc(off + n*sizeof(T)))
       Boxed<T[],immutable>(n, off, elmt_ctor);
   }
   
@@ -0,0 +1,64 @@
+#include "region.hxx"
+
+#include <cstdlib>
+#include <new>
+
+using namespace programr;
+using namespace std;
+
+thread_local Region* Region::current = nullptr;
+atomic<uint64_t> Region::live_n{0};
+
+namespace {
+  // precedes every object handed out by region_alloc
+  struct alignas(16) Header {
+    Region *region; // null if from malloc
+  };
+  
+  const size_t page_sz = 1<<20;
+}
+
+Region* Region::open() {
+  return new Region;
+}
+
+void Region::close() {
+  _drop();
+}
+
+void* Region::_alloc(size_t size) {
+  _hold_n.fetch_add(1, memory_order_relaxed);
+  return _pile.push(size, alignof(Header), page_sz);
+}
+
+void Region::_drop() {
+  if(1 == _hold_n.fetch_sub(1, memory_order_acq_rel))
+    delete this;
+}
+
+void* programr::region_alloc(size_t size) {
+  Region *r = Region::current;
+  Header *h;
+  
+  if(r)
+    h = static_cast<Header*>(r->_alloc(sizeof(Header) + size));
+  else {
+    h = static_cast<Header*>(std::malloc(sizeof(Header) + size));
+    if(!h)
+      throw bad_alloc();
+  }
+  
+  h->region = r;
+  return h + 1;
+}
+
+void programr::region_dealloc(void *p) {
+  if(!p)
+    return;
+  
+  Header *h = static_cast<Header*>(p) - 1;
+  if(h->region)
+    h->region->_drop();
+  else
+    std::free(h);
+}
@@ -0,0 +1,54 @@
+#ifndef _666293a7_5eec_42ed_b362_bf8a1e8c68c8
+#define _666293a7_5eec_42ed_b362_bf8a1e8c68c8
+
+# include "pile.hxx"
+
+# include <atomic>
+# include <cstdint>
+
+/* A Region is a bump allocator for objects that are born together and
+ * mostly die together, like the exprs and results made while tracing one
+ * stretch of a program. Allocation just pushes onto a Pile. Freeing an
+ * object only counts it dead, and once the region has been closed and
+ * its last object has died, all of its pages are released at once.
+ *
+ * region_alloc() draws from the calling thread's current region (see
+ * Region::Scope), or from malloc if there is none. region_dealloc() is
+ * the matching free and may be called from any thread. With KNOB_REGION
+ * these back operator new/delete for every Referent.
+ */
+namespace programr {
+  class Region {
+    Pile _pile;
+    // live objects, plus one while the region is open
+    std::atomic<std::size_t> _hold_n;
+    
+    Region(): _hold_n(1) { live_n += 1; }
+    ~Region() { live_n -= 1; }
+    
+  public:
+    static thread_local Region *current;
+    static std::atomic<std::uint64_t> live_n; // regions opened but not yet freed
+    
+    static Region* open();
+    // no more allocations will be made, free once everything is dead
+    void close();
+    
+    void* _alloc(std::size_t size);
+    void _drop();
+    
+    // makes `r` the current region of this thread for the scope's life
+    class Scope {
+      Region *_prev;
+    public:
+      Scope(Region *r): _prev(current) { current = r; }
+      ~Scope() { current = _prev; }
+      Scope(const Scope&) = delete;
+      Scope& operator=(const Scope&) = delete;
+    };
+  };
+  
+  void* region_alloc(std::size_t size);
+  void region_dealloc(void *p);
+}
+#endif
@@ -0,0 +1,124 @@
+#include "workers.hxx"
+
+#include <algorithm>
+
+using namespace programr;
+using namespace std;
+
+Workers::Workers(int thread_n):
+  _thread_n(thread_n < 1 ? 1 : thread_n),
+  _ranges(new Range[_thread_n]) {
+
+  for(int w=0; w < _thread_n; w++)
+    _ranges[w].lo = _ranges[w].hi = 0;
+}
+
+Workers::~Workers() {
+  {
+    unique_lock<mutex> lock(_lock);
+    _quit = true;
+  }
+  _wake.notify_all();
+
+  for(thread &t: _threads)
+    t.join();
+}
+
+void Workers::_run(size_t n, size_t grain, JobFn fn, const void *f) {
+  // threads start with the first loop big enough to need them
+  if(_threads.empty()) {
+    for(int w=1; w < _thread_n; w++)
+      _threads.emplace_back([=]() { this->_thread_main(w); });
+  }
+
+  // deal out contiguous ranges, one per worker
+  for(int w=0; w < _thread_n; w++) {
+    _ranges[w].lo = n*w/_thread_n;
+    _ranges[w].hi = n*(w+1)/_thread_n;
+  }
+
+  {
+    unique_lock<mutex> lock(_lock);
+    _job_fn = fn;
+    _job_f = f;
+    _job_grain = grain;
+    _busy_n = _thread_n-1;
+    _generation += 1;
+  }
+  _wake.notify_all();
+
+  _work(0);
+
+  unique_lock<mutex> lock(_lock);
+  while(_busy_n != 0)
+    _done.wait(lock);
+}
+
+bool Workers::_take(int me, size_t &lo, size_t &hi) {
+  { // front of my own range
+    Range &r = _ranges[me];
+    unique_lock<mutex> lock(r.lock);
+    if(r.lo < r.hi) {
+      lo = r.lo;
+      hi = std::min(r.hi, r.lo + _job_grain);
+      r.lo = hi;
+      return true;
+    }
+  }
+
+  // steal the back half of the first victim found with work left
+  for(int k=1; k < _thread_n; k++) {
+    Range &v = _ranges[(me + k) % _thread_n];
+    size_t v_lo, v_hi;
+    {
+      unique_lock<mutex> lock(v.lock);
+      if(v.lo == v.hi)
+        continue;
+      size_t mid = v.hi - (v.hi - v.lo + 1)/2;
+      v_lo = mid;
+      v_hi = v.hi;
+      v.hi = mid;
+    }
+
+    // run the first chunk of the loot now, keep the rest for later
+    lo = v_lo;
+    hi = std::min(v_hi, v_lo + _job_grain);
+
+    Range &r = _ranges[me];
+    unique_lock<mutex> lock(r.lock);
+    r.lo = hi;
+    r.hi = v_hi;
+    return true;
+  }
+
+  return false;
+}
+
+void Workers::_work(int me) {
+  size_t lo, hi;
+  while(_take(me, lo, hi))
+    _job_fn(_job_f, lo, hi, me);
+}
+
+void Workers::_thread_main(int me) {
+  uint64_t seen = 0;
+
+  while(true) {
+    {
+      unique_lock<mutex> lock(_lock);
+      while(!_quit && _generation == seen)
+        _wake.wait(lock);
+      if(_quit)
+        return;
+      seen = _generation;
+    }
+
+    _work(me);
+
+    {
+      unique_lock<mutex> lock(_lock);
+      if(0 == --_busy_n)
+        _done.notify_all();
+    }
+  }
+}
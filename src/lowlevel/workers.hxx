@@ -0,0 +1,92 @@
+#ifndef _ab72dfeb_84e2_4503_983e_9397fa3ac65c
+#define _ab72dfeb_84e2_4503_983e_9397fa3ac65c
+
+# include <condition_variable>
+# include <cstdint>
+# include <memory>
+# include <mutex>
+# include <thread>
+# include <vector>
+
+/* Workers is a fixed size pool of threads for data parallel loops.
+ *
+ * parallel_for(n, grain, f) calls f(i, worker) for every i in [0,n). The
+ * index space is split evenly over the per-worker ranges, each worker
+ * consumes `grain` sized chunks from the front of its own range, and when
+ * that runs dry it steals the back half of some other worker's range. The
+ * calling thread participates as worker 0, so a pool of size 1 runs
+ * everything inline without touching any synchronization. The other
+ * threads are only started by the first loop that goes parallel, so a
+ * pool nobody gives enough work costs nothing.
+ *
+ * Only one parallel_for may be in flight at a time, and `f` must not
+ * itself call parallel_for on the same pool.
+ */
+namespace programr {
+  class Workers {
+    struct Range {
+      std::mutex lock;
+      std::size_t lo, hi;
+    };
+
+    typedef void(*JobFn)(const void *f, std::size_t lo, std::size_t hi, int worker);
+
+    int _thread_n;
+    std::vector<std::thread> _threads;
+    std::unique_ptr<Range[]> _ranges;
+
+    std::mutex _lock;
+    std::condition_variable _wake, _done;
+    std::uint64_t _generation = 0;
+    int _busy_n = 0;
+    bool _quit = false;
+
+    // the job being run
+    JobFn _job_fn;
+    const void *_job_f;
+    std::size_t _job_grain;
+
+  public:
+    Workers(int thread_n=1);
+    Workers(const Workers&) = delete;
+    Workers& operator=(const Workers&) = delete;
+    ~Workers();
+
+    int size() const { return _thread_n; }
+    // threads running besides the caller's, 0 until the first parallel loop
+    int started() const { return (int)_threads.size(); }
+
+    template<class F>
+    void parallel_for(std::size_t n, std::size_t grain, const F &f);
+
+  private:
+    void _run(std::size_t n, std::size_t grain, JobFn fn, const void *f);
+    void _work(int me);
+    bool _take(int me, std::size_t &lo, std::size_t &hi);
+    void _thread_main(int me);
+  };
+
+  //////////////////////////////////////////////////////////////////////
+
+  template<class F>
+  void Workers::parallel_for(std::size_t n, std::size_t grain, const F &f) {
+    if(grain == 0)
+      grain = 1;
+
+    if(_thread_n == 1 || n <= grain) {
+      for(std::size_t i=0; i < n; i++)
+        f(i, 0);
+    }
+    else {
+      _run(n, grain,
+        [](const void *f, std::size_t lo, std::size_t hi, int worker) {
+          for(std::size_t i=lo; i < hi; i++)
+            (*static_cast<const F*>(f))(i, worker);
+        },
+        &f
+      );
+    }
+  }
+}
+
+#endif
@@ -1,17 +1,31 @@
 #include "app.hxx"
 #include "env.hxx"
 #include "tracerxml.hxx"
+#include "tracerbinary.hxx"
+#include "tracersim.hxx"
+#include "tracercritpath.hxx"
+#include "blockwriter.hxx"
+#include "shardwriter.hxx"
+#include "templatewriter.hxx"
 #include "tracergraph.hxx"
+#include "tracerrecord.hxx"
+#include "netmap.hxx"
+#include "lowlevel/asyncwrite.hxx"
 #include "amr/boxtree_boxlib.hxx"
+#include "amr/partition.hxx"
 
 #ifdef KNOB_MOTA
 #include "amr/mota/mota.hxx"
 #endif
 
 #include <fstream>
+#include <sstream>
 #include <tuple>
 #include <string>
 #include <chrono>
+#include <memory>
+
+#include <unistd.h>
 
 using namespace std;
 using namespace programr;
@@ -77,6 +91,33 @@ namespace {
     return infile.good();
   }
 
+  // one more than the largest rank the mesh's boxes are on
+  int mesh_rank_n(IList<LevelAndRanks> tree) {
+    int rank_n = 0;
+    tree->for_val([&](const LevelAndRanks &lr) {
+      lr.rank_map->for_val([&](int rank) { rank_n = std::max(rank_n, rank+1); });
+    });
+    return rank_n;
+  }
+
+  // the same levels with their boxes spread over `rank_n` ranks
+  IList<LevelAndRanks> repartition(IList<LevelAndRanks> tree, int rank_n, const string &method, bool per_level) {
+    vector<boxtree::Level> levels;
+    tree->for_val([&](const LevelAndRanks &lr) { levels.push_back(lr.level); });
+
+    Workers pool(env<int>("threads", 1));
+    auto t0 = std::chrono::high_resolution_clock::now();
+    vector<Ref<BoxMap<int>>> maps = partition(levels, rank_n, partition_method(method), per_level, pool);
+    auto t1 = std::chrono::high_resolution_clock::now();
+    Say() << "Partitioned boxes over " << rank_n << " ranks by " << method << (per_level ? " per level" : "")
+          << " in " << std::chrono::duration_cast<std::chrono::milliseconds>(t1-t0).count() << " ms";
+
+    vector<LevelAndRanks> out;
+    for (size_t i=0; i < levels.size(); i++)
+      out.push_back(LevelAndRanks{ levels[i], maps[i] });
+    return List<LevelAndRanks>::make(out);
+  }
+
 #ifdef KNOB_MOTA
   void add_geom(shared_ptr<AppGraph_> app_g, IList<LevelAndRanks> tree) {
     int center_scale_log2 = numeric_limits<int>::min();
@@ -326,26 +367,277 @@ int main(int arg_n, char **args) {
   else
     tie(bdry,tree) = make_mesh();
 
+  // partition=morton|hilbert|knapsack moves the mesh's boxes onto
+  // partition_ranks ranks, balancing each level on its own with
+  // partition_levels=each, see amr/partition.hxx
+  string partition_by = env<string>("partition", "");
+  if (!partition_by.empty()) {
+    int rank_n = env<int>("partition_ranks", 0);
+    USER_ASSERT(rank_n > 0, "partition=<method> needs partition_ranks=<n>.");
+    bool per_level = env<string>("partition_levels", "all") == "each";
+    tree = repartition(tree, rank_n, partition_by, per_level);
+  }
+
   int result = 0;
 
   if (env<bool>("events", false)) {
+    // format=bin writes the compact binary trace instead of xml, format=sim
+    // no trace at all but a prediction of its runtime, see simwriter.hxx,
+    // and format=critpath its critical path, see tracercritpath.hxx
+    string format = env<string>("format", "xml");
+    bool flag_binary = format == "bin";
+    bool flag_critpath = format == "critpath";
+    bool flag_sim = flag_critpath || format == "sim";
+    // compress=1 writes the xml compressed in blocks of about compress_block
+    // bytes, with an index of their epochs in <outfile>.idx
+    bool flag_compress = env<bool>("compress", false);
+    USER_ASSERT(!((flag_binary || flag_sim) && flag_compress), "compress=1 is for xml traces.");
+    size_t compress_block = env<size_t>("compress_block", 1<<22);
+    // shards=<n> writes an xml file per n ranks, outfile is then their manifest
+    int shard_ranks = env<int>("shards", 0);
+    USER_ASSERT(!(shard_ranks && (flag_binary || flag_sim || flag_compress)), "shards=<n> is for plain xml traces.");
+    int write_threads = env<int>("write_threads", 4);
+    // teams=ref lists each distinct team once in the xml and has colls name it
+    bool flag_team_refs = env<string>("teams", "list") == "ref";
+    USER_ASSERT(!(flag_team_refs && (shard_ranks || flag_compress)), "teams=ref can't be used with shards=<n> or compress=1.");
+    // templates=1 writes each repeating segment of events once, later
+    // segments of the same shape as <repeat/>, see templatewriter.hxx
+    bool flag_templates = env<bool>("templates", false);
+    USER_ASSERT(!(flag_templates && (flag_binary || flag_sim || flag_compress || shard_ranks)), "templates=1 is for plain xml traces.");
     string outdir = env<string>("outdir", "output");
-    string outfile = env<string>("outfile", "events.xml");
-    outfile = outdir + "/" + outfile;
-    if (flag_skip_existing && file_exists(outfile)) {
+    string outname = env<string>("outfile",
+      flag_binary ? "events.bin" :
+      flag_critpath ? "critpath.txt" :
+      flag_sim ? "sim.txt" :
+      flag_compress ? "events.xml.lz" :
+      shard_ranks ? "events.manifest" :
+      "events.xml"
+    );
+    string outfile = outdir + "/" + outname;
+    bool flag_resume = env<bool>("resume", false);
+    USER_ASSERT(!(flag_resume && flag_sim), "format=sim and format=critpath can't resume.");
+    // the network format=sim and format=critpath model
+    SimParams sim_params;
+    sim_params.latency = env<double>("sim_latency", sim_params.latency);
+    sim_params.overhead = env<double>("sim_overhead", sim_params.overhead);
+    sim_params.gap = env<double>("sim_gap", sim_params.gap);
+    sim_params.byte_time = env<double>("sim_byte_time", sim_params.byte_time);
+    
+    int rank_n = mesh_rank_n(tree);
+    // the trace is written from a background thread through write_buffers
+    // buffers of write_buffer bytes, write_buffer=0 writes it inline
+    size_t write_buffer = env<size_t>("write_buffer", 1<<20);
+    int write_buffers = env<int>("write_buffers", 2);
+    
+    auto make_tracer = [&](ostream *o)->unique_ptr<TracerXml> {
+      unique_ptr<TracerXml> tr;
+      if (flag_binary)
+        tr.reset(new TracerBinary(rank_n, o));
+      else if (flag_sim)
+        tr.reset(new TracerSim(rank_n, sim_params, o));
+      else if (flag_compress)
+        tr.reset(new TracerXml(rank_n, new BlockEventWriter(o, outfile + ".idx", compress_block)));
+      else if (shard_ranks) {
+        // shards are named after the manifest: events.manifest -> events.<shard>.xml
+        string stem = outname.substr(0, outname.rfind(".manifest"));
+        tr.reset(new TracerXml(rank_n, new ShardedEventWriter(o, outdir, stem, rank_n, shard_ranks, write_threads, flag_resume)));
+      }
+      else if (flag_templates)
+        tr.reset(new TracerXml(rank_n, new TemplateEventWriter(o, flag_team_refs)));
+      else
+        tr.reset(new TracerXml(rank_n, new XmlEventWriter(o, flag_team_refs)));
+      tr->checkpoint_file = env<string>("checkpoint_file", outfile + ".ckpt");
+      return tr;
+    };
+    
+    if (flag_resume) {
+      // keep what the checkpointed run wrote, the tracer seeks back into it
+      USER_ASSERT(file_exists(outfile), (string("Nothing to resume, no file: ") + outfile).c_str());
+      fstream o(outfile, ios::in | ios::out | ios::binary);
+      USER_ASSERT(o, (string("Could not open file: ") + outfile).c_str());
+      streamoff end;
+      {
+        unique_ptr<AsyncWriteBuf> abuf(write_buffer ? new AsyncWriteBuf(o.rdbuf(), write_buffer, write_buffers) : nullptr);
+        ostream ao(abuf ? (streambuf*)abuf.get() : o.rdbuf());
+        unique_ptr<TracerXml> tr = make_tracer(&ao);
+
+        Say() << "Resuming tracer into " << outfile << " from " << tr->checkpoint_file << " ...";
+        tr->run(main_ex(bdry, tree));
+
+        result = tr->verify() ? 0 : 1;
+        tr.reset(); // finishes the trace
+        ao.flush();
+        USER_ASSERT(ao, (string("Failed writing file: ") + outfile).c_str());
+      }
+      end = o.tellp();
+      o.close();
+      // drop anything the interrupted run wrote past where we finished
+      USER_ASSERT(0 == truncate(outfile.c_str(), end), (string("Could not truncate file: ") + outfile).c_str());
+    } else if (flag_skip_existing && file_exists(outfile)) {
       Say() << "Output file " << outfile << " already exists: skipping!";
+    } else if (flag_critpath) {
+      ofstream o(outfile);
+      USER_ASSERT(o, (string("Could not open file: ") + outfile).c_str());
+      TracerCritPath tr(sim_params, &o);
+
+      Say() << "Running critical path tracer to generate " << outfile << " ...";
+      tr.run(main_ex(bdry, tree));
+      tr.finish();
     } else {
       if (file_exists(outfile)) {
         Say() << "Output file " << outfile << " already exists: overwriting!";
       }
-      ofstream o(outfile);
+      ofstream o(outfile, ios::out | ios::binary);
       USER_ASSERT(o, (string("Could not open file: ") + outfile).c_str());
-      TracerXml tr(1, &o);
+      unique_ptr<AsyncWriteBuf> abuf(write_buffer ? new AsyncWriteBuf(o.rdbuf(), write_buffer, write_buffers) : nullptr);
+      ostream ao(abuf ? (streambuf*)abuf.get() : o.rdbuf());
+      unique_ptr<TracerXml> tr = make_tracer(&ao);
 
-      Say() << "Running XML tracer to generate " << outfile << " ...";
-      tr.run(main_ex(bdry, tree));
+      Say() << "Running " << (flag_binary ? "binary" : flag_sim ? "simulating" : flag_compress ? "compressed XML" : shard_ranks ? "sharded XML" : flag_templates ? "templated XML" : "XML") << " tracer to generate " << outfile << " ...";
+      tr->run(main_ex(bdry, tree));
 
-      result = tr.verify() ? 0 : 1;
+      result = tr->verify() ? 0 : 1;
+      tr.reset(); // finishes the trace
+      ao.flush();
+      USER_ASSERT(ao, (string("Failed writing file: ") + outfile).c_str());
+    }
+  }
+
+  // epochs=1 runs TracerGraph in its time-resolved mode, writing the load
+  // imbalance and traffic of each compute epoch and level as a table
+  if (env<bool>("epochs", false)) {
+    int rank_n = mesh_rank_n(tree);
+    string outfile = env<string>("outdir", "output") + "/" + env<string>("epochs_file", "epochs.tsv");
+    ofstream o(outfile);
+    USER_ASSERT(o, (string("Could not open file: ") + outfile).c_str());
+    TracerGraph tr(rank_n, &o);
+
+    Say() << "Running graph tracer to generate " << outfile << " ...";
+    tr.run(main_ex(bdry, tree));
+  }
+
+  // netmap=1 scores the mesh's rank map, placed on nodes node_rank_n
+  // ranks at a time (shuffled with rand_place=1), on each network of
+  // netmap_topos, see netmap.hxx. A row per network goes to
+  // <outdir>/netmap_stats.tsv.
+  if (env<bool>("netmap", false)) {
+    int rank_n = mesh_rank_n(tree);
+    TracerGraph tr(rank_n);
+    Say() << "Running graph tracer to capture comm events ...";
+    tr.run(main_ex(bdry, tree));
+    CommMatrix m = tr.comm_matrix(rank_n);
+
+    int node_rank_n = env<int>("node_rank_n", 1);
+    bool flag_rand_place = env<bool>("rand_place", false);
+    vector<int> node_of_rank = place_ranks(m.rank_n, node_rank_n, flag_rand_place);
+    int node_n = (m.rank_n + node_rank_n - 1)/node_rank_n;
+    Workers pool(tr.thread_n);
+
+    string outfile = env<string>("outdir", "output") + "/netmap_stats.tsv";
+    ofstream o(outfile);
+    USER_ASSERT(o, (string("Could not open file: ") + outfile).c_str());
+    o << "topo\tranks\tnodes\trouters\tmsgs\tbytes\toffnode_bytes\thop_bytes"
+      << "\tmean_dilation\tmax_dilation\tmax_link_load\tmean_link_load\tlinks_used\tms\n";
+
+    istringstream topos(env<string>("netmap_topos", "3dt-edi,3dt-exa,dfly-edi,dfly-exa"));
+    string label;
+    while (getline(topos, label, ',')) {
+      Topology t = Topology::make(label, node_n);
+      auto t0 = std::chrono::high_resolution_clock::now();
+      MappingScore s = score_mapping(m, node_of_rank, t, pool);
+      auto t1 = std::chrono::high_resolution_clock::now();
+      auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1-t0).count();
+
+      o << label << '\t' << m.rank_n << '\t' << node_n << '\t' << t.router_n()
+        << '\t' << s.msgs << '\t' << s.bytes << '\t' << s.offnode_bytes << '\t' << s.hop_bytes
+        << '\t' << s.mean_dilation << '\t' << s.max_dilation
+        << '\t' << s.max_link_load << '\t' << s.mean_link_load << '\t' << s.links_used
+        << '\t' << ms << '\n';
+      Say() << label << ": " << s.hop_bytes << " hop-bytes, max link " << s.max_link_load
+            << " bytes, dilation " << s.mean_dilation << " mean " << s.max_dilation << " max";
+    }
+  }
+
+  // boxtrace=1 traces once with each box on a rank of its own, then
+  // projects that trace onto a partition for each rank count of
+  // project_ranks, partitioned by project_by (partition_levels as above),
+  // see tracerrecord.hxx. Each writes <outdir>/comm.<n>.mtx, and with
+  // project_events=1 <outdir>/events.<n>.xml, with a row per rank count
+  // in <outdir>/project_stats.tsv.
+  if (env<bool>("boxtrace", false)) {
+    vector<boxtree::Level> levels;
+    vector<int> box_at{0};
+    vector<LevelAndRanks> box_tree;
+    tree->for_val([&](const LevelAndRanks &lr) {
+      int at = box_at.back();
+      levels.push_back(lr.level);
+      box_tree.push_back(LevelAndRanks{
+        lr.level,
+        BoxMap<int>::make_by_ix(lr.level.boxes, [&](int ix) { return at + ix; })
+      });
+      box_at.push_back(at + lr.level.boxes->size());
+    });
+
+    TracerRecord rec;
+    auto t0 = std::chrono::high_resolution_clock::now();
+    rec.run(main_ex(bdry, List<LevelAndRanks>::make(box_tree)));
+    auto t1 = std::chrono::high_resolution_clock::now();
+    Say() << "Recorded the box level trace of " << box_at.back() << " boxes in "
+          << std::chrono::duration_cast<std::chrono::milliseconds>(t1-t0).count() << " ms, "
+          << rec.bytes() << " bytes";
+
+    string outdir = env<string>("outdir", "output");
+    string method = env<string>("project_by", "hilbert");
+    bool per_level = env<string>("partition_levels", "all") == "each";
+    bool flag_events = env<bool>("project_events", false);
+    Workers pool(rec.thread_n);
+
+    string statfile = outdir + "/project_stats.tsv";
+    ofstream stats(statfile);
+    USER_ASSERT(stats, (string("Could not open file: ") + statfile).c_str());
+    stats << "ranks\tmsgs\tbytes\tnnz\tms\n";
+
+    istringstream rank_ns(env<string>("project_ranks", "2,4,8"));
+    string item;
+    while (getline(rank_ns, item, ',')) {
+      int rank_n = std::stoi(item);
+      auto t0 = std::chrono::high_resolution_clock::now();
+      vector<Ref<BoxMap<int>>> maps = partition(levels, rank_n, partition_method(method), per_level, pool);
+      vector<int> rank_of(box_at.back());
+      for (size_t l=0; l < levels.size(); l++) {
+        for (int ix=0; ix < levels[l].boxes->size(); ix++)
+          rank_of[box_at[l] + ix] = (*maps[l])(levels[l].boxes, ix);
+      }
+
+      TracerGraph graph(rank_n);
+      rec.replay(graph, rank_of);
+      CommMatrix m = graph.comm_matrix(rank_n);
+      auto t1 = std::chrono::high_resolution_clock::now();
+      auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1-t0).count();
+
+      string outfile = outdir + "/comm." + item + ".mtx";
+      ofstream o(outfile);
+      USER_ASSERT(o, (string("Could not open file: ") + outfile).c_str());
+      m.write_mtx(o);
+
+      uint64_t msgs = 0, bytes = 0;
+      for (size_t k=0; k < m.cols.size(); k++) {
+        msgs += m.msgs[k];
+        bytes += m.bytes[k];
+      }
+      stats << rank_n << '\t' << msgs << '\t' << bytes << '\t' << m.cols.size() << '\t' << ms << '\n';
+      Say() << "Projected onto " << rank_n << " ranks in " << ms << " ms: "
+            << msgs << " msgs, " << bytes << " bytes";
+
+      if (flag_events) {
+        string outfile = outdir + "/events." + item + ".xml";
+        ofstream o(outfile, ios::out | ios::binary);
+        USER_ASSERT(o, (string("Could not open file: ") + outfile).c_str());
+        TracerXml tr(rank_n, new XmlEventWriter(&o));
+        rec.replay(tr, rank_of);
+        if (!tr.verify())
+          result = 1;
+      }
     }
   }
 
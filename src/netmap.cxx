@@ -0,0 +1,221 @@
+#include "netmap.hxx"
+#include "diagnostic.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <random>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  int div_up(int a, int b) {
+    return (a + b - 1)/b;
+  }
+
+  // near cubic dims whose product holds `n`, largest first
+  void fit_torus(int n, int dims[3]) {
+    int d = std::max(1, int(std::ceil(std::cbrt(double(n)) - 1e-9)));
+    dims[0] = dims[1] = dims[2] = d;
+    for(int i=0; i < 3; i++) {
+      while(dims[i] > 1 && (dims[i]-1)*(dims[0]*dims[1]*dims[2]/dims[i]) >= n)
+        dims[i] -= 1;
+    }
+    std::sort(dims, dims+3, [](int a, int b) { return a > b; });
+  }
+}
+
+Topology Topology::make(const std::string &label, int node_n) {
+  Topology t;
+  t.label = label;
+  t.dims[0] = t.dims[1] = t.dims[2] = 0;
+  t.groups = t.routers = t.globals = 0;
+
+  auto dragonfly_fit = [&](int per, int routers, int globals) {
+    t.kind = dragonfly;
+    t.node_per_router = per;
+    t.routers = routers;
+    t.globals = globals;
+    t.groups = div_up(div_up(node_n, per), routers);
+  };
+
+  if(label == "3dt-edi" || label == "3dt-exa") {
+    t.kind = torus;
+    t.node_per_router = label == "3dt-edi" ? 2 : 1;
+    fit_torus(div_up(node_n, t.node_per_router), t.dims);
+  }
+  else if(label == "dfly-edi")
+    dragonfly_fit(4, 96, 10);
+  else if(label == "dfly-exa")
+    dragonfly_fit(16, 32, 16);
+  else {
+    int a = 0, b = 0, c = 0, per = 1;
+    int got = 0;
+    if(label.compare(0, 4, "3dt:") == 0) {
+      t.kind = torus;
+      got = std::sscanf(label.c_str() + 4, "%dx%dx%d/%d", &a, &b, &c, &per);
+      t.dims[0] = a; t.dims[1] = b; t.dims[2] = c;
+    }
+    else if(label.compare(0, 5, "dfly:") == 0) {
+      t.kind = dragonfly;
+      got = std::sscanf(label.c_str() + 5, "%dx%dx%d/%d", &a, &b, &c, &per);
+      t.groups = a; t.routers = b; t.globals = c;
+    }
+    USER_ASSERT_F(got >= 3 && a > 0 && b > 0 && c > 0 && per > 0, "Unknown topology: " << label);
+    t.node_per_router = per;
+  }
+
+  if(t.kind == dragonfly)
+    USER_ASSERT_F(t.groups - 1 <= t.routers*t.globals,
+      "Topology " << label << " can't join " << t.groups << " groups with " << t.routers*t.globals << " global links each."
+    );
+  USER_ASSERT_F(t.node_n() >= node_n, "Topology " << label << " has " << t.node_n() << " nodes, fewer than " << node_n << ".");
+  return t;
+}
+
+int Topology::router_n() const {
+  return kind == torus ? dims[0]*dims[1]*dims[2] : groups*routers;
+}
+
+int Topology::link_n() const {
+  return kind == torus ? 6*router_n() : groups*routers*(routers + globals);
+}
+
+/* Link ids:
+ *   torus: 6*router + 2*dim + (1 if going down)
+ *   dragonfly: local links first, (group*routers + from)*routers + to,
+ *     then groups*routers*routers + group*routers*globals + k for group's
+ *     k-th global link.
+ */
+void Topology::route(int a, int b, std::vector<std::uint32_t> &links) const {
+  if(kind == torus) {
+    int at[3] = {a % dims[0], a/dims[0] % dims[1], a/(dims[0]*dims[1])};
+    int to[3] = {b % dims[0], b/dims[0] % dims[1], b/(dims[0]*dims[1])};
+    int stride[3] = {1, dims[0], dims[0]*dims[1]};
+    int r = a;
+    for(int d=0; d < 3; d++) {
+      int n = dims[d];
+      int up = ((to[d] - at[d]) % n + n) % n;
+      bool down = up > n/2;
+      for(int s = down ? n - up : up; s > 0; s--) {
+        links.push_back(6*r + 2*d + (down ? 1 : 0));
+        int c = (r/stride[d]) % n;
+        int c1 = down ? (c + n - 1) % n : (c + 1) % n;
+        r += (c1 - c)*stride[d];
+      }
+    }
+  }
+  else {
+    int gs = a / routers, ls = a % routers;
+    int gd = b / routers, ld = b % routers;
+    uint32_t global0 = uint32_t(groups)*routers*routers;
+    auto local = [&](int g, int from, int to) {
+      if(from != to)
+        links.push_back((uint32_t(g)*routers + from)*routers + to);
+    };
+    if(gs == gd)
+      local(gs, ls, ld);
+    else {
+      int ks = ((gd - gs - 1) % groups + groups) % groups;
+      int kd = ((gs - gd - 1) % groups + groups) % groups;
+      local(gs, ls, ks / globals);
+      links.push_back(global0 + uint32_t(gs)*routers*globals + ks);
+      local(gd, kd / globals, ld);
+    }
+  }
+}
+
+MappingScore programr::score_mapping(
+    const CommMatrix &m, const std::vector<int> &node_of_rank,
+    const Topology &t, Workers &pool
+  ) {
+  USER_ASSERT(int(node_of_rank.size()) >= m.rank_n, "Placement misses some ranks.");
+  int worker_n = pool.size();
+  size_t link_n = t.link_n();
+
+  vector<MappingScore> scores(worker_n);
+  vector<vector<uint64_t>> loads(worker_n);
+  vector<vector<uint32_t>> routes(worker_n);
+  // each worker adds into loads of its own, no atomics
+  for(auto &l: loads)
+    l.assign(link_n, 0);
+
+  pool.parallel_for(m.rank_n, 64, [&](size_t src, int w) {
+    MappingScore &s = scores[w];
+    uint64_t *load = loads[w].data();
+    vector<uint32_t> &route = routes[w];
+    int from = t.router_of(node_of_rank[src]);
+
+    for(uint64_t k=m.row_at[src]; k < m.row_at[src+1]; k++) {
+      uint64_t bytes = m.bytes[k];
+      uint64_t msgs = m.msgs[k];
+      s.msgs += msgs;
+      s.bytes += bytes;
+      if(node_of_rank[m.cols[k]] == node_of_rank[src])
+        continue;
+      s.offnode_bytes += bytes;
+
+      route.clear();
+      t.route(from, t.router_of(node_of_rank[m.cols[k]]), route);
+      for(uint32_t link: route)
+        load[link] += bytes;
+      int hops = route.size();
+      s.hop_bytes += double(bytes)*hops;
+      s.mean_dilation += double(msgs)*hops; // summed, divided below
+      s.max_dilation = std::max(s.max_dilation, hops);
+    }
+  });
+
+  MappingScore all;
+  for(const MappingScore &s: scores) {
+    all.msgs += s.msgs;
+    all.bytes += s.bytes;
+    all.offnode_bytes += s.offnode_bytes;
+    all.hop_bytes += s.hop_bytes;
+    all.mean_dilation += s.mean_dilation;
+    all.max_dilation = std::max(all.max_dilation, s.max_dilation);
+  }
+  if(all.msgs != 0)
+    all.mean_dilation /= all.msgs;
+
+  // fold the workers' loads, also in parallel, by chunks of links
+  const size_t chunk = 1<<14;
+  size_t chunk_n = (link_n + chunk - 1)/chunk;
+  vector<uint64_t> chunk_max(chunk_n, 0), chunk_sum(chunk_n, 0);
+  vector<int> chunk_used(chunk_n, 0);
+  pool.parallel_for(chunk_n, 1, [&](size_t c, int) {
+    size_t lo = c*chunk, hi = std::min(link_n, lo + chunk);
+    for(size_t l=lo; l < hi; l++) {
+      uint64_t x = 0;
+      for(int w=0; w < worker_n; w++)
+        x += loads[w][l];
+      chunk_max[c] = std::max(chunk_max[c], x);
+      chunk_sum[c] += x;
+      chunk_used[c] += x != 0;
+    }
+  });
+  uint64_t load_sum = 0;
+  for(size_t c=0; c < chunk_n; c++) {
+    all.max_link_load = std::max(all.max_link_load, chunk_max[c]);
+    load_sum += chunk_sum[c];
+    all.links_used += chunk_used[c];
+  }
+  all.mean_link_load = link_n != 0 ? double(load_sum)/link_n : 0;
+  return all;
+}
+
+std::vector<int> programr::place_ranks(int rank_n, int node_rank_n, bool shuffle, unsigned seed) {
+  int node_n = div_up(rank_n, node_rank_n);
+  vector<int> nodes(node_n);
+  std::iota(nodes.begin(), nodes.end(), 0);
+  if(shuffle) {
+    std::mt19937 rng(seed);
+    std::shuffle(nodes.begin(), nodes.end(), rng);
+  }
+  vector<int> node_of_rank(rank_n);
+  for(int r=0; r < rank_n; r++)
+    node_of_rank[r] = nodes[r / node_rank_n];
+  return node_of_rank;
+}
@@ -0,0 +1,77 @@
+#ifndef _7d94e0b2_1f6a_4c3e_a8d5_2b6e91c04f37
+#define _7d94e0b2_1f6a_4c3e_a8d5_2b6e91c04f37
+
+# include "commmatrix.hxx"
+# include "lowlevel/workers.hxx"
+
+# include <cstdint>
+# include <string>
+# include <vector>
+
+/* Scores a placement of ranks on the nodes of a network, without Mota.
+ *
+ * A Topology is routers joined by directed links, each router serving
+ * node_per_router nodes. Routes are minimal and deterministic:
+ *
+ *   torus: routers on an X x Y x Z torus, routed dimension by dimension,
+ *     x first, the short way round (ties go up). 6 links per router.
+ *   dragonfly: `groups` of `routers` routers each, all to all within a
+ *     group, and `globals` links per router to other groups. Group i's
+ *     k-th global link goes to group (i + k + 1) % groups, from router
+ *     k / globals. A route is at most local, global, local.
+ *
+ * The labels run_mota_mappers sweeps name shapes after Edison's and an
+ * exascale machine's networks, sized to the fewest routers holding the
+ * nodes:
+ *
+ *   3dt-edi: 2 nodes per router, as on Gemini. 3dt-exa: 1.
+ *   dfly-edi: 4 nodes per router, 96 routers and 10 globals, as on Aries.
+ *   dfly-exa: 16 nodes per router, 32 routers and 16 globals.
+ *
+ * An explicit shape is "3dt:<X>x<Y>x<Z>[/<nodes per router>]" or
+ * "dfly:<groups>x<routers>x<globals>[/<nodes per router>]".
+ */
+namespace programr {
+  struct Topology {
+    enum Kind { torus, dragonfly };
+    Kind kind;
+    std::string label;
+    int node_per_router;
+    int dims[3]; // torus
+    int groups, routers, globals; // dragonfly
+
+    // USER_ASSERTs on labels it doesn't know or nodes that don't fit
+    static Topology make(const std::string &label, int node_n);
+
+    int router_n() const;
+    int node_n() const { return router_n()*node_per_router; }
+    int link_n() const;
+    int router_of(int node) const { return node / node_per_router; }
+
+    // appends the links from router a to b, in order
+    void route(int a, int b, std::vector<std::uint32_t> &links) const;
+  };
+
+  struct MappingScore {
+    std::uint64_t msgs = 0, bytes = 0;
+    std::uint64_t offnode_bytes = 0; // sent between different nodes
+    double hop_bytes = 0; // sum of bytes times links crossed
+    double mean_dilation = 0; // links crossed per message
+    int max_dilation = 0;
+    std::uint64_t max_link_load = 0; // bytes over the busiest link
+    double mean_link_load = 0; // over all links
+    int links_used = 0;
+  };
+
+  // `node_of_rank[r]` is the node rank r runs on. Rows of `m` are routed
+  // in parallel on `pool`, each worker adding into its own link loads.
+  MappingScore score_mapping(
+    const CommMatrix &m, const std::vector<int> &node_of_rank,
+    const Topology &t, Workers &pool
+  );
+
+  // ranks in blocks of `node_rank_n` per node, nodes in order or, with
+  // `shuffle`, in a random order fixed by `seed`
+  std::vector<int> place_ranks(int rank_n, int node_rank_n, bool shuffle, unsigned seed=0);
+}
+#endif
@@ -2,6 +2,7 @@
 
 #include <cmath>
 #include <cassert>
+#include <cstdio>
 #include <array>
 
 using namespace std;
@@ -0,0 +1,217 @@
+#include "shardwriter.hxx"
+#include "diagnostic.hxx"
+
+#include <fstream>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  // shards are written out once this many bytes are buffered over all
+  const size_t shard_flush_bytes = 1<<24;
+}
+
+ShardedEventWriter::ShardedEventWriter(
+    std::ostream *manifest,
+    const std::string &dir, const std::string &stem,
+    int rank_n, int shard_ranks,
+    int write_threads,
+    bool resume
+  ):
+  _manifest(manifest),
+  _dir(dir),
+  _stem(stem),
+  _rank_n(rank_n),
+  _shard_ranks(shard_ranks < 1 ? 1 : shard_ranks),
+  _shards((rank_n + _shard_ranks-1) / _shard_ranks),
+  _pool(write_threads) {
+
+  // a resumed run's shards already have this, a fresh run's are
+  // truncated by their first write
+  if(!resume) {
+    for(uint32_t s=0; s < _shards.size(); s++)
+      _put(s, "<events>\n");
+  }
+
+  _put_manifest();
+}
+
+string ShardedEventWriter::_name(uint32_t shard) const {
+  return _stem + "." + to_string(shard) + ".xml";
+}
+
+string ShardedEventWriter::_path(uint32_t shard) const {
+  return _dir + "/" + _name(shard);
+}
+
+uint32_t ShardedEventWriter::_shard_of(int rank) {
+  USER_ASSERT_F(0 <= rank && rank < _rank_n, "Rank " << rank << " is outside the " << _rank_n << " ranks being sharded.");
+  return uint32_t(rank / _shard_ranks);
+}
+
+void ShardedEventWriter::_put(uint32_t shard, const string &xml) {
+  Shard &sh = _shards[shard];
+  if(sh.raw.empty())
+    _dirty.push_back(shard);
+  sh.raw += xml;
+  _pending_bytes += xml.size();
+}
+
+void ShardedEventWriter::_wrote_event() {
+  if(_pending_bytes >= shard_flush_bytes)
+    _write_shards();
+}
+
+void ShardedEventWriter::_write_shards() {
+  vector<char> ok(_dirty.size());
+  
+  _pool.parallel_for(_dirty.size(), 1, [&](size_t d, int) {
+    Shard &sh = _shards[_dirty[d]];
+    // an empty file is started afresh, anything from an earlier run goes
+    auto mode = ios::out | ios::binary | (sh.size == 0 ? ios::trunc : ios::app);
+    ofstream f(_path(_dirty[d]), mode);
+    f.write(sh.raw.data(), sh.raw.size());
+    f.close();
+    ok[d] = bool(f);
+    
+    sh.size += sh.raw.size();
+    sh.raw.clear();
+    sh.raw.shrink_to_fit();
+  });
+  
+  for(size_t d=0; d < _dirty.size(); d++)
+    USER_ASSERT_F(ok[d], "Could not write shard " << _path(_dirty[d]));
+  
+  _dirty.clear();
+  _pending_bytes = 0;
+}
+
+void ShardedEventWriter::comm(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    int from, int to,
+    size_t bytes,
+    uint64_t epoch
+  ) {
+  uint32_t a = _shard_of(from), b = _shard_of(to);
+  _scratch.clear();
+  put_xml_comm(_scratch, id, deps, dep_n, from, to, bytes, epoch);
+  
+  _put(a, _scratch);
+  _shards[a].comm_n += 1;
+  if(b != a) {
+    _put(b, _scratch);
+    _shards[b].comm_n += 1;
+  }
+  _wrote_event();
+}
+
+void ShardedEventWriter::comp(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    int at,
+    double seconds,
+    uint64_t epoch,
+    const TaskNote *note
+  ) {
+  uint32_t s = _shard_of(at);
+  _scratch.clear();
+  put_xml_comp(_scratch, id, deps, dep_n, at, seconds, epoch, note);
+  
+  _put(s, _scratch);
+  _shards[s].comp_n += 1;
+  _wrote_event();
+}
+
+void ShardedEventWriter::coll(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    const int *team, size_t team_n,
+    size_t bytes,
+    uint64_t epoch
+  ) {
+  _coll_n += 1;
+  _scratch.clear();
+  put_xml_coll(_scratch, id, deps, dep_n, team, team_n, bytes, epoch);
+  
+  for(size_t i=0; i < team_n; i++) {
+    uint32_t s = _shard_of(team[i]);
+    Shard &sh = _shards[s];
+    if(sh.stamp != _coll_n) {
+      sh.stamp = _coll_n;
+      _put(s, _scratch);
+      sh.coll_n += 1;
+    }
+  }
+  _wrote_event();
+}
+
+void ShardedEventWriter::_put_manifest() {
+  ostream &o = *_manifest;
+  o << "programr-shards 1\n"
+    << "ranks " << _rank_n << " shard_ranks " << _shard_ranks << '\n'
+    << "shards " << _shards.size() << '\n';
+  for(uint32_t s=0; s < _shards.size(); s++) {
+    const Shard &sh = _shards[s];
+    int lo = s*_shard_ranks;
+    int hi = std::min<int>(lo + _shard_ranks, _rank_n) - 1;
+    o << s << ' ' << lo << ' ' << hi << ' ' << _name(s) << ' '
+      << sh.comm_n << ' ' << sh.comp_n << ' ' << sh.coll_n << '\n';
+  }
+}
+
+void ShardedEventWriter::finish() {
+  for(uint32_t s=0; s < _shards.size(); s++)
+    _put(s, "</events>\n");
+  _write_shards();
+
+  _manifest->seekp(0);
+  _put_manifest();
+  _manifest->flush();
+}
+
+uint64_t ShardedEventWriter::offset() {
+  _manifest->flush();
+  return (uint64_t)_manifest->tellp();
+}
+
+void ShardedEventWriter::checkpoint_save(std::ostream &o) {
+  _write_shards();
+
+  o << "shards " << _shards.size() << ' ' << _coll_n << '\n';
+  for(const Shard &sh: _shards)
+    o << sh.size << ' ' << sh.comm_n << ' ' << sh.comp_n << ' ' << sh.coll_n << '\n';
+}
+
+void ShardedEventWriter::checkpoint_load(std::istream &i, uint64_t offset) {
+  string word;
+  size_t shard_n;
+  i >> word >> shard_n >> _coll_n;
+  USER_ASSERT_F(i && word == "shards" && shard_n == _shards.size(),
+    "Bad checkpoint file: not for a trace in " << _shards.size() << " shards."
+  );
+
+  for(uint32_t s=0; s < _shards.size(); s++) {
+    Shard &sh = _shards[s];
+    i >> sh.size >> sh.comm_n >> sh.comp_n >> sh.coll_n;
+    USER_ASSERT(i && sh.size != 0, "Bad checkpoint file: shard offsets.");
+    sh.raw.clear();
+    sh.stamp = 0;
+
+    // drop what the interrupted run wrote past the checkpoint, so later
+    // writes append where it left off
+    string path = _path(s);
+    struct stat st;
+    USER_ASSERT_F(0 == stat(path.c_str(), &st) && uint64_t(st.st_size) >= sh.size,
+      "Shard " << path << " is shorter than the " << sh.size << " bytes written when the checkpoint was made."
+    );
+    USER_ASSERT_F(0 == truncate(path.c_str(), sh.size), "Could not truncate file: " << path);
+  }
+  _dirty.clear();
+  _pending_bytes = 0;
+
+  rewind_to(_manifest, offset);
+}
@@ -0,0 +1,105 @@
+#ifndef _5e0304a8_bf8f_42b2_8962_beb681d6a7a6
+#define _5e0304a8_bf8f_42b2_8962_beb681d6a7a6
+
+# include "eventwriter.hxx"
+# include "lowlevel/workers.hxx"
+
+# include <cstdint>
+# include <string>
+# include <vector>
+
+/* ShardedEventWriter splits the trace into one events.xml style file per
+ * group of `shard_ranks` consecutive ranks, so a distributed replay can
+ * have each process read only its own ranks' events. A shard gets:
+ *   comps at its ranks,
+ *   comms from or to its ranks (a comm within one shard appears once),
+ *   colls with any of its ranks in the team.
+ * Ids and deps are the global ones, so deps may name events that live in
+ * other shards, and an event can appear in several shards.
+ *
+ * Shards are named <dir>/<stem>.<shard>.xml. The output stream given to
+ * the constructor gets a text manifest tying them together:
+ *   programr-shards 1
+ *   ranks <rank n> shard_ranks <ranks per shard>
+ *   shards <n>
+ *   <shard> <first rank> <last rank> <file name> <comms> <comps> <colls>
+ *   ... one line per shard.
+ * It is written when the writer is made, with zero counts, and again by
+ * finish() with the real ones.
+ *
+ * Events are formatted serially into per shard buffers. Once enough has
+ * built up, the shards with anything buffered are appended to in parallel
+ * over `write_threads` threads, each file open only while it is written.
+ * So however many shards there are, at most `write_threads` of them are
+ * open at once and idle shards cost nothing per write.
+ */
+namespace programr {
+  class ShardedEventWriter: public EventWriter {
+    struct Shard {
+      std::string raw; // formatted but not yet written
+      std::uint64_t size = 0; // bytes in the file
+      std::uint64_t comm_n = 0, comp_n = 0, coll_n = 0;
+      std::uint64_t stamp = 0; // last coll that went to this shard
+    };
+
+    std::ostream *_manifest;
+    std::string _dir, _stem;
+    int _rank_n, _shard_ranks;
+    std::vector<Shard> _shards;
+    std::vector<std::uint32_t> _dirty; // shards with raw output, unordered
+    Workers _pool;
+    std::size_t _pending_bytes = 0; // in raw over all shards
+    std::uint64_t _coll_n = 0;
+    std::string _scratch; // one event's xml
+
+  public:
+    // `resume` leaves existing shards for checkpoint_load() to cut back
+    // to the checkpoint instead of starting them afresh
+    ShardedEventWriter(
+      std::ostream *manifest,
+      const std::string &dir, const std::string &stem,
+      int rank_n, int shard_ranks=1,
+      int write_threads=4,
+      bool resume=false
+    );
+
+    void comm(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      int from, int to,
+      std::size_t bytes,
+      std::uint64_t epoch
+    );
+    void comp(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      int at,
+      double seconds,
+      std::uint64_t epoch,
+      const TaskNote *note
+    );
+    void coll(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      const int *team, std::size_t team_n,
+      std::size_t bytes,
+      std::uint64_t epoch
+    );
+    void finish();
+
+    // the manifest's offset, shard offsets go in checkpoint_save()
+    std::uint64_t offset();
+    void checkpoint_save(std::ostream &o);
+    void checkpoint_load(std::istream &i, std::uint64_t offset);
+
+  private:
+    std::uint32_t _shard_of(int rank);
+    std::string _name(std::uint32_t shard) const;
+    std::string _path(std::uint32_t shard) const;
+    void _put(std::uint32_t shard, const std::string &xml);
+    void _wrote_event();
+    void _write_shards();
+    void _put_manifest();
+  };
+}
+#endif
@@ -0,0 +1,127 @@
+#include "simwriter.hxx"
+#include "diagnostic.hxx"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace programr;
+using namespace std;
+
+SimEventWriter::SimEventWriter(int rank_n, const SimParams &p, std::ostream *report):
+  _p(p),
+  _report(report) {
+  _grow(rank_n - 1);
+}
+
+void SimEventWriter::_grow(int rank) {
+  DEV_ASSERT(rank >= -1);
+  size_t n = rank + 1;
+  if(n > _rank_free.size()) {
+    _rank_free.resize(n, 0);
+    _rank_busy.resize(n, 0);
+    _send_free.resize(n, 0);
+    _recv_free.resize(n, 0);
+  }
+}
+
+double SimEventWriter::_ready(const uint64_t *deps, size_t dep_n) const {
+  double t = 0;
+  for(size_t i=0; i < dep_n; i++) {
+    const double *done = _done.find(deps[i]);
+    if(done)
+      t = std::max(t, *done);
+  }
+  return t;
+}
+
+void SimEventWriter::_set_done(uint64_t id, double t) {
+  _done[id] = t;
+  _makespan = std::max(_makespan, t);
+}
+
+void SimEventWriter::retire(uint64_t id) {
+  _done.erase(id);
+}
+
+void SimEventWriter::comm(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    int from, int to,
+    size_t bytes,
+    uint64_t epoch
+  ) {
+  double t = _ready(deps, dep_n);
+  if(from != to) {
+    _grow(std::max(from, to));
+    double wire = bytes*_p.byte_time;
+
+    double send = std::max(t, _send_free[from]);
+    _send_free[from] = send + std::max(_p.gap, _p.overhead + wire);
+    double arrive = send + _p.overhead + wire + _p.latency;
+
+    double drained = std::max(arrive, _recv_free[to] + wire);
+    _recv_free[to] = drained;
+    t = drained + _p.overhead;
+
+    _msg_n += 1;
+    _msg_bytes += bytes;
+  }
+  _set_done(id, t);
+}
+
+void SimEventWriter::comp(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    int at,
+    double seconds,
+    uint64_t epoch,
+    const TaskNote *note
+  ) {
+  _grow(at);
+  double start = std::max(_ready(deps, dep_n), _rank_free[at]);
+  _rank_free[at] = start + seconds;
+  _rank_busy[at] += seconds;
+  _set_done(id, start + seconds);
+}
+
+void SimEventWriter::coll(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    const int *team, size_t team_n,
+    size_t bytes,
+    uint64_t epoch
+  ) {
+  int rounds = 0;
+  while((size_t(1) << rounds) < team_n)
+    rounds += 1;
+  double t = _ready(deps, dep_n);
+  t += rounds*(_p.latency + 2*_p.overhead + bytes*_p.byte_time);
+  _coll_n += 1;
+  _set_done(id, t);
+}
+
+void SimEventWriter::finish() {
+  int rank_n = _rank_busy.size();
+  double busy_sum = 0;
+  for(double b: _rank_busy)
+    busy_sum += b;
+  double idle_frac = _makespan > 0 && rank_n > 0 ? 1 - busy_sum/(rank_n*_makespan) : 0;
+
+  ostream &o = *_report;
+  o << "makespan " << _makespan << '\n'
+    << "compute " << busy_sum << '\n'
+    << "idle " << idle_frac << '\n'
+    << "messages " << _msg_n << " bytes " << _msg_bytes << '\n'
+    << "allreduces " << _coll_n << '\n'
+    << "ranks " << rank_n << '\n'
+    << "rank\tbusy\tidle\n";
+  for(int r=0; r < rank_n; r++)
+    o << r << '\t' << _rank_busy[r] << '\t' << _makespan - _rank_busy[r] << '\n';
+  o.flush();
+
+  Say() << "predicted makespan " << _makespan << "s, ranks idle " << 100*idle_frac << "% of it";
+}
+
+void SimEventWriter::checkpoint_load(std::istream &i, uint64_t offset) {
+  USER_ASSERT(false, "format=sim can't resume from a checkpoint.");
+}
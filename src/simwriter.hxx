@@ -0,0 +1,92 @@
+#ifndef _8a4f76c7_b46f_4cde_8d74_bbf3d5b9e9b9
+#define _8a4f76c7_b46f_4cde_8d74_bbf3d5b9e9b9
+
+# include "eventwriter.hxx"
+# include "lowlevel/idmap.hxx"
+
+# include <cstdint>
+# include <iostream>
+# include <vector>
+
+/* SimEventWriter predicts the runtime of a trace as it is generated,
+ * instead of writing it. Every event is placed as soon as its deps are
+ * done and its resources are free, taking resources in the order events
+ * arrive, which is the order the tracer issues them:
+ *
+ *   comp: runs for its seconds on its rank, one at a time per rank.
+ *   comm: LogGP. The sender's nic injects a message of b bytes in
+ *     o + b*G, starting no sooner than g after its previous one; it lands
+ *     L later, and the receiver's nic takes b*G to drain it, one message
+ *     at a time, before o more on the receiving end. Messages to self
+ *     are free.
+ *   coll: an allreduce by recursive doubling, ceil(log2 team) rounds of
+ *     L + 2*o + b*G once all its deps are done. It holds no rank.
+ *
+ * Overheads hold the nics but not the ranks' compute. Done times are
+ * kept per event until the tracer retires it, so with stream=1 memory
+ * follows the live events rather than the trace's length.
+ */
+namespace programr {
+  struct SimParams {
+    double latency = 1e-6; // L, seconds
+    double overhead = 2e-7; // o, seconds per message per end
+    double gap = 1e-7; // g, seconds between message injections
+    double byte_time = 1e-10; // G, seconds per byte
+  };
+
+  class SimEventWriter: public EventWriter {
+    SimParams _p;
+    std::ostream *_report;
+
+    IdMap<double> _done; // by event id
+    std::vector<double> _rank_free, _rank_busy;
+    std::vector<double> _send_free, _recv_free;
+    double _makespan = 0;
+    std::uint64_t _msg_n = 0, _msg_bytes = 0, _coll_n = 0;
+
+  public:
+    // writes its report to `report` on finish()
+    SimEventWriter(int rank_n, const SimParams &p, std::ostream *report);
+
+    void comm(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      int from, int to,
+      std::size_t bytes,
+      std::uint64_t epoch
+    );
+    void comp(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      int at,
+      double seconds,
+      std::uint64_t epoch,
+      const TaskNote *note
+    );
+    void coll(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      const int *team, std::size_t team_n,
+      std::size_t bytes,
+      std::uint64_t epoch
+    );
+    void retire(std::uint64_t id);
+    void finish();
+
+    // the simulation is all in memory, so there's nothing to resume into
+    std::uint64_t offset() { return 0; }
+    void checkpoint_load(std::istream &i, std::uint64_t offset);
+
+    double makespan() const { return _makespan; }
+    // seconds rank `r` computed
+    double busy(int r) const { return r < (int)_rank_busy.size() ? _rank_busy[r] : 0; }
+    // events whose done time is kept
+    std::size_t live_n() const { return _done.size(); }
+
+  private:
+    double _ready(const std::uint64_t *deps, std::size_t dep_n) const;
+    void _set_done(std::uint64_t id, double t);
+    void _grow(int rank);
+  };
+}
+#endif
@@ -0,0 +1,24 @@
+#include "tasknote.hxx"
+
+#include <deque>
+#include <unordered_map>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  // deque so name() references stay valid as the table grows
+  deque<string> op_names;
+  unordered_map<string, uint32_t> op_ids;
+}
+
+uint32_t TaskNote::intern(const string &name) {
+  auto got = op_ids.insert({name, (uint32_t)op_names.size()});
+  if(got.second)
+    op_names.push_back(name);
+  return got.first->second;
+}
+
+const string& TaskNote::name(uint32_t op) {
+  return op_names[op];
+}
@@ -0,0 +1,26 @@
+#ifndef _a461bf89_2c14_4658_a884_6df0bc98dd22
+#define _a461bf89_2c14_4658_a884_6df0bc98dd22
+
+# include <cstdint>
+# include <iostream>
+# include <string>
+
+namespace programr {
+  // What a task was emitted for: an interned op name plus the level and
+  // box it covers. Kept in parts so that tracers which never print notes
+  // pay nothing for them. Prints as "<name> lev=<lev> box=<box>".
+  struct TaskNote {
+    std::uint32_t op; // from intern()
+    std::int32_t lev;
+    std::int32_t box;
+    
+    // returns the same id for equal names, not thread safe
+    static std::uint32_t intern(const std::string &name);
+    static const std::string& name(std::uint32_t op);
+  };
+  
+  inline std::ostream& operator<<(std::ostream &o, const TaskNote &note) {
+    return o << TaskNote::name(note.op) << " lev=" << note.lev << " box=" << note.box;
+  }
+}
+#endif
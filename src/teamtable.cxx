@@ -0,0 +1,75 @@
+#include "teamtable.hxx"
+#include "diagnostic.hxx"
+#include "lowlevel/bitops.hxx"
+
+using namespace programr;
+using namespace std;
+
+uint32_t TeamTable::intern(const int *ranks, size_t n) {
+  vector<uint64_t> &bits = _scratch.bits;
+  bits.clear();
+  for(size_t i=0; i < n; i++) {
+    DEV_ASSERT(ranks[i] >= 0);
+    size_t w = size_t(ranks[i]) >> 6;
+    if(w >= bits.size())
+      bits.resize(w+1, 0);
+    bits[w] |= uint64_t(1) << (ranks[i] & 63);
+  }
+
+  uint64_t h = 0x9e3779b97f4a7c15u;
+  for(uint64_t w: bits)
+    h = (h ^ w) * 0xff51afd7ed558ccdu, h ^= h >> 32;
+
+  auto range = _by_hash.equal_range(h);
+  for(auto it = range.first; it != range.second; ++it) {
+    if(_teams[it->second].bits == bits) {
+      _teams[it->second].ref_n += 1;
+      return it->second;
+    }
+  }
+
+  uint32_t id;
+  if(!_free.empty()) {
+    id = _free.back();
+    _free.pop_back();
+  }
+  else {
+    id = _teams.size();
+    _teams.push_back(Team());
+  }
+  Team &t = _teams[id];
+  t.bits = bits;
+  for(size_t w=0; w < bits.size(); w++) {
+    for(uint64_t x = bits[w]; x != 0; x &= x-1)
+      t.ranks.push_back(int(64*w + bitffs(x) - 1));
+  }
+  t.hash = h;
+  t.ref_n = 1;
+  _by_hash.emplace(h, id);
+  return id;
+}
+
+void TeamTable::release(uint32_t team) {
+  Team &t = _teams[team];
+  DEV_ASSERT(t.ref_n > 0);
+  if(--t.ref_n != 0)
+    return;
+
+  auto range = _by_hash.equal_range(t.hash);
+  for(auto it = range.first; it != range.second; ++it) {
+    if(it->second == team) {
+      _by_hash.erase(it);
+      break;
+    }
+  }
+  // give the memory back, a big team may not come again
+  std::vector<uint64_t>().swap(t.bits);
+  std::vector<int>().swap(t.ranks);
+  _free.push_back(team);
+}
+
+void TeamTable::clear() {
+  _teams.clear();
+  _free.clear();
+  _by_hash.clear();
+}
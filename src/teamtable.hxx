@@ -0,0 +1,48 @@
+#ifndef _b098e151_0ea4_4551_9216_249abad543d9
+#define _b098e151_0ea4_4551_9216_249abad543d9
+
+# include <cstdint>
+# include <unordered_map>
+# include <vector>
+
+/* TeamTable interns sets of ranks. Equal sets get the same id, however
+ * their ranks were ordered, and each set is stored once as a bitset for
+ * membership tests plus its ranks in ascending order. Every intern()
+ * holds a reference to the team until a matching release(); a team no
+ * one holds is dropped and its id handed to the next new team, so the
+ * table only grows with the teams in use, not every team ever seen.
+ */
+namespace programr {
+  class TeamTable {
+    struct Team {
+      std::vector<std::uint64_t> bits; // bit r set for rank r, no trailing zero words
+      std::vector<int> ranks; // ascending
+      std::uint64_t hash;
+      std::size_t ref_n; // 0 for a free id
+    };
+    std::vector<Team> _teams;
+    std::vector<std::uint32_t> _free; // ids of dropped teams
+    // hash of bits -> ids of the teams with that hash
+    std::unordered_multimap<std::uint64_t, std::uint32_t> _by_hash;
+    Team _scratch;
+
+  public:
+    // the id of the team of `ranks`, which may repeat and be in any order
+    std::uint32_t intern(const int *ranks, std::size_t n);
+    // drops a reference taken by intern()
+    void release(std::uint32_t team);
+
+    bool has(std::uint32_t team, int rank) const {
+      const std::vector<std::uint64_t> &bits = _teams[team].bits;
+      std::size_t w = std::size_t(rank) >> 6;
+      return rank >= 0 && w < bits.size() && (bits[w] >> (rank & 63) & 1);
+    }
+    const std::vector<int>& ranks(std::uint32_t team) const {
+      return _teams[team].ranks;
+    }
+    // teams held
+    std::size_t size() const { return _teams.size() - _free.size(); }
+    void clear();
+  };
+}
+#endif
@@ -0,0 +1,495 @@
+#include "templatewriter.hxx"
+#include "diagnostic.hxx"
+#include "lowlevel/spookyhash.hxx"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  // ids relative to the lanes' next ids, as 3*zigzag(n - next n)+lane
+  inline uint64_t rel_id(uint64_t id, const uint64_t next_n[3]) {
+    uint64_t lane = id % 3;
+    int64_t d = int64_t(id/3 - next_n[lane]);
+    return 3*((uint64_t(d) << 1) ^ uint64_t(d >> 63)) + lane;
+  }
+
+  inline uint64_t abs_id(uint64_t rel, const uint64_t next_n[3]) {
+    uint64_t lane = rel % 3, z = rel / 3;
+    int64_t d = int64_t(z >> 1) ^ -int64_t(z & 1);
+    return 3*(next_n[lane] + uint64_t(d)) + lane;
+  }
+
+  // a dep as 2*rel_id(), or as 2*id+1 if `fixed`
+  inline uint64_t dep_code(uint64_t dep, bool fixed, const uint64_t next_n[3]) {
+    return fixed ? 2*dep + 1 : 2*rel_id(dep, next_n);
+  }
+
+  inline uint64_t dep_decode(uint64_t code, const uint64_t next_n[3]) {
+    return code & 1 ? code >> 1 : abs_id(code >> 1, next_n);
+  }
+
+  // advances the lanes' next ids past the ids of `evs`
+  void advance(uint64_t next_n[3], const TemplateEvent *evs, size_t n) {
+    for(size_t i=0; i < n; i++) {
+      uint64_t lane = evs[i].id % 3;
+      next_n[lane] = std::max(next_n[lane], evs[i].id/3 + 1);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////
+// TemplateEventWriter
+
+TemplateEventWriter::TemplateEventWriter(std::ostream *file, bool team_refs, std::uint64_t keep_epochs):
+  _xml(file, team_refs),
+  _keep_epochs(std::max<uint64_t>(keep_epochs, 1)) {
+}
+
+TemplateEvent& TemplateEventWriter::_add(TemplateEvent::Kind kind, uint64_t id, const uint64_t *deps, size_t dep_n, uint64_t epoch) {
+  _events.push_back(TemplateEvent());
+  TemplateEvent &e = _events.back();
+  e.kind = kind;
+  e.noted = false;
+  e.id = id;
+  e.dep_at = _deps.size();
+  e.dep_n = dep_n;
+  e.rank = -1;
+  e.to = -1;
+  e.team_at = 0;
+  e.team_n = 0;
+  e.bytes = 0;
+  e.seconds = 0;
+  e.epoch = epoch;
+  _deps.insert(_deps.end(), deps, deps + dep_n);
+  return e;
+}
+
+void TemplateEventWriter::comm(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    int from, int to,
+    size_t bytes,
+    uint64_t epoch
+  ) {
+  TemplateEvent &e = _add(TemplateEvent::comm, id, deps, dep_n, epoch);
+  e.rank = from;
+  e.to = to;
+  e.bytes = bytes;
+}
+
+void TemplateEventWriter::comp(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    int at,
+    double seconds,
+    uint64_t epoch,
+    const TaskNote *note
+  ) {
+  TemplateEvent &e = _add(TemplateEvent::comp, id, deps, dep_n, epoch);
+  e.rank = at;
+  e.seconds = seconds;
+  if(note) {
+    e.noted = true;
+    e.note = *note;
+  }
+}
+
+void TemplateEventWriter::coll(
+    uint64_t id,
+    const uint64_t *deps, size_t dep_n,
+    const int *team, size_t team_n,
+    size_t bytes,
+    uint64_t epoch
+  ) {
+  TemplateEvent &e = _add(TemplateEvent::coll, id, deps, dep_n, epoch);
+  e.team_at = _team_ranks.size();
+  e.team_n = team_n;
+  e.bytes = bytes;
+  _team_ranks.insert(_team_ranks.end(), team, team + team_n);
+}
+
+void TemplateEventWriter::epoch_begin(uint64_t comp_epoch) {
+  _end_segment();
+
+  // once per _keep_epochs, forget skeletons not seen for that long. it
+  // only depends on the epochs, so a resumed run forgets the same ones.
+  if(comp_epoch / _keep_epochs != _epoch / _keep_epochs) {
+    for(auto it = _lasts.begin(); it != _lasts.end();) {
+      if(it->second.epoch + _keep_epochs < comp_epoch)
+        it = _lasts.erase(it);
+      else
+        ++it;
+    }
+  }
+  _epoch = comp_epoch;
+}
+
+void TemplateEventWriter::_end_segment() {
+  if(_events.empty())
+    return;
+
+  // everything but the deps
+  SpookyHasher h;
+  for(const TemplateEvent &e: _events) {
+    uint64_t head[] = {
+      uint64_t(e.kind), uint64_t(e.noted),
+      rel_id(e.id, _next_n), e.dep_n,
+      uint64_t(e.rank), uint64_t(e.to), e.team_n, e.bytes,
+      e.epoch - _epoch
+    };
+    h.consume(head);
+    h.consume(_team_ranks.data() + e.team_at, e.team_n*sizeof(int));
+    h.consume(e.seconds);
+    if(e.noted) {
+      h.consume(TaskNote::name(e.note.op).c_str());
+      h.consume(e.note.lev);
+      h.consume(e.note.box);
+    }
+  }
+  Digest<128> skel = h.digest();
+
+  auto digest = [&](const vector<uint64_t> &fixed)->Digest<128> {
+    SpookyHasher hd = h;
+    hd.consume(fixed.size());
+    for(size_t d=0, f=0; d < _deps.size(); d++) {
+      bool is_fixed = f < fixed.size() && fixed[f] == d;
+      f += is_fixed;
+      hd.consume(dep_code(_deps[d], is_fixed, _next_n));
+    }
+    return hd.digest();
+  };
+
+  // try all deps moving with the ids first, then fixing the ones that
+  // the last segment of this skeleton had too but that didn't move
+  vector<uint64_t> &fixed = _fixed;
+  fixed.clear();
+  Digest<128> dig = digest(fixed);
+  auto got = _shapes.find(dig);
+
+  Last &last = _lasts[skel];
+  if(got == _shapes.end() && !last.deps.empty()) {
+    for(size_t d=0; d < _deps.size(); d++) {
+      if(_deps[d] == last.deps[d] && rel_id(_deps[d], _next_n) != rel_id(last.deps[d], last.next_n))
+        fixed.push_back(d);
+    }
+    if(!fixed.empty()) {
+      dig = digest(fixed);
+      got = _shapes.find(dig);
+    }
+  }
+  last.deps = _deps;
+  std::copy(_next_n, _next_n + 3, last.next_n);
+  last.epoch = _epoch;
+
+  string &b = _line;
+  if(got != _shapes.end()) {
+    b = "<repeat shape=\"s" + to_string(got->second) + "\" epoch=\"" + to_string(_epoch) + "\" />\n";
+    _xml.text(b);
+  }
+  else {
+    uint64_t shape = _shapes.size();
+    _shapes[dig] = shape;
+
+    b = "<shape id=\"s" + to_string(shape) + "\" epoch=\"" + to_string(_epoch) + "\"";
+    if(!fixed.empty()) {
+      b += " fixed=\"";
+      for(size_t f=0; f < fixed.size(); f++)
+        b += (f ? "," : "") + to_string(fixed[f]);
+      b += '"';
+    }
+    b += ">\n";
+    _xml.text(b);
+    for(const TemplateEvent &e: _events) {
+      const uint64_t *deps = _deps.data() + e.dep_at;
+      switch(e.kind) {
+      case TemplateEvent::comp:
+        _xml.comp(e.id, deps, e.dep_n, e.rank, e.seconds, e.epoch, e.noted ? &e.note : nullptr);
+        break;
+      case TemplateEvent::comm:
+        _xml.comm(e.id, deps, e.dep_n, e.rank, e.to, e.bytes, e.epoch);
+        break;
+      case TemplateEvent::coll:
+        _xml.coll(e.id, deps, e.dep_n, _team_ranks.data() + e.team_at, e.team_n, e.bytes, e.epoch);
+        break;
+      }
+    }
+    _xml.text("</shape>\n");
+  }
+
+  advance(_next_n, _events.data(), _events.size());
+  _events.clear();
+  _deps.clear();
+  _team_ranks.clear();
+}
+
+void TemplateEventWriter::finish() {
+  _end_segment();
+  _xml.finish();
+}
+
+uint64_t TemplateEventWriter::offset() {
+  return _xml.offset();
+}
+
+void TemplateEventWriter::checkpoint_save(std::ostream &o) {
+  DEV_ASSERT(_events.empty());
+  o << "templates " << _epoch << ' ' << _next_n[0] << ' ' << _next_n[1] << ' ' << _next_n[2]
+    << ' ' << _shapes.size() << ' ' << _lasts.size() << '\n';
+  for(const auto &s: _shapes)
+    o << s.first.w0 << ' ' << s.first.w1 << ' ' << s.second << '\n';
+  for(const auto &l: _lasts) {
+    o << l.first.w0 << ' ' << l.first.w1 << ' '
+      << l.second.next_n[0] << ' ' << l.second.next_n[1] << ' ' << l.second.next_n[2] << ' '
+      << l.second.epoch << ' ' << l.second.deps.size();
+    for(uint64_t dep: l.second.deps)
+      o << ' ' << dep;
+    o << '\n';
+  }
+  _xml.checkpoint_save(o);
+}
+
+void TemplateEventWriter::checkpoint_load(std::istream &i, uint64_t offset) {
+  string word;
+  size_t shape_n, last_n;
+  i >> word >> _epoch >> _next_n[0] >> _next_n[1] >> _next_n[2] >> shape_n >> last_n;
+  USER_ASSERT(i && word == "templates", "Bad checkpoint file: expected templates.");
+
+  _shapes.clear();
+  for(size_t s=0; s < shape_n; s++) {
+    Digest<128> dig;
+    uint64_t shape;
+    i >> dig.w0 >> dig.w1 >> shape;
+    _shapes[dig] = shape;
+  }
+  _lasts.clear();
+  for(size_t s=0; s < last_n; s++) {
+    Digest<128> skel;
+    size_t dep_n;
+    i >> skel.w0 >> skel.w1;
+    Last &last = _lasts[skel];
+    i >> last.next_n[0] >> last.next_n[1] >> last.next_n[2] >> last.epoch >> dep_n;
+    last.deps.resize(dep_n);
+    for(uint64_t &dep: last.deps)
+      i >> dep;
+  }
+  USER_ASSERT(i, "Bad checkpoint file: templates.");
+
+  _events.clear();
+  _deps.clear();
+  _team_ranks.clear();
+  _xml.checkpoint_load(i, offset);
+}
+
+////////////////////////////////////////////////////////////////////////
+// read_templated_events
+
+namespace {
+  struct Shape {
+    uint64_t epoch;
+    // ids as rel_id()s, deps as dep_code()s, epochs less the shape's epoch
+    vector<TemplateEvent> events;
+    vector<uint64_t> deps;
+    vector<int> team_ranks;
+  };
+
+  // the value of attribute `name` in `line`, false if it has none
+  bool attr(const string &line, const char *name, const char *&lo, const char *&hi) {
+    string key = string(" ") + name + "=\"";
+    size_t at = line.find(key);
+    if(at == string::npos)
+      return false;
+    lo = line.data() + at + key.size();
+    hi = static_cast<const char*>(memchr(lo, '"', line.data() + line.size() - lo));
+    return hi != nullptr;
+  }
+
+  template<class T>
+  bool attr_num(const string &line, const char *name, char prefix, T &x) {
+    const char *lo, *hi;
+    if(!attr(line, name, lo, hi))
+      return false;
+    if(prefix && (lo == hi || *lo++ != prefix))
+      return false;
+    char *end;
+    x = T(std::strtoull(lo, &end, 10));
+    return lo != hi && end == hi;
+  }
+
+  bool attr_list(const string &line, const char *name, char prefix, vector<uint64_t> &xs) {
+    xs.clear();
+    const char *lo, *hi;
+    if(!attr(line, name, lo, hi))
+      return false;
+    while(lo != hi) {
+      if(prefix && *lo++ != prefix)
+        return false;
+      char *end;
+      xs.push_back(std::strtoull(lo, &end, 10));
+      if(end == lo || end > hi)
+        return false;
+      lo = end;
+      if(lo != hi && *lo++ != ',')
+        return false;
+    }
+    return true;
+  }
+}
+
+bool programr::is_templated_xml(const char *text, size_t n) {
+  const char *nl = static_cast<const char*>(memchr(text, '\n', n));
+  return nl && size_t(text + n - nl) > 7 && !memcmp(nl + 1, "<shape ", 7);
+}
+
+bool programr::read_templated_events(std::istream &in, EventWriter &to, string &err) {
+  vector<Shape> shapes;
+  Shape *open = nullptr; // shape being defined
+  uint64_t next_n[3] = {0, 0, 0}, open_next_n[3];
+  vector<uint64_t> fixed; // of the open shape
+  vector<vector<int>> team_refs;
+
+  string line;
+  vector<uint64_t> deps, list;
+  vector<int> team;
+  uint64_t line_n = 0;
+
+  auto bad = [&]()->bool {
+    err = "line " + to_string(line_n) + ": bad line: " + line;
+    return false;
+  };
+
+  while(std::getline(in, line)) {
+    line_n += 1;
+
+    if(line.compare(0, 7, "<shape ") == 0) {
+      uint64_t id, epoch;
+      if(open || !attr_num(line, "id", 's', id) || id != shapes.size() || !attr_num(line, "epoch", 0, epoch))
+        return bad();
+      shapes.push_back(Shape());
+      open = &shapes.back();
+      open->epoch = epoch;
+      std::copy(next_n, next_n + 3, open_next_n);
+      fixed.clear();
+      if(line.find(" fixed=\"") != string::npos && !attr_list(line, "fixed", 0, fixed))
+        return bad();
+    }
+    else if(line == "</shape>") {
+      if(!open)
+        return bad();
+      open = nullptr;
+    }
+    else if(line.compare(0, 8, "<repeat ") == 0) {
+      uint64_t id, epoch;
+      if(open || !attr_num(line, "shape", 's', id) || id >= shapes.size() || !attr_num(line, "epoch", 0, epoch))
+        return bad();
+
+      const Shape &s = shapes[id];
+      uint64_t start_n[3] = {next_n[0], next_n[1], next_n[2]};
+      for(const TemplateEvent &e: s.events) {
+        uint64_t ev_id = abs_id(e.id, start_n);
+        deps.resize(e.dep_n);
+        for(size_t d=0; d < e.dep_n; d++)
+          deps[d] = dep_decode(s.deps[e.dep_at + d], start_n);
+        uint64_t ev_epoch = epoch + e.epoch;
+
+        switch(e.kind) {
+        case TemplateEvent::comp:
+          to.comp(ev_id, deps.data(), deps.size(), e.rank, e.seconds, ev_epoch, e.noted ? &e.note : nullptr);
+          break;
+        case TemplateEvent::comm:
+          to.comm(ev_id, deps.data(), deps.size(), e.rank, e.to, e.bytes, ev_epoch);
+          break;
+        case TemplateEvent::coll:
+          to.coll(ev_id, deps.data(), deps.size(), s.team_ranks.data() + e.team_at, e.team_n, e.bytes, ev_epoch);
+          break;
+        }
+        uint64_t lane = ev_id % 3;
+        next_n[lane] = std::max(next_n[lane], ev_id/3 + 1);
+      }
+    }
+    else if(line.compare(0, 6, "<team ") == 0) {
+      uint64_t id;
+      if(!attr_num(line, "id", 't', id) || id != team_refs.size() || !attr_list(line, "ranks", 0, list))
+        return bad();
+      team_refs.emplace_back(list.begin(), list.end());
+    }
+    else if(line.compare(0, 6, "<comp ") == 0 || line.compare(0, 6, "<comm ") == 0 || line.compare(0, 6, "<coll ") == 0) {
+      TemplateEvent e = TemplateEvent();
+      e.kind = line[4] == 'p' ? TemplateEvent::comp : line[4] == 'm' ? TemplateEvent::comm : TemplateEvent::coll;
+      e.rank = -1;
+      e.to = -1;
+      if(!attr_num(line, "id", 'e', e.id) || !attr_list(line, "dep", 'e', deps) || !attr_num(line, "epoch", 0, e.epoch))
+        return bad();
+
+      const char *lo, *hi;
+      switch(e.kind) {
+      case TemplateEvent::comp:
+        if(!attr_num(line, "at", 0, e.rank) || !attr(line, "time", lo, hi))
+          return bad();
+        e.seconds = std::strtod(lo, nullptr);
+        if(attr(line, "note", lo, hi)) {
+          // "<op name> lev=<lev> box=<box>", the name may hold spaces
+          string note(lo, hi);
+          size_t at = note.rfind(" lev=");
+          size_t box = note.rfind(" box=");
+          if(at == string::npos || box == string::npos || box < at)
+            return bad();
+          e.noted = true;
+          e.note.op = TaskNote::intern(note.substr(0, at));
+          e.note.lev = std::atoi(note.c_str() + at + 5);
+          e.note.box = std::atoi(note.c_str() + box + 5);
+        }
+        to.comp(e.id, deps.data(), deps.size(), e.rank, e.seconds, e.epoch, e.noted ? &e.note : nullptr);
+        break;
+      case TemplateEvent::comm:
+        if(!attr_num(line, "from", 0, e.rank) || !attr_num(line, "to", 0, e.to) || !attr_num(line, "size", 0, e.bytes))
+          return bad();
+        to.comm(e.id, deps.data(), deps.size(), e.rank, e.to, e.bytes, e.epoch);
+        break;
+      case TemplateEvent::coll:
+        if(!attr(line, "team", lo, hi) || !attr_num(line, "size", 0, e.bytes))
+          return bad();
+        if(lo != hi && *lo == 't') {
+          uint64_t ref;
+          if(!attr_num(line, "team", 't', ref) || ref >= team_refs.size())
+            return bad();
+          team = team_refs[ref];
+        }
+        else {
+          if(!attr_list(line, "team", 0, list))
+            return bad();
+          team.assign(list.begin(), list.end());
+        }
+        e.team_n = team.size();
+        to.coll(e.id, deps.data(), deps.size(), team.data(), team.size(), e.bytes, e.epoch);
+        break;
+      }
+
+      next_n[e.id % 3] = std::max(next_n[e.id % 3], e.id/3 + 1);
+      if(open) {
+        // keep it relative to where the shape began
+        e.id = rel_id(e.id, open_next_n);
+        e.epoch -= open->epoch;
+        e.dep_at = open->deps.size();
+        e.dep_n = deps.size();
+        for(uint64_t dep: deps) {
+          bool is_fixed = std::binary_search(fixed.begin(), fixed.end(), open->deps.size());
+          open->deps.push_back(dep_code(dep, is_fixed, open_next_n));
+        }
+        e.team_at = open->team_ranks.size();
+        open->team_ranks.insert(open->team_ranks.end(), team.begin(), team.begin() + e.team_n);
+        open->events.push_back(e);
+      }
+    }
+  }
+
+  if(open) {
+    err = "unterminated shape";
+    return false;
+  }
+  to.finish();
+  return true;
+}
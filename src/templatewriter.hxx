@@ -0,0 +1,131 @@
+#ifndef _b3f7e81b_abcf_4554_bd53_ccc5ab76b1d0
+#define _b3f7e81b_abcf_4554_bd53_ccc5ab76b1d0
+
+# include "eventwriter.hxx"
+# include "lowlevel/digest.hxx"
+
+# include <cstdint>
+# include <iostream>
+# include <string>
+# include <unordered_map>
+# include <vector>
+
+/* Templated xml traces (templates=1). Iterative solvers emit the same
+ * events every iteration but for their ids, so the events between two
+ * epoch_begin() calls, a segment, are written once as a shape and every
+ * later segment with the same shape as one line:
+ *
+ *   <shape id="s<n>" epoch="<e>" [fixed="<i>,.."]>
+ *   ...the segment's events, as in events.xml...
+ *   </shape>
+ *   <repeat shape="s<n>" epoch="<e>" />
+ *
+ * where <e> is the compute epoch the segment began at. A shape is its
+ * events with each id and dep n*3+lane taken relative to the lane's next
+ * id, one past the largest n of the lane written so far, and each epoch
+ * relative to <e>; everything else (ranks, sizes, seconds, notes, teams)
+ * has to match exactly. Deps that stayed put while the ids moved, since
+ * the last segment that matched in all else, say the inputs a loop
+ * reads every iteration, are fixed instead: the shape line lists them,
+ * fixed="<i>,..", by their position in the segment's deps, and they are
+ * taken as they are. Shapes are known by their Digest<128>, like
+ * messages are, so the writer keeps just digests, plus the deps of the
+ * last segment of each skeleton seen in the last `keep_epochs` compute
+ * epochs. A skeleton that comes back after longer than that can't fix
+ * deps against its earlier segments, so it may be written as a new
+ * shape, but traces that never repeat don't hold every segment's deps.
+ *
+ * read_templated_events() expands a templated trace back into the calls
+ * that produced it, so writing those through an XmlEventWriter gives the
+ * untemplated trace byte for byte.
+ */
+namespace programr {
+  // One event as TemplateEventWriter buffers it and the reader keeps
+  // shapes, deps and team ranks live in arrays next to it.
+  struct TemplateEvent {
+    enum Kind: std::uint8_t { comp, comm, coll };
+    Kind kind;
+    bool noted;
+    std::uint64_t id;
+    std::size_t dep_at, dep_n;
+    int rank, to; // comp: at, comm: from and to
+    std::size_t team_at, team_n;
+    std::uint64_t bytes;
+    double seconds;
+    std::uint64_t epoch;
+    TaskNote note;
+  };
+
+  class TemplateEventWriter: public EventWriter {
+    XmlEventWriter _xml;
+
+    // the open segment
+    std::uint64_t _epoch = 0;
+    std::vector<TemplateEvent> _events;
+    std::vector<std::uint64_t> _deps;
+    std::vector<int> _team_ranks;
+
+    std::uint64_t _next_n[3] = {0, 0, 0};
+    std::unordered_map<Digest<128>, std::uint64_t> _shapes; // -> shape number
+    // the last segment with each skeleton, a shape less its deps, seen
+    // within the last _keep_epochs or so
+    struct Last {
+      std::vector<std::uint64_t> deps;
+      std::uint64_t next_n[3];
+      std::uint64_t epoch;
+    };
+    std::unordered_map<Digest<128>, Last> _lasts;
+    std::uint64_t _keep_epochs;
+    std::vector<std::uint64_t> _fixed;
+    std::string _line;
+
+  public:
+    TemplateEventWriter(std::ostream *file, bool team_refs=false, std::uint64_t keep_epochs=64);
+
+    void comm(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      int from, int to,
+      std::size_t bytes,
+      std::uint64_t epoch
+    );
+    void comp(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      int at,
+      double seconds,
+      std::uint64_t epoch,
+      const TaskNote *note
+    );
+    void coll(
+      std::uint64_t id,
+      const std::uint64_t *deps, std::size_t dep_n,
+      const int *team, std::size_t team_n,
+      std::size_t bytes,
+      std::uint64_t epoch
+    );
+    void epoch_begin(std::uint64_t comp_epoch);
+    void finish();
+
+    // checkpoints are taken between segments
+    std::uint64_t offset();
+    void checkpoint_save(std::ostream &o);
+    void checkpoint_load(std::istream &i, std::uint64_t offset);
+
+    std::size_t shape_n() const { return _shapes.size(); }
+    // skeletons whose last deps are kept
+    std::size_t last_n() const { return _lasts.size(); }
+
+  private:
+    TemplateEvent& _add(TemplateEvent::Kind kind, std::uint64_t id, const std::uint64_t *deps, std::size_t dep_n, std::uint64_t epoch);
+    void _end_segment();
+  };
+
+  // Expands a templated xml trace into calls on `to`, ending with
+  // to.finish(). False with a message in `err` if the trace is malformed.
+  bool read_templated_events(std::istream &in, EventWriter &to, std::string &err);
+
+  // whether xml text starts like a templated trace
+  bool is_templated_xml(const char *text, std::size_t n);
+}
+#endif
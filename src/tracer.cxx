@@ -1,9 +1,14 @@
 #include "tracer.hxx"
 #include "diagnostic.hxx"
+#include "lowlevel/alloccount.hxx"
+#include "lowlevel/region.hxx"
 
 #include <algorithm>
+#include <cstdio>
+#include <fstream>
 #include <functional>
 #include <iostream>
+#include <unordered_map>
 #include <vector>
 
 using namespace programr;
@@ -62,26 +67,32 @@ namespace {
     }
   }
   
-  struct ExecCxt: Expr::ExecCxt {
-    static uint64_t task_id_counter;
-    static uint64_t rdxn_id_counter;
-
-    Tracer *tracer;
-    vector<uint64_t> *rdxn_ids;
-    bool computed = false;
-    bool reduced = false;
+  // reused across tasks so merging deps doesnt allocate
+  struct BatchScratch {
+    vector<Tracer::TaskDepTask> deps;
+    vector<size_t> dep_off;
+    vector<int> slots; // open addressing table for merge_deps
+  };
+  
+  // build task-to-task dependencies by merging deps with same src_task,
+  // appending them to `dep_tasks` in order of first appearance
+  void merge_deps(
+      const Dependency *deps, size_t dep_n,
+      vector<Tracer::TaskDepTask> &dep_tasks,
+      vector<int> &slots
+    ) {
+    size_t j0 = dep_tasks.size();
     
-    uint64_t task(int rank, uint64_t data_id, const vector<Dependency> &deps, std::string note, double seconds) {
-      computed = true;
-      
-      vector<Tracer::TaskDepTask> dep_tasks;
-      
-      // build task-to-task dependencies by merging deps with same src_task
-      for(int i=0; i < (int)deps.size(); i++) {
-        for(int j=0; j < (int)dep_tasks.size(); j++) {
+    auto merge = [&](size_t j, const Dependency &dep) {
+      dep_tasks[j].bytes += dep.size;
+      dep_tasks[j].digest ^= dep.digest;
+    };
+    
+    if(dep_n <= 16) { // small lists are quicker to scan
+      for(size_t i=0; i < dep_n; i++) {
+        for(size_t j=j0; j < dep_tasks.size(); j++) {
           if(deps[i].src_task == dep_tasks[j].task) {
-            dep_tasks[j].bytes += deps[i].size;
-            dep_tasks[j].digest ^= deps[i].digest;
+            merge(j, deps[i]);
             goto merged;
           }
         }
@@ -89,44 +100,283 @@ namespace {
         dep_tasks.push_back({deps[i].src_task, deps[i].size, deps[i].digest});
       merged:;
       }
+    }
+    else {
+      // hash src_task into a table of indices into dep_tasks
+      size_t mask = 31;
+      while(mask < 2*dep_n)
+        mask = 2*mask + 1;
+      slots.assign(mask+1, -1);
+      
+      for(size_t i=0; i < dep_n; i++) {
+        uint64_t key = deps[i].src_task;
+        size_t h = (key * 0x9e3779b97f4a7c15u) >> 32;
+        
+        while(true) {
+          int &slot = slots[h & mask];
+          if(slot == -1) {
+            slot = int(dep_tasks.size() - j0);
+            dep_tasks.push_back({key, deps[i].size, deps[i].digest});
+            break;
+          }
+          if(dep_tasks[j0 + slot].task == key) {
+            merge(j0 + slot, deps[i]);
+            break;
+          }
+          h += 1;
+        }
+      }
+    }
+  }
+  
+  // Counts for Expr::rdxn_holds. Exprs keep this alive, so it may outlive
+  // the run that made it, at which point `tracer` is nulled.
+  struct RdxnCounts: RdxnHolds {
+    Tracer *tracer;
+    unordered_map<uint64_t, int> counts;
+    
+    RdxnCounts(Tracer *tracer): tracer(tracer) {}
+    
+    void hold(uint64_t rdxn_id) {
+      counts[rdxn_id] += 1;
+    }
+    void drop(uint64_t rdxn_id) {
+      auto got = counts.find(rdxn_id);
+      DEV_ASSERT(got != counts.end());
+      if(0 == --got->second) {
+        counts.erase(got);
+        if(tracer && !tracer->replaying())
+          tracer->retire_rdxn(rdxn_id);
+      }
+    }
+  };
+  
+  // Edits of Expr::dep_rdxn_ids, keeping rdxn_holds up to date. Ids are
+  // always held by their new owner before the old one drops them.
+  void rdxns_add(Expr *x, uint64_t rdxn_id) {
+    x->dep_rdxn_ids.push_back(rdxn_id);
+    if(x->rdxn_holds)
+      x->rdxn_holds->hold(rdxn_id);
+  }
+  
+  void rdxns_add(Expr *x, const vector<uint64_t> &rdxn_ids) {
+    x->dep_rdxn_ids.insert(x->dep_rdxn_ids.end(), rdxn_ids.begin(), rdxn_ids.end());
+    if(x->rdxn_holds) {
+      for(uint64_t rdxn_id: rdxn_ids)
+        x->rdxn_holds->hold(rdxn_id);
+    }
+  }
+  
+  void rdxns_clear(Expr *x) {
+    if(x->rdxn_holds) {
+      for(uint64_t rdxn_id: x->dep_rdxn_ids)
+        x->rdxn_holds->drop(rdxn_id);
+    }
+    x->dep_rdxn_ids.clear();
+  }
+  
+  // sort and remove duplicates
+  void rdxns_uniquify(Expr *x) {
+    vector<uint64_t> &v = x->dep_rdxn_ids;
+    std::sort(v.begin(), v.end());
+    
+    size_t n = 0;
+    for(size_t i=0; i < v.size(); i++) {
+      if(n == 0 || v[i] != v[n-1])
+        v[n++] = v[i];
+      else if(x->rdxn_holds)
+        x->rdxn_holds->drop(v[i]);
+    }
+    v.resize(n);
+  }
+  
+  struct ExecCxt: Expr::ExecCxt {
+    Tracer *tracer;
+    Workers *pool;
+    BatchScratch *scratch;
+    Expr *expr; // the expr executing
+    bool computed = false;
+    bool reduced = false;
+    std::uint64_t sink_allocs = 0; // allocations made inside the tracer's task hooks
+    
+    uint64_t task(int rank, uint64_t data_id, const vector<Dependency> &deps, TaskNote note, double seconds) {
+      computed = true;
       
-      uint64_t task_id = task_id_counter++;
-      tracer->task(task_id, rank, data_id, dep_tasks, *rdxn_ids, std::move(note), seconds);
+      vector<Tracer::TaskDepTask> &dep_tasks = scratch->deps;
+      dep_tasks.clear();
+      merge_deps(deps.data(), deps.size(), dep_tasks, scratch->slots);
+      
+      uint64_t task_id = tracer->task_id_next++;
+      if(tracer->replaying())
+        return task_id;
+      
+      uint64_t allocs0 = alloc_count();
+      tracer->task(task_id, rank, data_id, dep_tasks, expr->dep_rdxn_ids, note, seconds);
+      sink_allocs += alloc_count() - allocs0;
       
       return task_id;
     }
     
+    uint64_t tasks(const TaskBatch &batch) {
+      size_t n = batch.size();
+      uint64_t task_id0 = tracer->task_id_next;
+      
+      if(n == 0)
+        return task_id0;
+      
+      computed = true;
+      
+      if(tracer->replaying()) {
+        tracer->task_id_next += n;
+        return task_id0;
+      }
+      
+      vector<Tracer::TaskDepTask> &deps = scratch->deps;
+      vector<size_t> &dep_off = scratch->dep_off;
+      deps.clear();
+      dep_off.clear();
+      dep_off.push_back(0);
+      
+      for(size_t i=0; i < n; i++) {
+        size_t off = batch.dep_off[i], off1 = batch.dep_off[i+1];
+        merge_deps(batch.deps.data() + off, off1 - off, deps, scratch->slots);
+        dep_off.push_back(deps.size());
+      }
+      
+      tracer->task_id_next += n;
+      uint64_t allocs0 = alloc_count();
+      tracer->task_batch(
+        Tracer::Tasks{
+          task_id0, batch.data_id, n,
+          batch.ranks.data(), batch.seconds.data(), batch.notes.data(),
+          dep_off.data(), deps.data()
+        },
+        expr->dep_rdxn_ids
+      );
+      sink_allocs += alloc_count() - allocs0;
+      
+      return task_id0;
+    }
+    
     void reduction(size_t bytes, const vector<uint64_t> &dep_tasks) {
       reduced = true;
 
-      uint64_t rdxn_id = rdxn_id_counter++;
-      tracer->reduction(rdxn_id, bytes, dep_tasks, *rdxn_ids);
-      rdxn_ids->clear();
-      rdxn_ids->push_back(rdxn_id);
+      uint64_t rdxn_id = tracer->rdxn_id_next++;
+      if(!tracer->replaying())
+        tracer->reduction(rdxn_id, bytes, dep_tasks, expr->dep_rdxn_ids);
+      rdxns_clear(expr);
+      rdxns_add(expr, rdxn_id);
+    }
+    
+    Workers& workers() {
+      return *pool;
     }
   };
-  
-  uint64_t ExecCxt::task_id_counter = 0;
-  uint64_t ExecCxt::rdxn_id_counter = 0;
 }
 
 namespace {
-  template<class T>
-  void uniquify(vector<T> &v) {
-    std::sort(v.begin(), v.end());
-    auto last = std::unique(v.begin(), v.end());
-    v.erase(last, v.end());
+  // `x` has just been continued. Exprs that were themselves continued by
+  // `x` are moved to wait on x's continuer instead, and likewise on up the
+  // chain of continuers, so that once the last continuer executes its
+  // result reaches them without bouncing through every link of the chain
+  // in the ready queue. They take along the reduction ids the skipped link
+  // holds, which they would otherwise have inherited from it. Returns the
+  // number of hops removed.
+  uint64_t eliminate_chains(Expr *x) {
+    uint64_t hop_n = 0;
+    
+    Ref<Expr> y1 = x;
+    Ref<Expr> y0 = x->continuer;
+    
+    while(y0) {
+      Expr::Succs **pp = &y1->succs;
+      while(*pp) {
+        Expr::Succs *p = *pp;
+        
+        if(p->head.is_dead()) {
+          *pp = p->tail; // remove from y1->succs
+          Expr::succ_free(p);
+        }
+        else {
+          Expr *y2 = p->head;
+          
+          if(y2->state == Expr::continued && (Expr*)y2->continuer == (Expr*)y1) {
+            // move p from y1->succs to y0->succs
+            *pp = p->tail;
+            p->tail = y0->succs;
+            y0->succs = p;
+            
+            rdxns_add(y2, y1->dep_rdxn_ids);
+            rdxns_uniquify(y2);
+            
+            // y2 points over y1 to y0 (may leave y1 held only by us)
+            y2->continuer = y0;
+            hop_n += 1;
+          }
+          else
+            pp = &p->tail;
+        }
+      }
+      
+      y1 = y0;
+      y0 = y1->continuer;
+    }
+    
+    return hop_n;
+  }
+}
+
+void Tracer::task_batch(const Tasks &tasks, const vector<uint64_t> &dep_rdxns) {
+  vector<TaskDepTask> dep_tasks;
+  
+  for(size_t i=0; i < tasks.n; i++) {
+    dep_tasks.assign(tasks.deps + tasks.dep_off[i], tasks.deps + tasks.dep_off[i+1]);
+    this->task(
+      tasks.task_id0 + i, tasks.ranks[i], tasks.data_id,
+      dep_tasks, dep_rdxns, tasks.notes[i], tasks.seconds[i]
+    );
   }
 }
 
 void Tracer::run(Ref<Expr> root) {
   LinkedList<Expr> ready(&Expr::links);
+  Workers workers(thread_n);
+  BatchScratch batch_scratch;
+  
+  uint64_t task_id0 = task_id_next;
+  uint64_t allocs0 = alloc_count();
+  uint64_t sink_allocs = 0;
+  
+#if KNOB_REGION
+  // what executing exprs allocate (results, continuations, task maps, ...)
+  // comes from a region, and a fresh region is started every
+  // `region_exprs` executions. old regions are freed once all their
+  // objects have been retired.
+  const int region_exprs = env<int>("region_exprs", 4096);
+  Region *region = Region::open();
+  int region_age = 0;
+#endif
   
   function<void(Data*)> data_retirer = [this](Data *d) {
-    this->retire(d->id);
+    if(!this->_replaying)
+      this->retire(d->id);
   };
   
-  auto add_expr = [&](Expr *e, vector<uint64_t> &dep_rdxn_ids) {
+  Ref<RdxnCounts> rdxn_counts;
+  uint64_t epoch = 0;
+  if(flag_stream)
+    rdxn_counts = new RdxnCounts(this);
+  
+  uint64_t resume_epoch = 0;
+  if(flag_resume) {
+    resume_epoch = _checkpoint_epoch();
+    _replaying = true;
+    Say() << "replaying up to checkpointed epoch " << resume_epoch;
+  }
+  
+  // registers e and its fresh subexprs, which take over the unconsumed
+  // reduction dependencies of `from` (if any)
+  auto add_expr = [&](Expr *e, Expr *from) {
     bool has_fresh = false;
     
     traverse_depth_first<Expr*>(e,
@@ -135,6 +385,7 @@ void Tracer::run(Ref<Expr> root) {
         bool enter = x->state == Expr::fresh;
         if(enter) {
           x->state = Expr::registered;
+          x->rdxn_holds = rdxn_counts;
           has_fresh = true;
         }
         return enter;
@@ -160,9 +411,9 @@ void Tracer::run(Ref<Expr> root) {
         
         x->pred_n = pred_n;
         
-        if(fresh_pred_n == 0) {
+        if(fresh_pred_n == 0 && from) {
            // append
-          x->dep_rdxn_ids.insert(x->dep_rdxn_ids.end(), dep_rdxn_ids.begin(), dep_rdxn_ids.end());
+          rdxns_add(x, from->dep_rdxn_ids);
         }
         
         if(pred_n == 0)
@@ -172,20 +423,23 @@ void Tracer::run(Ref<Expr> root) {
       [&](Expr *x) {}
     );
     
-    if(has_fresh) // if any fresh exprs were found then we consumed the reduction dependencies
-      dep_rdxn_ids.clear();
+    if(has_fresh && from) // if any fresh exprs were found then we consumed the reduction dependencies
+      rdxns_clear(from);
   };
   
-  { // add root
-    vector<uint64_t> rdxn_ids;
-    add_expr(root, rdxn_ids);
-  }
+  // add root
+  add_expr(root, nullptr);
   
+  // TODO: drain `ready` on the workers too. Exprs must first stop sharing
+  // non-atomic Referent counts, ThePool free lists and Data::_id_next, and
+  // each needs its task and reduction ids reserved in ready queue order
+  // with its events held back until those before it are written, so the
+  // trace still matches threads=1.
   while(Expr *x = ready.pop_head()) {
     if(x->state == Expr::continued) {
       // inherit continuers rdxn ids
-      x->dep_rdxn_ids.insert(x->dep_rdxn_ids.end(), x->continuer->dep_rdxn_ids.begin(), x->continuer->dep_rdxn_ids.end());
-      uniquify(x->dep_rdxn_ids);
+      rdxns_add(x, x->continuer->dep_rdxn_ids);
+      rdxns_uniquify(x);
       
       // re-executing continuation just copies result forward
       x->state = Expr::executed;
@@ -204,21 +458,52 @@ void Tracer::run(Ref<Expr> root) {
         vector<Expr*> subs;
         x->subexs(subs);
         for(Expr *dep: subs)
-          x->dep_rdxn_ids.insert(x->dep_rdxn_ids.end(), dep->dep_rdxn_ids.begin(), dep->dep_rdxn_ids.end());
-        uniquify(x->dep_rdxn_ids);
+          rdxns_add(x, dep->dep_rdxn_ids);
+        rdxns_uniquify(x);
       }
       
       {
+#if KNOB_REGION
+        if(++region_age == region_exprs) {
+          region->close();
+          region = Region::open();
+          region_age = 0;
+        }
+        Region::Scope region_scope(region);
+#endif
         ExecCxt exec_cxt;
         exec_cxt.tracer = this;
-        exec_cxt.rdxn_ids = &x->dep_rdxn_ids;
+        exec_cxt.pool = &workers;
+        exec_cxt.scratch = &batch_scratch;
+        exec_cxt.expr = x;
         x->execute(exec_cxt);
+        sink_allocs += exec_cxt.sink_allocs;
         
         // if tasks were emitted clear out reduction deps
         if(exec_cxt.computed) {
-          x->dep_rdxn_ids.clear();
+          rdxns_clear(x);
           // hook for after a compute expression is emitted
-          post_compute_exec();
+          if(!_replaying)
+            post_compute_exec();
+          
+          epoch += 1;
+          
+          if(_replaying && epoch == resume_epoch)
+            _checkpoint_load(epoch);
+          else if(checkpoint_every > 0 && epoch % checkpoint_every == 0 && !_replaying)
+            _checkpoint_save(epoch);
+          
+          if(flag_stream && stream_report > 0 && epoch % stream_report == 0) {
+            Live lv = live();
+            Say() << "epoch " << epoch << " live:"
+                  << " exprs=" << Expr::live_n
+                  << " datas=" << Data::live_n
+                  << " tracer datas=" << lv.datas
+                  << " tasks=" << lv.tasks
+                  << " rdxns=" << lv.rdxns
+                  << " teams=" << lv.teams
+                  << " held rdxns=" << rdxn_counts->counts.size();
+          }
         }
       }
       
@@ -255,43 +540,11 @@ void Tracer::run(Ref<Expr> root) {
             x->pred_n = 1;
           }
         
-          if(false) { // eliminate chains of continuations
-            Ref<Expr> y1 = x;
-            Ref<Expr> y0 = x_continuer;
-            
-            do {
-              Expr::Succs **pp = &y1->succs;
-              while(*pp) {
-                RefWeak<Expr> &y2 = (*pp)->head;
-                Expr::Succs *p = *pp;
-                Expr::Succs *p_next = p->tail;
-                  
-                if(y2.is_dead()) {
-                  *pp = p_next; // remove from y1->succs
-                  Expr::succ_free(p);
-                }
-                else {
-                  if(y2->state == Expr::continued) {
-                    Expr::Succs *p = *pp;
-                    Expr::Succs *p_next = p->tail;
-                    // move p from y1->succs to y0->succs
-                    p->tail = y0->succs;
-                    y0->succs = p;
-                    *pp = p_next;
-                    // y2 points over y1 to y0 (may destroy y1)
-                    y2->continuer = y0;
-                  }
-                  else
-                    pp = &p->tail;
-                }
-              }
-              
-              y1 = std::move(y0);
-              y0 = y1->continuer;
-            } while(y0);
-          }
+          add_expr(x_continuer, x);
+          
+          if(flag_chain_elim)
+            chain_hops_removed += eliminate_chains(x);
           
-          add_expr(x_continuer, x->dep_rdxn_ids);
           continue; // skip notify x succs
         }
       }
@@ -313,14 +566,111 @@ void Tracer::run(Ref<Expr> root) {
       }
     }
   }
+  
+#if KNOB_REGION
+  region->close();
+#endif
+  
+  // exprs outliving the run still drop their holds, but tell no one
+  if(rdxn_counts)
+    rdxn_counts->tracer = nullptr;
+  
+  USER_ASSERT_F(!_replaying,
+    "Program finished after " << epoch << " epochs, before reaching checkpointed epoch " << resume_epoch << "."
+  );
+  
+  if(flag_chain_elim)
+    Say() << "continuation hops removed: " << chain_hops_removed;
+  
+  if(KNOB_ALLOC_COUNT && task_id_next != task_id0) {
+    double task_n = double(task_id_next - task_id0);
+    Say() << "allocations per task: "
+          << double(alloc_count() - allocs0)/task_n << " overall, "
+          << double(sink_allocs)/task_n << " in tracer";
+  }
+}
+
+
+/* A checkpoint file is text:
+ *   programr-checkpoint 3
+ *   epoch <compute epochs executed>
+ *   ids <task_id_next> <rdxn_id_next> <data id next>
+ * followed by whatever the tracer's checkpoint_save() wrote. The file
+ * is written beside its final name and renamed over it, so a crash
+ * while saving leaves the previous checkpoint intact.
+ */
+void Tracer::_checkpoint_save(uint64_t epoch) {
+  string tmp = checkpoint_file + ".tmp";
+  {
+    ofstream o(tmp);
+    USER_ASSERT_F(o, "Could not open checkpoint file: " << tmp);
+    
+    o << "programr-checkpoint 3\n"
+      << "epoch " << epoch << '\n'
+      << "ids " << task_id_next << ' ' << rdxn_id_next << ' ' << Data::_id_next << '\n';
+    checkpoint_save(o);
+    
+    o.flush();
+    USER_ASSERT_F(o, "Failed writing checkpoint file: " << tmp);
+  }
+  USER_ASSERT_F(0 == std::rename(tmp.c_str(), checkpoint_file.c_str()),
+    "Could not rename " << tmp << " to " << checkpoint_file
+  );
+}
+
+void Tracer::checkpoint_expect(istream &i, const char *word) {
+  string got;
+  i >> got;
+  USER_ASSERT_F(i && got == word, "Bad checkpoint file: expected '" << word << "', got '" << got << "'.");
 }
 
+uint64_t Tracer::_checkpoint_epoch() {
+  ifstream i(checkpoint_file);
+  USER_ASSERT_F(i, "Could not open checkpoint file: " << checkpoint_file);
+  
+  uint64_t epoch;
+  checkpoint_expect(i, "programr-checkpoint");
+  checkpoint_expect(i, "3");
+  checkpoint_expect(i, "epoch");
+  i >> epoch;
+  USER_ASSERT_F(i && epoch > 0, "Bad checkpoint file: " << checkpoint_file);
+  return epoch;
+}
+
+void Tracer::_checkpoint_load(uint64_t epoch) {
+  ifstream i(checkpoint_file);
+  USER_ASSERT_F(i, "Could not open checkpoint file: " << checkpoint_file);
+  
+  uint64_t epoch1, task_id1, rdxn_id1, data_id1;
+  checkpoint_expect(i, "programr-checkpoint");
+  checkpoint_expect(i, "3");
+  checkpoint_expect(i, "epoch");
+  i >> epoch1;
+  checkpoint_expect(i, "ids");
+  i >> task_id1 >> rdxn_id1 >> data_id1;
+  USER_ASSERT_F(i, "Bad checkpoint file: " << checkpoint_file);
+  
+  // the replay must have arrived where the checkpointed run was
+  USER_ASSERT_F(
+    epoch1 == epoch && task_id1 == task_id_next &&
+    rdxn_id1 == rdxn_id_next && data_id1 == Data::_id_next,
+    "Checkpoint " << checkpoint_file << " was not made by this program: "
+    "replay reached tasks=" << task_id_next << " reductions=" << rdxn_id_next <<
+    " datas=" << Data::_id_next << ", checkpoint has " <<
+    task_id1 << ' ' << rdxn_id1 << ' ' << data_id1 << '.'
+  );
+  
+  checkpoint_load(i);
+  _replaying = false;
+  
+  Say() << "resumed at epoch " << epoch;
+}
     
 void TracerStdout::task(
     uint64_t id, int rank, uint64_t data,
     const vector<TaskDepTask> &dep_tasks,
     const vector<uint64_t> &dep_rdxns,
-    std::string note,
+    TaskNote note,
     double seconds
   ) {
   if(false) {
@@ -338,6 +688,24 @@ void TracerStdout::task(
   }
 }
 
+void TracerStdout::task_batch(const Tasks &tasks, const vector<uint64_t> &dep_rdxns) {
+  if(false) {
+    for(size_t i=0; i < tasks.n; i++) {
+      cout << "task id="<<tasks.task_id0+i<<" rank="<<tasks.ranks[i]<<" data="<<tasks.data_id<<'\n';
+      
+      for(size_t d=tasks.dep_off[i]; d < tasks.dep_off[i+1]; d++) {
+        cout << "  dep_task "
+          "id="<<tasks.deps[d].task<<" "
+          "bytes="<<tasks.deps[d].bytes<<" "
+          "digest="<<tasks.deps[d].digest<<"\n";
+      }
+      
+      for(auto rdxn: dep_rdxns)
+        cout << "  dep_rdxn id="<<rdxn<<'\n';
+    }
+  }
+}
+
 void TracerStdout::reduction(uint64_t id, std::size_t bytes, const vector<uint64_t> &dep_tasks, const vector<uint64_t> &dep_rdxns) {
   if(false) {
     cout << "rdxn id="<<id<<" bytes="<<bytes<<'\n';
@@ -2,9 +2,11 @@
 #define _8561d566_4895_49da_ad03_896fe2461c26
 
 # include "expr.hxx"
+# include "env.hxx"
 
 # include <cstdint>
 # include <functional>
+# include <iostream>
 # include <string>
 
 namespace programr {
@@ -21,10 +23,31 @@ namespace programr {
       std::uint64_t data_id,
       const std::vector<TaskDepTask> &dep_tasks,
       const std::vector<std::uint64_t> &dep_rdxns,
-      std::string note,
+      TaskNote note,
       double seconds
     ) = 0;
     
+    // Consecutive tasks task_id0, task_id0+1, ... all producing data
+    // `data_id`. Task i's dependencies are deps[dep_off[i]] up to
+    // deps[dep_off[i+1]], already merged by source task.
+    struct Tasks {
+      std::uint64_t task_id0;
+      std::uint64_t data_id;
+      std::size_t n;
+      const int *ranks;
+      const double *seconds;
+      const TaskNote *notes;
+      const std::size_t *dep_off;
+      const TaskDepTask *deps;
+    };
+    
+    // all of tasks share the same reduction dependencies. the default
+    // just calls task() on each.
+    virtual void task_batch(
+      const Tasks &tasks,
+      const std::vector<std::uint64_t> &dep_rdxns
+    );
+    
     virtual void reduction(
       std::uint64_t rdxn_id,
       std::size_t bytes,
@@ -33,10 +56,67 @@ namespace programr {
     ) = 0;
     
     virtual void retire(std::uint64_t data_id) = 0;
+    
+    // in streaming mode, called once no live expr holds `rdxn_id` so no
+    // task emitted from here on can depend on it
+    virtual void retire_rdxn(std::uint64_t rdxn_id) {}
 
     virtual void post_compute_exec() {};
     
+    // sizes of the tracer's own bookkeeping, reported in streaming mode
+    struct Live {
+      std::size_t datas = 0, tasks = 0, rdxns = 0, teams = 0;
+    };
+    virtual Live live() const { return Live{}; }
+    
+    // the tracer's own state at a checkpoint, see `checkpoint_every`.
+    // load() is handed exactly what save() wrote.
+    virtual void checkpoint_save(std::ostream &o) {}
+    virtual void checkpoint_load(std::istream &i) {}
+    // reads the next word of a checkpoint, asserting it is `word`
+    static void checkpoint_expect(std::istream &i, const char *word);
+    
+    // ids handed out by run(), kept per tracer so that repeated or
+    // concurrent runs in one process each produce the same numbering
+    std::uint64_t task_id_next = 0;
+    std::uint64_t rdxn_id_next = 0;
+    
+    // size of the thread pool run() makes available to executing exprs
+    // for loops inside their execute(), eg the slab ops' per-box task maps
+    int thread_n = env<int>("threads", 1);
+    
+    // have exprs waiting on a chain of continuations wait on the last one
+    // directly, counting how many hops that saved
+    bool flag_chain_elim = env<bool>("chain_elim", false);
+    std::uint64_t chain_hops_removed = 0;
+    
+    // streaming mode: track which reduction ids are still held so the
+    // tracer can drop their metadata, and every `stream_report` compute
+    // epochs report how many exprs, datas, tasks and reductions are live
+    bool flag_stream = env<bool>("stream", false);
+    int stream_report = env<int>("stream_report", 100);
+    
+    // every `checkpoint_every` compute epochs (0 for never) the id
+    // counters and the tracer's state are written to `checkpoint_file`.
+    // with `flag_resume`, run() replays the program without telling the
+    // tracer anything until it reaches the checkpointed epoch, restores
+    // the tracer there and carries on.
+    int checkpoint_every = env<int>("checkpoint_every", 0);
+    std::string checkpoint_file = env<std::string>("checkpoint_file", "trace.ckpt");
+    bool flag_resume = env<bool>("resume", false);
+    
     void run(Ref<Expr> root);
+    
+    // true while run() replays up to a checkpoint
+    bool replaying() const { return _replaying; }
+    
+  private:
+    bool _replaying = false;
+    
+    void _checkpoint_save(std::uint64_t epoch);
+    // returns the checkpointed epoch
+    std::uint64_t _checkpoint_epoch();
+    void _checkpoint_load(std::uint64_t epoch);
   };
   
   struct TracerStdout: Tracer {
@@ -46,10 +126,15 @@ namespace programr {
       std::uint64_t data_id,
       const std::vector<TaskDepTask> &dep_tasks,
       const std::vector<std::uint64_t> &dep_rdxns,
-      std::string note,
+      TaskNote note,
       double seconds
     );
     
+    void task_batch(
+      const Tasks &tasks,
+      const std::vector<std::uint64_t> &dep_rdxns
+    );
+    
     void reduction(
       std::uint64_t rdxn_id,
       std::size_t bytes,
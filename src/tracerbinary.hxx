@@ -0,0 +1,16 @@
+#ifndef _ab38a25f_db9d_4ff7_b1f6_0f2dd75487f6
+#define _ab38a25f_db9d_4ff7_b1f6_0f2dd75487f6
+
+# include "tracerxml.hxx"
+
+namespace programr {
+  // Generates the same events as TracerXml but writes them in the
+  // compact format of BinaryEventWriter. tools/bin2xml converts the
+  // result back to events.xml.
+  struct TracerBinary: TracerXml {
+    TracerBinary(int rank_n, std::ostream *file):
+      TracerXml(rank_n, new BinaryEventWriter(file, rank_n)) {
+    }
+  };
+}
+#endif
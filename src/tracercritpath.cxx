@@ -0,0 +1,247 @@
+#include "tracercritpath.hxx"
+#include "diagnostic.hxx"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+
+using namespace programr;
+using namespace std;
+
+TracerCritPath::TracerCritPath(const SimParams &p, std::ostream *report):
+  _p(p),
+  _report(report) {
+}
+
+TracerCritPath::~TracerCritPath() {
+  if(!_finished)
+    finish();
+}
+
+shared_ptr<const TracerCritPath::Path> TracerCritPath::_extend(
+    const shared_ptr<const Path> &from, TaskNote note,
+    double compute, double message, double allreduce
+  ) {
+  if(compute == 0 && message == 0 && allreduce == 0)
+    return from;
+
+  Path *path = from ? new Path(*from) : new Path;
+  auto at = std::lower_bound(path->begin(), path->end(), note,
+    [](const Part &a, const TaskNote &b) {
+      return a.op != b.op ? a.op < b.op : a.lev < b.lev;
+    }
+  );
+  if(at == path->end() || at->op != note.op || at->lev != note.lev)
+    at = path->insert(at, Part{note.op, note.lev, 0, 0, 0});
+  at->compute += compute;
+  at->message += message;
+  at->allreduce += allreduce;
+  return shared_ptr<const Path>(path);
+}
+
+void TracerCritPath::_reached(double done, const shared_ptr<const Path> &path) {
+  if(done > _length) {
+    _length = done;
+    _critical = path;
+  }
+}
+
+void TracerCritPath::task(
+    std::uint64_t task_id,
+    int rank,
+    std::uint64_t data_id,
+    const std::vector<TaskDepTask> &dep_tasks,
+    const std::vector<std::uint64_t> &dep_rdxns,
+    TaskNote note,
+    double seconds
+  ) {
+  double start = 0, start_msg = 0;
+  const shared_ptr<const Path> *via = nullptr;
+
+  for(const TaskDepTask &dep: dep_tasks) {
+    const Task &d = _tasks[dep.task];
+    double msg = d.rank == rank ? 0 : _msg(dep.bytes);
+    if(d.done + msg > start) {
+      start = d.done + msg;
+      start_msg = msg;
+      via = &d.path;
+    }
+  }
+  for(uint64_t rdxn_id: dep_rdxns) {
+    auto got = _rdxns.find(rdxn_id);
+    DEV_ASSERT(got != _rdxns.end());
+    const Rdxn &x = got->second;
+    // the result reaches ranks outside the team as an empty message
+    double msg = _teams.has(x.team, rank) ? 0 : _msg(0);
+    if(x.done + msg > start) {
+      start = x.done + msg;
+      start_msg = msg;
+      via = &x.path;
+    }
+  }
+
+  shared_ptr<const Path> path = _extend(
+    via ? *via : shared_ptr<const Path>(), note, seconds, start_msg, 0
+  );
+
+  _datas[data_id].put(task_id);
+  Task &task = _tasks[task_id];
+  task.rank = rank;
+  task.note = note;
+  task.done = start + seconds;
+  task.path = path;
+
+  _work += seconds;
+  _reached(task.done, path);
+}
+
+void TracerCritPath::reduction(
+    std::uint64_t rdxn_id,
+    std::size_t bytes,
+    const std::vector<std::uint64_t> &dep_tasks,
+    const std::vector<std::uint64_t> &dep_rdxns
+  ) {
+  static const TaskNote no_note{TaskNote::intern("reduction"), -1, -1};
+
+  double start = 0;
+  TaskNote note = no_note;
+  const shared_ptr<const Path> *via = nullptr;
+
+  IntSet<int> teamset;
+  vector<int> &team = _scratch_team;
+  team.clear();
+
+  for(uint64_t task_id: dep_tasks) {
+    const Task &d = _tasks[task_id];
+    if(!teamset.put(d.rank))
+      team.push_back(d.rank);
+    if(via == nullptr || d.done > start) {
+      start = d.done;
+      via = &d.path;
+      note = d.note;
+    }
+  }
+  for(uint64_t dep_rdxn_id: dep_rdxns) {
+    auto got = _rdxns.find(dep_rdxn_id);
+    DEV_ASSERT(got != _rdxns.end());
+    if(via == nullptr || got->second.done > start) {
+      start = got->second.done;
+      via = &got->second.path;
+      note = got->second.note;
+    }
+  }
+
+  int rounds = 0;
+  while((size_t(1) << rounds) < team.size())
+    rounds += 1;
+  double cost = rounds*_msg(bytes);
+
+  Rdxn &x = _rdxns[rdxn_id];
+  x.team = _teams.intern(team.data(), team.size());
+  x.done = start + cost;
+  x.note = note;
+  x.path = _extend(via ? *via : shared_ptr<const Path>(), note, 0, 0, cost);
+  _reached(x.done, x.path);
+}
+
+void TracerCritPath::retire(std::uint64_t data_id) {
+  auto got = _datas.find(data_id);
+  if(got == _datas.end())
+    return;
+  got->second.for_each([&](std::uint64_t task_id) {
+    _tasks.erase(task_id);
+  });
+  _datas.erase(got);
+}
+
+void TracerCritPath::retire_rdxn(std::uint64_t rdxn_id) {
+  auto got = _rdxns.find(rdxn_id);
+  if(got == _rdxns.end())
+    return;
+  _teams.release(got->second.team);
+  _rdxns.erase(got);
+}
+
+Tracer::Live TracerCritPath::live() const {
+  Live lv;
+  lv.datas = _datas.size();
+  lv.tasks = _tasks.size();
+  lv.rdxns = _rdxns.size();
+  lv.teams = _teams.size();
+  return lv;
+}
+
+void TracerCritPath::checkpoint_load(std::istream &i) {
+  USER_ASSERT(false, "format=critpath can't resume from a checkpoint.");
+}
+
+const TracerCritPath::Path& TracerCritPath::critical() const {
+  static const Path empty;
+  return _critical ? *_critical : empty;
+}
+
+namespace {
+  struct Sums {
+    double compute = 0, message = 0, allreduce = 0;
+    double total() const { return compute + message + allreduce; }
+  };
+
+  template<class Key>
+  void write_table(ostream &o, const char *head, const map<Key,Sums> &rows, double length,
+                   const function<void(ostream&, const Key&)> &key) {
+    vector<pair<Key,Sums>> sorted(rows.begin(), rows.end());
+    std::stable_sort(sorted.begin(), sorted.end(),
+      [](const pair<Key,Sums> &a, const pair<Key,Sums> &b) {
+        return a.second.total() > b.second.total();
+      }
+    );
+    o << head << "\tcompute\tmessage\tallreduce\tshare\n";
+    for(const auto &row: sorted) {
+      key(o, row.first);
+      o << '\t' << row.second.compute
+        << '\t' << row.second.message
+        << '\t' << row.second.allreduce
+        << '\t' << (length > 0 ? row.second.total()/length : 0) << '\n';
+    }
+  }
+}
+
+void TracerCritPath::finish() {
+  _finished = true;
+
+  Sums all;
+  map<uint32_t,Sums> by_op;
+  map<int32_t,Sums> by_lev;
+  for(const Part &part: critical()) {
+    for(Sums *s: {&all, &by_op[part.op], &by_lev[part.lev]}) {
+      s->compute += part.compute;
+      s->message += part.message;
+      s->allreduce += part.allreduce;
+    }
+  }
+
+  ostream &o = *_report;
+  o << "critical_path " << _length << '\n'
+    << "compute " << all.compute << '\n'
+    << "message " << all.message << '\n'
+    << "allreduce " << all.allreduce << '\n'
+    << "work " << _work << '\n'
+    << "parallelism " << (_length > 0 ? _work/_length : 0) << '\n';
+  write_table<uint32_t>(o, "op", by_op, _length,
+    [](ostream &o, const uint32_t &op) { o << TaskNote::name(op); }
+  );
+  write_table<int32_t>(o, "lev", by_lev, _length,
+    [](ostream &o, const int32_t &lev) { o << lev; }
+  );
+  o.flush();
+
+  auto top = std::max_element(by_op.begin(), by_op.end(),
+    [](const pair<const uint32_t,Sums> &a, const pair<const uint32_t,Sums> &b) {
+      return a.second.total() < b.second.total();
+    }
+  );
+  Say s;
+  s << "critical path " << _length << "s, " << (_length > 0 ? _work/_length : 0) << "x parallel";
+  if(top != by_op.end() && _length > 0)
+    s << ", " << 100*top->second.total()/_length << "% of it in " << TaskNote::name(top->first);
+}
@@ -0,0 +1,121 @@
+#ifndef _3f0b6c1e_92d4_4a57_b8e3_5d7a0c14e6f2
+#define _3f0b6c1e_92d4_4a57_b8e3_5d7a0c14e6f2
+
+# include "tracer.hxx"
+# include "simwriter.hxx"
+# include "teamtable.hxx"
+# include "lowlevel/idmap.hxx"
+# include "lowlevel/intset.hxx"
+
+# include <iostream>
+# include <memory>
+# include <unordered_map>
+# include <vector>
+
+/* TracerCritPath finds the longest path through the task graph as it is
+ * traced and says where its time goes, by operator and by AMR level.
+ *
+ * Every live task keeps when it would finish with unlimited ranks: its
+ * seconds after the latest of its deps, where a dep on another rank
+ * first pays a message of L + 2*o + b*G, and a dep on a reduction whose
+ * team doesn't include the task's rank pays an empty one. A reduction
+ * finishes ceil(log2 team) rounds of L + 2*o + b*G after its latest dep.
+ * Ranks aren't a resource here, so this is a lower bound on the
+ * makespan where format=sim is a prediction of it.
+ *
+ * Alongside its finish time each task holds the breakdown of the path
+ * that led to it: seconds of compute, message and allreduce per
+ * (op, lev) of the task they were paid for, allreduces counting against
+ * the note of their latest dep. Breakdowns are shared until a task adds
+ * to them and are dropped with the tasks as their data retires, so with
+ * stream=1 memory follows what is live rather than the trace's length.
+ */
+namespace programr {
+  class TracerCritPath: public Tracer {
+  public:
+    struct Part {
+      std::uint32_t op;
+      std::int32_t lev;
+      double compute, message, allreduce;
+    };
+    // sorted by (op, lev)
+    typedef std::vector<Part> Path;
+
+  private:
+    struct Task {
+      int rank;
+      TaskNote note;
+      double done;
+      std::shared_ptr<const Path> path;
+    };
+    struct Rdxn {
+      std::uint32_t team;
+      double done;
+      TaskNote note; // of its latest dep
+      std::shared_ptr<const Path> path;
+    };
+
+    SimParams _p;
+    std::ostream *_report;
+    std::unordered_map<std::uint64_t,IntSet<std::uint64_t>> _datas;
+    IdMap<Task> _tasks;
+    std::unordered_map<std::uint64_t,Rdxn> _rdxns;
+    TeamTable _teams;
+    std::vector<int> _scratch_team;
+
+    double _length = 0, _work = 0;
+    std::shared_ptr<const Path> _critical;
+    bool _finished = false;
+
+  public:
+    // writes its report to `report` on finish()
+    TracerCritPath(const SimParams &p, std::ostream *report);
+    ~TracerCritPath();
+
+    void task(
+      std::uint64_t task_id,
+      int rank,
+      std::uint64_t data_id,
+      const std::vector<TaskDepTask> &dep_tasks,
+      const std::vector<std::uint64_t> &dep_rdxns,
+      TaskNote note,
+      double seconds
+    );
+
+    void reduction(
+      std::uint64_t rdxn_id,
+      std::size_t bytes,
+      const std::vector<std::uint64_t> &dep_tasks,
+      const std::vector<std::uint64_t> &dep_rdxns
+    );
+
+    void retire(std::uint64_t data_id);
+    void retire_rdxn(std::uint64_t rdxn_id) override;
+
+    Live live() const override;
+
+    // nothing is written until finish(), so there's nothing to resume into
+    void checkpoint_load(std::istream &i) override;
+
+    // writes the report, called by the destructor if not before
+    void finish();
+
+    // seconds along the critical path
+    double length() const { return _length; }
+    // sum of all tasks' seconds
+    double work() const { return _work; }
+    const Path& critical() const;
+
+  private:
+    double _msg(std::size_t bytes) const {
+      return _p.latency + 2*_p.overhead + bytes*_p.byte_time;
+    }
+    // `from` plus the given seconds for `note`, shared if they're all 0
+    static std::shared_ptr<const Path> _extend(
+      const std::shared_ptr<const Path> &from, TaskNote note,
+      double compute, double message, double allreduce
+    );
+    void _reached(double done, const std::shared_ptr<const Path> &path);
+  };
+}
+#endif
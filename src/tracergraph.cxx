@@ -1,28 +1,71 @@
 #include "tracergraph.hxx"
 #include "lowlevel/spookyhash.hxx"
 
+#include <algorithm>
 #include <sstream>
 
 using namespace programr;
 using namespace std;
 
+TracerGraph::TracerGraph(int rank_n, std::ostream *epochs):
+  _epochs_out(epochs),
+  _rank_n(rank_n) {
+  if (_epochs_out)
+    *_epochs_out << "epoch\tlev\ttasks\tmsgs\tcomp_max\tcomp_mean\timbalance\tsent_max\tsent_mean\trecv_max\trecv_mean\n";
+}
+
+TracerGraph::~TracerGraph() {
+  if (_epochs_out) {
+    _epoch_write();
+    _epochs_out->flush();
+  }
+}
+
 void TracerGraph::task(
     std::uint64_t task_id,
     int rank_id,
     std::uint64_t data_id,
     const std::vector<TaskDepTask> &dep_tasks,
     const std::vector<std::uint64_t> &dep_rdxns,
-    std::string note,
+    TaskNote note,
+    double seconds
+  ) {
+  _task(task_id, rank_id, _datas[data_id], dep_tasks.data(), dep_tasks.size(), note, seconds);
+}
+
+void TracerGraph::task_batch(
+    const Tasks &tasks,
+    const std::vector<std::uint64_t> &dep_rdxns
+  ) {
+  Data &data = _datas[tasks.data_id];
+  
+  for(std::size_t i=0; i < tasks.n; i++) {
+    std::size_t off = tasks.dep_off[i];
+    _task(
+      tasks.task_id0 + i, tasks.ranks[i], data,
+      tasks.deps + off, tasks.dep_off[i+1] - off,
+      tasks.notes[i], tasks.seconds[i]
+    );
+  }
+}
+
+void TracerGraph::_task(
+    std::uint64_t task_id,
+    int rank_id,
+    Data &data,
+    const TaskDepTask *dep_tasks, std::size_t dep_n,
+    const TaskNote &note,
     double seconds
   ) {
   
   Task &task = _tasks[task_id];
   task.rank = rank_id;
+  task.lev = note.lev;
   
-  Data &data = _datas[data_id];
   data.tasks.put(task_id);
   
-  for(TaskDepTask dep: dep_tasks) {
+  for(std::size_t i=0; i < dep_n; i++) {
+    const TaskDepTask &dep = dep_tasks[i];
     int rank_d = rank_id;
     int rank_s = _tasks[dep.task].rank;
     
@@ -32,7 +75,7 @@ void TracerGraph::task(
     
     if(data.comms.count(comm) == 0 && rank_s != rank_d) {
       data.comms.insert(comm);
-      add_comm(rank_s, rank_d, dep.bytes);
+      add_comm(rank_s, rank_d, dep.bytes, note.lev);
     }
   }
   
@@ -49,7 +92,8 @@ void TracerGraph::reduction(
   for(std::uint64_t task_id: dep_tasks) {
     teamranks.put(_tasks[task_id].rank);
   }
-  add_coll(teamranks, bytes);
+  int lev = dep_tasks.empty() ? -1 : _tasks[dep_tasks[0]].lev;
+  add_coll(teamranks, bytes, lev);
 }
     
 void TracerGraph::retire(std::uint64_t data_id) {
@@ -59,3 +103,65 @@ void TracerGraph::retire(std::uint64_t data_id) {
   });
   _datas.erase(data_id);
 }
+
+CommMatrix TracerGraph::comm_matrix(int rank_n) const {
+  CommMatrixBuilder b;
+  for (const auto &kv: comms)
+    b.add(kv.first.first, kv.first.second, kv.second.second, kv.second.first);
+  return b.build(rank_n);
+}
+
+void TracerGraph::post_compute_exec() {
+  if (_epochs_out) _epoch_write();
+  ++_comp_epoch;
+}
+
+TracerGraph::LevEpoch& TracerGraph::_lev_epoch(int lev, int rank) {
+  LevEpoch &le = _lev_epochs[lev];
+  _rank_n = std::max(_rank_n, rank + 1);
+  size_t n = _rank_n;
+  if (le.comp.size() < n) {
+    le.comp.resize(n, 0);
+    le.sent.resize(n, 0);
+    le.recv.resize(n, 0);
+  }
+  return le;
+}
+
+void TracerGraph::_epoch_comp(int rank, int lev, double secs) {
+  LevEpoch &le = _lev_epoch(lev, rank);
+  le.comp[rank] += secs;
+  le.tasks += 1;
+}
+
+void TracerGraph::_epoch_comm(int src, int dst, size_t bytes, int lev) {
+  LevEpoch &le = _lev_epoch(lev, std::max(src, dst));
+  le.sent[src] += bytes;
+  le.recv[dst] += bytes;
+  le.msgs += 1;
+}
+
+void TracerGraph::_epoch_write() {
+  ostream &o = *_epochs_out;
+  for (const auto &kv: _lev_epochs) {
+    const LevEpoch &le = kv.second;
+    double comp_max = 0, comp_sum = 0;
+    uint64_t sent_max = 0, sent_sum = 0, recv_max = 0, recv_sum = 0;
+    for (size_t r=0; r < le.comp.size(); r++) {
+      comp_max = std::max(comp_max, le.comp[r]);
+      comp_sum += le.comp[r];
+      sent_max = std::max(sent_max, le.sent[r]);
+      sent_sum += le.sent[r];
+      recv_max = std::max(recv_max, le.recv[r]);
+      recv_sum += le.recv[r];
+    }
+    double comp_mean = comp_sum/_rank_n;
+    o << _comp_epoch << '\t' << kv.first
+      << '\t' << le.tasks << '\t' << le.msgs
+      << '\t' << comp_max << '\t' << comp_mean
+      << '\t' << (comp_mean > 0 ? comp_max/comp_mean : 1.0)
+      << '\t' << sent_max << '\t' << double(sent_sum)/_rank_n
+      << '\t' << recv_max << '\t' << double(recv_sum)/_rank_n << '\n';
+  }
+  _lev_epochs.clear();
+}
@@ -2,9 +2,13 @@
 #define _a8ce8d36_29d0_4561_8a3f_3002da43f18b
 
 # include "tracer.hxx"
+# include "commmatrix.hxx"
+# include "lowlevel/idmap.hxx"
 # include "lowlevel/intset.hxx"
 # include "lowlevel/digest.hxx"
 
+# include <iostream>
+# include <map>
 # include <unordered_map>
 # include <unordered_set>
 # include <string>
@@ -25,27 +29,42 @@ namespace programr {
     };
     struct Task {
       int rank;
+      int lev;
     };
     std::unordered_map<std::uint64_t,Data> _datas;
-    std::unordered_map<std::uint64_t,Task> _tasks;
+    IdMap<Task> _tasks;
 
     // captured metadata
     std::unordered_map<int, double> comps;
     std::unordered_map<std::pair<int, int>, std::pair<int, size_t>> comms;
 
-    void add_comp(int node_id, double secs, std::string note) {
+    // time-resolved mode: what happened between two post_compute_exec()s
+    // per level, written as rows of _epochs_out when the epoch ends
+    struct LevEpoch {
+      std::vector<double> comp; // seconds by rank
+      std::vector<std::uint64_t> sent, recv; // bytes by rank
+      std::uint64_t tasks = 0, msgs = 0;
+    };
+    std::ostream *_epochs_out;
+    int _rank_n;
+    std::uint64_t _comp_epoch = 0;
+    std::map<int, LevEpoch> _lev_epochs;
+
+    void add_comp(int node_id, double secs, const TaskNote &note) {
       if (flag_verbose_tracer) std::cout << "comp: (" << note << ", " << node_id << ", " << secs << ")" << std::endl;
       comps[node_id] += secs;
+      if (_epochs_out) _epoch_comp(node_id, note.lev, secs);
     }
 
-    void add_comm(int src, int dst, size_t bytes) {
+    void add_comm(int src, int dst, size_t bytes, int lev) {
       if (flag_verbose_tracer) std::cout << "comm: (" << src << ", " << dst << ", " << bytes << ")" << std::endl;
       auto &entry = comms[{src, dst}];
       entry.first += 1;
       entry.second += bytes;
+      if (_epochs_out) _epoch_comm(src, dst, bytes, lev);
     }
 
-    void add_coll(IntSet<int> teamnodes, size_t bytes) {
+    void add_coll(IntSet<int> teamnodes, size_t bytes, int lev) {
       if (flag_verbose_tracer) std::cout << "coll: (" << teamnodes << ", " << bytes << ")" << std::endl;
       std::vector<int> vec; {
         teamnodes.for_each([&](int x) {vec.push_back(x);});
@@ -61,11 +80,23 @@ namespace programr {
         auto &entry2 = comms[{dst, src}]; // down the tree
         entry2.first += 1;
         entry2.second += bytes;
+        if (_epochs_out) {
+          _epoch_comm(src, dst, bytes, lev);
+          _epoch_comm(dst, src, bytes, lev);
+        }
       }
     }
 
   public:
-    TracerGraph() {}
+    // with `epochs`, also writes a table with a row per compute epoch and
+    // level, from epoch 0 before the first post_compute_exec(). Each row
+    // has the seconds computed, bytes sent and received by the busiest
+    // rank and their mean over `rank_n` ranks (or as many as were seen),
+    // max/mean of the seconds, and the tasks and messages. Messages
+    // count at the level of the task receiving them, allreduces at the
+    // level of their first dep.
+    TracerGraph(int rank_n = 0, std::ostream *epochs = nullptr);
+    ~TracerGraph();
 
     void task(
       std::uint64_t task_id,
@@ -73,10 +104,15 @@ namespace programr {
       std::uint64_t data_id,
       const std::vector<TaskDepTask> &dep_tasks,
       const std::vector<std::uint64_t> &dep_rdxns,
-      std::string note,
+      TaskNote note,
       double seconds
     );
     
+    void task_batch(
+      const Tasks &tasks,
+      const std::vector<std::uint64_t> &dep_rdxns
+    );
+    
     void reduction(
       std::uint64_t rdxn_id,
       std::size_t bytes,
@@ -86,8 +122,26 @@ namespace programr {
     
     void retire(std::uint64_t data_id);
 
+    void post_compute_exec() override;
+
     const std::unordered_map<int, double> & get_comps() const { return comps; }
     const std::unordered_map<std::pair<int, int>, std::pair<int, size_t>> & get_comms() const { return comms; }
+    // get_comms() as a sparse matrix over at least `rank_n` ranks
+    CommMatrix comm_matrix(int rank_n = 0) const;
+  
+  private:
+    void _task(
+      std::uint64_t task_id,
+      int rank,
+      Data &data,
+      const TaskDepTask *dep_tasks, std::size_t dep_n,
+      const TaskNote &note,
+      double seconds
+    );
+    LevEpoch& _lev_epoch(int lev, int rank);
+    void _epoch_comp(int rank, int lev, double secs);
+    void _epoch_comm(int src, int dst, size_t bytes, int lev);
+    void _epoch_write();
   };
 }
 #endif
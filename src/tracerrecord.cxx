@@ -0,0 +1,185 @@
+#include "tracerrecord.hxx"
+#include "diagnostic.hxx"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  uint64_t double_bits(double x) {
+    uint64_t u;
+    std::memcpy(&u, &x, sizeof(u));
+    return u;
+  }
+  double bits_double(uint64_t u) {
+    double x;
+    std::memcpy(&x, &u, sizeof(x));
+    return x;
+  }
+}
+
+/* Words per call:
+ *   op_tasks <task_id0> <data_id> <n> <rdxn n> <rdxns...>
+ *     then per task <rank> <op> <lev> <box> <seconds> <dep n>,
+ *     the deps themselves going to _deps in order
+ *   op_rdxn <rdxn_id> <bytes> <task n> <tasks...> <rdxn n> <rdxns...>
+ *   op_retire <data_id>
+ *   op_retire_rdxn <rdxn_id>
+ *   op_epoch
+ */
+void TracerRecord::_task(
+    int rank, const TaskDepTask *deps, size_t dep_n,
+    TaskNote note, double seconds
+  ) {
+  _rank_n = std::max(_rank_n, rank + 1);
+  _words.push_back(uint64_t(rank));
+  _words.push_back(note.op);
+  _words.push_back(uint64_t(int64_t(note.lev)));
+  _words.push_back(uint64_t(int64_t(note.box)));
+  _words.push_back(double_bits(seconds));
+  _words.push_back(dep_n);
+  _deps.insert(_deps.end(), deps, deps + dep_n);
+}
+
+void TracerRecord::task(
+    std::uint64_t task_id,
+    int rank,
+    std::uint64_t data_id,
+    const std::vector<TaskDepTask> &dep_tasks,
+    const std::vector<std::uint64_t> &dep_rdxns,
+    TaskNote note,
+    double seconds
+  ) {
+  _words.push_back(op_tasks);
+  _words.push_back(task_id);
+  _words.push_back(data_id);
+  _words.push_back(1);
+  _words_of(dep_rdxns);
+  _task(rank, dep_tasks.data(), dep_tasks.size(), note, seconds);
+}
+
+void TracerRecord::task_batch(
+    const Tasks &tasks,
+    const std::vector<std::uint64_t> &dep_rdxns
+  ) {
+  _words.push_back(op_tasks);
+  _words.push_back(tasks.task_id0);
+  _words.push_back(tasks.data_id);
+  _words.push_back(tasks.n);
+  _words_of(dep_rdxns);
+  for(size_t i=0; i < tasks.n; i++) {
+    size_t off = tasks.dep_off[i];
+    _task(
+      tasks.ranks[i], tasks.deps + off, tasks.dep_off[i+1] - off,
+      tasks.notes[i], tasks.seconds[i]
+    );
+  }
+}
+
+void TracerRecord::reduction(
+    std::uint64_t rdxn_id,
+    std::size_t bytes,
+    const std::vector<std::uint64_t> &dep_tasks,
+    const std::vector<std::uint64_t> &dep_rdxns
+  ) {
+  _words.push_back(op_rdxn);
+  _words.push_back(rdxn_id);
+  _words.push_back(bytes);
+  _words_of(dep_tasks);
+  _words_of(dep_rdxns);
+}
+
+void TracerRecord::retire(std::uint64_t data_id) {
+  _words.push_back(op_retire);
+  _words.push_back(data_id);
+}
+
+void TracerRecord::retire_rdxn(std::uint64_t rdxn_id) {
+  _words.push_back(op_retire_rdxn);
+  _words.push_back(rdxn_id);
+}
+
+void TracerRecord::post_compute_exec() {
+  _words.push_back(op_epoch);
+}
+
+void TracerRecord::checkpoint_load(std::istream &i) {
+  USER_ASSERT(false, "A recording tracer can't resume from a checkpoint.");
+}
+
+void TracerRecord::replay(Tracer &to, const std::vector<int> &rank_of) const {
+  USER_ASSERT(int(rank_of.size()) >= _rank_n, "Replaying needs a rank for every recorded rank.");
+
+  const uint64_t *w = _words.data(), *end = w + _words.size();
+  const TaskDepTask *dep = _deps.data();
+  vector<uint64_t> rdxns, tasks;
+  vector<int> ranks;
+  vector<double> seconds;
+  vector<TaskNote> notes;
+  vector<size_t> dep_off;
+
+  auto take_ids = [&](vector<uint64_t> &ids) {
+    size_t n = *w++;
+    ids.assign(w, w + n);
+    w += n;
+  };
+
+  while(w != end) {
+    switch(*w++) {
+    case op_tasks: {
+      Tasks batch;
+      batch.task_id0 = *w++;
+      batch.data_id = *w++;
+      batch.n = *w++;
+      take_ids(rdxns);
+
+      ranks.resize(batch.n);
+      seconds.resize(batch.n);
+      notes.resize(batch.n);
+      dep_off.resize(batch.n + 1);
+      dep_off[0] = 0;
+      for(size_t i=0; i < batch.n; i++) {
+        ranks[i] = rank_of[*w++];
+        notes[i].op = uint32_t(*w++);
+        notes[i].lev = int32_t(int64_t(*w++));
+        notes[i].box = int32_t(int64_t(*w++));
+        seconds[i] = bits_double(*w++);
+        dep_off[i+1] = dep_off[i] + *w++;
+      }
+      batch.ranks = ranks.data();
+      batch.seconds = seconds.data();
+      batch.notes = notes.data();
+      batch.dep_off = dep_off.data();
+      batch.deps = dep;
+      dep += dep_off[batch.n];
+
+      to.task_batch(batch, rdxns);
+    } break;
+
+    case op_rdxn: {
+      uint64_t rdxn_id = *w++;
+      size_t bytes = *w++;
+      take_ids(tasks);
+      take_ids(rdxns);
+      to.reduction(rdxn_id, bytes, tasks, rdxns);
+    } break;
+
+    case op_retire:
+      to.retire(*w++);
+      break;
+
+    case op_retire_rdxn:
+      to.retire_rdxn(*w++);
+      break;
+
+    case op_epoch:
+      to.post_compute_exec();
+      break;
+
+    default:
+      DEV_ASSERT(false);
+    }
+  }
+}
@@ -0,0 +1,82 @@
+#ifndef _5a0e3c71_d8b4_4f29_b6e2_91c7f04a83d5
+#define _5a0e3c71_d8b4_4f29_b6e2_91c7f04a83d5
+
+# include "tracer.hxx"
+
+# include <cstdint>
+# include <vector>
+
+/* TracerRecord keeps every call a run makes to its tracer, so the run can
+ * be played into other tracers afterwards with its ranks translated.
+ *
+ * Traced with each box of the mesh on a rank of its own, the recording is
+ * rank agnostic: the apps derive every rank map from the mesh's, so a
+ * task's recorded rank is the mesh box it was placed by. Replaying with
+ * rank_of[box] set from some partition then gives the calls that tracing
+ * that partition would have made, and the tracer played into does the
+ * rank dependent work, merging messages to the same rank and dropping
+ * those within one. Ranks an app picks itself, like migrate's rank 0,
+ * are read as the box of that id.
+ *
+ * Calls are kept as a stream of words plus the task deps, 32 bytes
+ * per dep and 48 per task.
+ */
+namespace programr {
+  class TracerRecord: public Tracer {
+    enum Op: std::uint64_t { op_tasks, op_rdxn, op_retire, op_retire_rdxn, op_epoch };
+
+    std::vector<std::uint64_t> _words;
+    std::vector<TaskDepTask> _deps;
+    int _rank_n = 0;
+
+  public:
+    void task(
+      std::uint64_t task_id,
+      int rank,
+      std::uint64_t data_id,
+      const std::vector<TaskDepTask> &dep_tasks,
+      const std::vector<std::uint64_t> &dep_rdxns,
+      TaskNote note,
+      double seconds
+    );
+
+    void task_batch(
+      const Tasks &tasks,
+      const std::vector<std::uint64_t> &dep_rdxns
+    );
+
+    void reduction(
+      std::uint64_t rdxn_id,
+      std::size_t bytes,
+      const std::vector<std::uint64_t> &dep_tasks,
+      const std::vector<std::uint64_t> &dep_rdxns
+    );
+
+    void retire(std::uint64_t data_id);
+    void retire_rdxn(std::uint64_t rdxn_id) override;
+    void post_compute_exec() override;
+
+    // a recording can't be resumed into, it holds the whole run
+    void checkpoint_load(std::istream &i) override;
+
+    // one more than the largest rank recorded
+    int rank_n() const { return _rank_n; }
+    std::size_t bytes() const {
+      return _words.size()*sizeof(std::uint64_t) + _deps.size()*sizeof(TaskDepTask);
+    }
+
+    // makes the recorded calls on `to` with each rank r as rank_of[r]
+    void replay(Tracer &to, const std::vector<int> &rank_of) const;
+
+  private:
+    void _task(
+      int rank, const TaskDepTask *deps, std::size_t dep_n,
+      TaskNote note, double seconds
+    );
+    void _words_of(const std::vector<std::uint64_t> &xs) {
+      _words.push_back(xs.size());
+      _words.insert(_words.end(), xs.begin(), xs.end());
+    }
+  };
+}
+#endif
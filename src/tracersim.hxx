@@ -0,0 +1,17 @@
+#ifndef _60cb4dca_6b7a_46ae_881d_a00f18785973
+#define _60cb4dca_6b7a_46ae_881d_a00f18785973
+
+# include "tracerxml.hxx"
+# include "simwriter.hxx"
+
+namespace programr {
+  // Generates the same events as TracerXml but feeds them straight to a
+  // SimEventWriter, which reports the predicted makespan and each rank's
+  // idle time instead of writing a trace.
+  struct TracerSim: TracerXml {
+    TracerSim(int rank_n, const SimParams &p, std::ostream *report):
+      TracerXml(rank_n, new SimEventWriter(rank_n, p, report)) {
+    }
+  };
+}
+#endif
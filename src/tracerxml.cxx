@@ -2,53 +2,43 @@
 #include "lowlevel/spookyhash.hxx"
 #include "env.hxx"
 
-#include <sstream>
+#include <algorithm>
 #include <fstream>
 
 using namespace programr;
 using namespace std;
 
-namespace {
-  template<class T>
-  void uniquify(vector<T> &v) {
-    std::sort(v.begin(), v.end());
-    auto last = std::unique(v.begin(), v.end());
-    v.erase(last, v.end());
-  }
+bool TracerXml::_rank_in_rdxn_team(std::uint64_t rdxn_id, std::uint64_t rank) {
+  return _teams.has(_rdxn_teams.at(rdxn_id), rank);
+}
 
-  // keep track of which ranks participate in which reductions
-  unordered_map<std::uint64_t, unordered_set<std::uint64_t>> rdxn_teams;
-  unordered_map<std::uint64_t, vector<std::uint64_t>> rdxn_team_vecs;
-  void add_to_rdxn_team(std::uint64_t rdxn_id, std::uint64_t rank) {
-    rdxn_teams[rdxn_id].insert(rank); // create entry if needed
-  }
-  bool rank_in_rdxn_team(std::uint64_t rdxn_id, std::uint64_t rank) {
-    return rdxn_teams.at(rdxn_id).count(rank) > 0;
-  }
-  std::uint64_t rand_team_rank(std::uint64_t rdxn_id) {
-    if (rdxn_team_vecs.count(rdxn_id) == 0) {
-      for (auto rank_id : rdxn_teams.at(rdxn_id)) {
-        rdxn_team_vecs[rdxn_id].push_back(rank_id);
-      }
-    }
-    // low quality rand is okay
-    int rand_idx = rand() % rdxn_team_vecs[rdxn_id].size();
-    return rdxn_team_vecs[rdxn_id][rand_idx];
-  }
+std::uint64_t TracerXml::_rand_team_rank(std::uint64_t rdxn_id) {
+  const vector<int> &ranks = _teams.ranks(_rdxn_teams.at(rdxn_id));
+  // low quality rand is okay: a 64 bit lcg, taking its high bits
+  _rand_state = _rand_state*6364136223846793005u + 1442695040888963407u;
+  size_t rand_idx = (_rand_state >> 33) % ranks.size();
+  return ranks[rand_idx];
 }
 
 TracerXml::TracerXml(int rank_n, std::ostream *file):
+  TracerXml(rank_n, new XmlEventWriter(file)) {
+}
+
+TracerXml::TracerXml(int rank_n, EventWriter *writer):
   _rank_n(rank_n),
-  _file(file) {
+  _writer(writer) {
   
   _comm_id_next = 0;
-  *_file << "<events>\n";
   _flag_totals = env<bool>("commtotals", false);
+  _totals_format = env<std::string>("commtotals_format", "tsv");
+  USER_ASSERT(!_flag_totals || _totals_format == "tsv" || _totals_format == "mtx" || _totals_format == "csr",
+    "commtotals_format is one of tsv, mtx or csr.");
+  _totals_file = "comm_totals." + _totals_format;
   _comp_epoch = 0;
 }
 
 TracerXml::~TracerXml() {
-  *_file << "</events>\n";
+  _writer->finish();
   if (_flag_totals) _dump_totals();
 }
 
@@ -58,37 +48,60 @@ void TracerXml::task(
     std::uint64_t data_id,
     const std::vector<TaskDepTask> &dep_tasks,
     const std::vector<std::uint64_t> &dep_rdxns,
-    std::string note,
+    TaskNote note,
+    double seconds
+  ) {
+  _task(task_id, rank_id, _datas[data_id], dep_tasks.data(), dep_tasks.size(), dep_rdxns, note, seconds);
+}
+
+void TracerXml::task_batch(
+    const Tasks &tasks,
+    const std::vector<std::uint64_t> &dep_rdxns
+  ) {
+  Data &data = _datas[tasks.data_id];
+  
+  for(std::size_t i=0; i < tasks.n; i++) {
+    std::size_t off = tasks.dep_off[i];
+    _task(
+      tasks.task_id0 + i, tasks.ranks[i], data,
+      tasks.deps + off, tasks.dep_off[i+1] - off,
+      dep_rdxns, tasks.notes[i], tasks.seconds[i]
+    );
+  }
+}
+
+void TracerXml::_task(
+    std::uint64_t task_id,
+    int rank_id,
+    Data &data,
+    const TaskDepTask *dep_tasks, std::size_t dep_n,
+    const std::vector<std::uint64_t> &dep_rdxns,
+    TaskNote note,
     double seconds
   ) {
   
   Task &task = _tasks[task_id];
   task.rank = rank_id;
-  task.note = std::move(note);
+  task.note = note;
   
-  Data &data = _datas[data_id];
   data.tasks.put(task_id);
   
-  stringstream depstr;
-  bool first_dep = true;
-  
   uint64_t event_id = 0 + 3*task_id;
-  vector<uint64_t> dep_event_ids;
+  vector<uint64_t> &dep_event_ids = _scratch_deps;
+  dep_event_ids.clear();
   
-  unordered_set<uint64_t> rdxns_left;
+  // reductions whose team doesnt include this rank, kept in dep_rdxns order
+  vector<uint64_t> &rdxns_left = _scratch_rdxns;
+  rdxns_left.clear();
   for(auto rdxn_id: dep_rdxns) {
-    if (rank_in_rdxn_team(rdxn_id, rank_id)) {
-      if(!first_dep) depstr << ',';
-      first_dep = false;
-      depstr << "e" << 2 + 3*rdxn_id;
-      
+    if (_rank_in_rdxn_team(rdxn_id, rank_id))
       dep_event_ids.push_back(2 + 3*rdxn_id);
-    } else {
-      rdxns_left.insert(rdxn_id);
-    }
+    else
+      rdxns_left.push_back(rdxn_id);
   }
   
-  for(TaskDepTask dep: dep_tasks) {
+  for(std::size_t i=0; i < dep_n; i++) {
+    const TaskDepTask &dep = dep_tasks[i];
     int rank_d = rank_id;
     int rank_s = _tasks[dep.task].rank;
     
@@ -98,7 +111,8 @@ void TracerXml::task(
     
     uint64_t task_dep_id;
     
-    if(data.comms.count(comm) == 0) {
+    auto got = data.comms.find(comm);
+    if(got == data.comms.end()) {
       if(!(KNOB_XML_SELF_COMMS) && rank_d == rank_s) {
         task_dep_id = 0 + 3*dep.task;
       }
@@ -107,45 +121,37 @@ void TracerXml::task(
         data.comms[comm] = comm_id;
         task_dep_id = 1 + 3*comm_id;
 
-        vector<uint64_t> comm_dep_event_ids;
-        stringstream comm_depstr;
+        vector<uint64_t> &comm_dep_event_ids = _scratch_comm_deps;
+        comm_dep_event_ids.clear();
 
         // add task dependency
-        uint64_t comm_dep_id = 0 + 3*dep.task;
-        comm_dep_event_ids.push_back(comm_dep_id);
-        comm_depstr << "e" << comm_dep_id;
+        comm_dep_event_ids.push_back(0 + 3*dep.task);
 
         // add dependency to task's reductions if rank_s is a team member
         // FIXME: this isn't quite right for comms that are reused by
         //        multiple tasks with differing reduction dependencies.
         for (auto rdxn_id : dep_rdxns) {
-          if (rank_in_rdxn_team(rdxn_id, rank_s)) {
-            comm_dep_id = 2 + 3*rdxn_id;
-            comm_dep_event_ids.push_back(comm_dep_id);
-            comm_depstr << ",e" << comm_dep_id;
-            rdxns_left.erase(rdxn_id);
+          if (_rank_in_rdxn_team(rdxn_id, rank_s)) {
+            comm_dep_event_ids.push_back(2 + 3*rdxn_id);
+            rdxns_left.erase(
+              std::remove(rdxns_left.begin(), rdxns_left.end(), rdxn_id),
+              rdxns_left.end()
+            );
           }
         }
         
-        *_file << "<comm "
-          "id=\"e" << task_dep_id << "\" "
-          "dep=\"" << comm_depstr.str() << "\" "
-          "from=\"" << rank_s << "\" "
-          "to=\"" << rank_d << "\" "
-          "size=\"" << dep.bytes << "\" "
-          "epoch=\"" << _comp_epoch << "\" "
-          "/>\n";
+        _writer->comm(
+          task_dep_id,
+          comm_dep_event_ids.data(), comm_dep_event_ids.size(),
+          rank_s, rank_d, dep.bytes, _comp_epoch
+        );
         
-        _event_define(task_dep_id, std::move(comm_dep_event_ids));
+        _event_define(task_dep_id, comm_dep_event_ids.data(), comm_dep_event_ids.size());
         if (_flag_totals) _log_comm(rank_s, rank_d, dep.bytes);
       }
     }
     else
-      task_dep_id = 1 + 3*data.comms[comm];
-    
-    if(!first_dep) depstr << ',';
-    first_dep = false;
-    depstr << "e" << task_dep_id;
+      task_dep_id = 1 + 3*got->second;
     
     dep_event_ids.push_back(task_dep_id);
   }
@@ -154,45 +160,32 @@ void TracerXml::task(
     // send size 0 control message from a team member to here
     uint64_t comm_id = _comm_id_next++;
     uint64_t task_dep_id = 1 + 3*comm_id;
-    int rank_s = rand_team_rank(rdxn_id);
+    int rank_s = _rand_team_rank(rdxn_id);
     int rank_d = rank_id;
 
     // control message depends on reduction
     uint64_t comm_dep_id = 2 + 3*rdxn_id;
-    stringstream comm_depstr;
-    comm_depstr << "e" << comm_dep_id;
 
-    *_file << "<comm "
-      "id=\"e" << task_dep_id << "\" "
-      "dep=\"" << comm_depstr.str() << "\" "
-      "from=\"" << rank_s << "\" "
-      "to=\"" << rank_d << "\" "
-      "size=\"" << 0 << "\" "
-      "epoch=\"" << _comp_epoch << "\" "
-      "/>\n";
+    _writer->comm(task_dep_id, &comm_dep_id, 1, rank_s, rank_d, 0, _comp_epoch);
     
-    _event_define(task_dep_id, {comm_dep_id});
+    _event_define(task_dep_id, &comm_dep_id, 1);
 
     // task depends on control message
-    if(!first_dep) depstr << ',';
-    first_dep = false;
-    depstr << "e" << task_dep_id;
     dep_event_ids.push_back(task_dep_id);
   }
   
-  *_file << "<comp "
-    "id=\"e" << event_id << "\" "
-    "dep=\"" << depstr.str() << "\" "
-    "at=\"" << rank_id << "\" "
-    //"size=\"" << "?" << "\" "
-    "time=\"" << seconds << "\" "
-    "epoch=\"" << _comp_epoch+1 << "\" "
-#if KNOB_XML_NOTE
-    "note=\"" << task.note << "\" "
-#endif
-    "/>\n";
+  _writer->comp(
+    event_id,
+    dep_event_ids.data(), dep_event_ids.size(),
+    rank_id, seconds, _comp_epoch+1,
+    KNOB_XML_NOTE ? &task.note : nullptr
+  );
   
-  _event_define(event_id, std::move(dep_event_ids));
+  _event_define(event_id, dep_event_ids.data(), dep_event_ids.size());
+  
+  // control messages serve just this task
+  for(size_t i = dep_event_ids.size() - rdxns_left.size(); i < dep_event_ids.size(); i++)
+    _writer->retire(dep_event_ids[i]);
 }
 
 void TracerXml::reduction(
@@ -201,166 +194,286 @@ void TracerXml::reduction(
     const std::vector<std::uint64_t> &dep_tasks,
     const std::vector<std::uint64_t> &dep_rdxns
   ) {
-  stringstream depstr;
-  bool first_dep = true;
-  
   vector<uint64_t> dep_event_ids;
   
   IntSet<int> teamset;
-  stringstream teamstr;
-  bool first_team = true;
+  vector<int> &team = _scratch_team;
+  team.clear();
   
   for(std::uint64_t task_id: dep_tasks) {
-    if(!first_dep) depstr << ',';
-    first_dep = false;
-    depstr << "e" << 0 + 3*task_id;
-    
     dep_event_ids.push_back(0 + 3*task_id);
     
-    if(!teamset.put(_tasks[task_id].rank)) {
-      if(!first_team) teamstr << ',';
-      first_team = false;
-      teamstr << _tasks[task_id].rank;
-      add_to_rdxn_team(rdxn_id, _tasks[task_id].rank);
-    }
+    if(!teamset.put(_tasks[task_id].rank))
+      team.push_back(_tasks[task_id].rank);
   }
+  _rdxn_teams[rdxn_id] = _teams.intern(team.data(), team.size());
   
   for(std::uint64_t dep_rdxn_id: dep_rdxns) {
     //Say() << "collective dependency: " << 2+3*rdxn_id << " depends on " << 2+3*dep_rdxn_id;
-    if(!first_dep) depstr << ',';
-    first_dep = false;
-    depstr << "e" << 2 + 3*dep_rdxn_id;
-    
     dep_event_ids.push_back(2 + 3*dep_rdxn_id);
   }
   
   uint64_t event_id = 2 + 3*rdxn_id;
-  *_file << "<coll "
-    "id=\"e" << event_id << "\" "
-    "dep=\"" << depstr.str() << "\" "
-    "type=\"ALLREDUCE\" "
-    "team=\"" << teamstr.str() << "\" "
-    "size=\"" << bytes << "\" "
-    "epoch=\"" << _comp_epoch << "\" "
-    "/>\n";
+  _writer->coll(
+    event_id,
+    dep_event_ids.data(), dep_event_ids.size(),
+    team.data(), team.size(), bytes, _comp_epoch
+  );
   
-  _event_define(event_id, std::move(dep_event_ids));
+  _event_define(event_id, dep_event_ids.data(), dep_event_ids.size());
 }
     
 void TracerXml::retire(std::uint64_t data_id) {
+  // only tasks making the data depend on its comms
   Data &data = _datas[data_id];
   data.tasks.for_each([&](std::uint64_t task_id) {
     _tasks.erase(task_id);
+    _writer->retire(0 + 3*task_id);
   });
+  for(const auto &comm: data.comms)
+    _writer->retire(1 + 3*comm.second);
   _datas.erase(data_id);
 }
 
-void TracerXml::post_compute_exec() { ++_comp_epoch; }
-
-void TracerXml::_dump_totals() {
-  // determine max rank
-  int max_rank = 0;
-  for (const auto &p : _totals) {
-    int src, dst;
-    tie(src,dst) = p.first;
-    max_rank = std::max({max_rank, src, dst});
-  }
-
-  ofstream ofs;
-  ostream *os;
-  if (_totals_file == "-") {
-    os = &std::cout;
-  } else {
-    ofs.open(_totals_file);
-    os = &ofs;
-  }
+void TracerXml::retire_rdxn(std::uint64_t rdxn_id) {
+  auto got = _rdxn_teams.find(rdxn_id);
+  if(got == _rdxn_teams.end())
+    return;
+  _teams.release(got->second);
+  _rdxn_teams.erase(got);
+  _writer->retire(2 + 3*rdxn_id);
+}
 
-  // print table
-  for (int dst = 0; dst <= max_rank; ++dst) {
-    *os << "\t" << dst;
-  }
-  *os << endl;
-  for (int src = 0; src <= max_rank; ++src) {
-    *os << src;
-    for (int dst = 0; dst <= max_rank; ++dst) {
-      size_t byte_n = 0;
-      try {
-        byte_n = _totals.at({src,dst});
-      } catch (const std::out_of_range &e) {}
-      *os << "\t" << byte_n;
-    }
-    *os << endl;
-  }
+void TracerXml::post_compute_exec() {
+  ++_comp_epoch;
+  _writer->epoch_begin(_comp_epoch);
 }
 
-#if KNOB_XML_VERIFY
+Tracer::Live TracerXml::live() const {
+  Live lv;
+  lv.datas = _datas.size();
+  lv.tasks = _tasks.size();
+  lv.rdxns = _rdxn_teams.size();
+  lv.teams = _teams.size();
+  return lv;
+}
 
-void TracerXml::_event_define(uint64_t id, vector<uint64_t> &&deps) {
-  size_t dep_n_old = deps.size();
-  uniquify(deps);
-  if(deps.size() != dep_n_old)
-    _ok_dep_redundant = false;
+/* After the header Tracer writes:
+ *   xml <output offset> <comm_id_next> <comp_epoch> <rand state>
+ *   whatever the EventWriter saves
+ *   ops <n> then n lines of task note op names
+ *   datas <n> then per data:
+ *     <data id> <comm n> <task n>
+ *     <comm n> lines: <digest w0> <w1> <comm id>
+ *     <task n> lines: <task id> <rank> <op> <lev> <box>
+ *   teams <n> then n interned teams: <rank n> <ranks...>
+ *   rdxns <n> then n lines: <rdxn id> <team>
+ *   totals <n> then n lines: <src> <dst> <bytes> <msgs>
+ *   end
+ */
+void TracerXml::checkpoint_save(std::ostream &o) {
+  o << "xml " << _writer->offset() << ' ' << _comm_id_next << ' ' << _comp_epoch << ' ' << _rand_state << '\n';
+  _writer->checkpoint_save(o);
   
-  if(_events.count(id) != 0)
-    _ok_id_reused = false;
+  // op names by id, so notes survive a different interning order
+  uint32_t op_n = 0;
+  for(const auto &kv: _datas) {
+    kv.second.tasks.for_each([&](uint64_t task_id) {
+      op_n = std::max(op_n, _tasks[task_id].note.op + 1);
+    });
+  }
+  o << "ops " << op_n << '\n';
+  for(uint32_t op=0; op < op_n; op++)
+    o << TaskNote::name(op) << '\n';
   
-  for(uint64_t dep: deps) {
-    if(_events.count(dep) == 0) {
-      //cerr << "dep_not_defined id="<<id<<" dep="<<dep<<'\n';
-      _ok_dep_not_defined = false;
-    }
+  o << "datas " << _datas.size() << '\n';
+  for(const auto &kv: _datas) {
+    const Data &data = kv.second;
+    size_t task_n = 0;
+    data.tasks.for_each([&](uint64_t) { task_n += 1; });
     
-    _events[dep].sats.push_back(id);
+    o << kv.first << ' ' << data.comms.size() << ' ' << task_n << '\n';
+    for(const auto &comm: data.comms)
+      o << comm.first.w0 << ' ' << comm.first.w1 << ' ' << comm.second << '\n';
+    data.tasks.for_each([&](uint64_t task_id) {
+      const Task &t = _tasks[task_id];
+      o << task_id << ' ' << t.rank << ' ' << t.note.op << ' ' << t.note.lev << ' ' << t.note.box << '\n';
+    });
   }
   
-  _events[id] = Event{deps.size(), {}};
-  if(deps.size() == 0)
-    _ready.insert(id);
+  // the teams held by reductions, each once
+  vector<uint32_t> held;
+  {
+    vector<bool> seen;
+    for(const auto &kv: _rdxn_teams) {
+      if(kv.second >= seen.size())
+        seen.resize(kv.second + 1, false);
+      if(!seen[kv.second]) {
+        seen[kv.second] = true;
+        held.push_back(kv.second);
+      }
+    }
+  }
+  o << "teams " << held.size() << '\n';
+  for(uint32_t t: held) {
+    o << t << ' ' << _teams.ranks(t).size();
+    for(int rank: _teams.ranks(t))
+      o << ' ' << rank;
+    o << '\n';
+  }
+  
+  o << "rdxns " << _rdxn_teams.size() << '\n';
+  for(const auto &kv: _rdxn_teams)
+    o << kv.first << ' ' << kv.second << '\n';
+  
+  const vector<CommMatrixBuilder::Entry> &totals = _totals.entries();
+  o << "totals " << totals.size() << '\n';
+  for(const auto &e: totals)
+    o << e.src << ' ' << e.dst << ' ' << e.bytes << ' ' << e.msgs << '\n';
+  
+  o << "end\n";
 }
 
-bool TracerXml::verify() {
-  size_t exec_n = 0;
+void TracerXml::checkpoint_load(std::istream &i) {
+  uint64_t offset;
+  checkpoint_expect(i, "xml");
+  i >> offset >> _comm_id_next >> _comp_epoch >> _rand_state;
+  _writer->checkpoint_load(i, offset);
+  
+  uint32_t op_n;
+  checkpoint_expect(i, "ops");
+  i >> op_n;
+  i >> std::ws;
+  vector<uint32_t> ops(op_n);
+  for(uint32_t op=0; op < op_n; op++) {
+    string name;
+    std::getline(i, name);
+    ops[op] = TaskNote::intern(name);
+  }
   
-  while(_ready.size() != 0) {
-    uint64_t id = *_ready.begin();
-    _ready.erase(_ready.begin());
+  size_t data_n;
+  checkpoint_expect(i, "datas");
+  i >> data_n;
+  _datas.clear();
+  for(size_t d=0; d < data_n; d++) {
+    uint64_t data_id;
+    size_t comm_n, task_n;
+    i >> data_id >> comm_n >> task_n;
+    Data &data = _datas[data_id];
     
-    for(uint64_t sat: _events[id].sats) {
-      if(0 == --_events[sat].dep_n)
-        _ready.insert(sat);
+    for(size_t c=0; c < comm_n; c++) {
+      Digest<128> dig;
+      uint64_t comm_id;
+      i >> dig.w0 >> dig.w1 >> comm_id;
+      data.comms[dig] = comm_id;
+    }
+    for(size_t t=0; t < task_n; t++) {
+      uint64_t task_id;
+      Task task;
+      i >> task_id >> task.rank >> task.note.op >> task.note.lev >> task.note.box;
+      USER_ASSERT(i && task.note.op < op_n, "Bad checkpoint file: task table.");
+      task.note.op = ops[task.note.op];
+      _tasks[task_id] = task;
+      data.tasks.put(task_id);
     }
-    
-    exec_n += 1;
   }
   
-  bool ok = true;
-  
-  if(!_ok_dep_redundant)
-    cerr << "VERIFY FAILED: dependency list contains duplicate ids.\n";
-  ok = ok && _ok_dep_redundant;
-  
-  if(!_ok_id_reused)
-    cerr << "VERIFY FAILED: id reused.\n";
-  ok = ok && _ok_id_reused;
+  // saved ids needn't match the ones interning gives now, each
+  // reduction reinterns its team to hold its own reference
+  size_t team_n;
+  checkpoint_expect(i, "teams");
+  i >> team_n;
+  _teams.clear();
+  unordered_map<uint32_t,vector<int>> saved_teams;
+  for(size_t t=0; t < team_n; t++) {
+    uint32_t saved_id;
+    size_t rank_n;
+    i >> saved_id >> rank_n;
+    USER_ASSERT(i && saved_teams.count(saved_id) == 0, "Bad checkpoint file: team table.");
+    vector<int> &team = saved_teams[saved_id];
+    for(size_t r=0; r < rank_n && i; r++) {
+      int rank;
+      i >> rank;
+      team.push_back(rank);
+    }
+    USER_ASSERT(i, "Bad checkpoint file: team table.");
+  }
   
-  if(!_ok_dep_not_defined)
-    cerr << "VERIFY FAILED: dependency id not previosuly defined.\n";
-  ok = ok && _ok_dep_not_defined;
+  size_t rdxn_n;
+  checkpoint_expect(i, "rdxns");
+  i >> rdxn_n;
+  _rdxn_teams.clear();
+  for(size_t r=0; r < rdxn_n; r++) {
+    uint64_t rdxn_id;
+    uint32_t t;
+    i >> rdxn_id >> t;
+    auto got = saved_teams.find(t);
+    USER_ASSERT(i && got != saved_teams.end(), "Bad checkpoint file: reduction teams.");
+    _rdxn_teams[rdxn_id] = _teams.intern(got->second.data(), got->second.size());
+  }
   
-  if(exec_n != _events.size()) {
-    cerr << "VERIFY FAILED: cycle detected!\n";
-    ok = false;
+  size_t total_n;
+  checkpoint_expect(i, "totals");
+  i >> total_n;
+  _totals.clear();
+  for(size_t t=0; t < total_n; t++) {
+    int src, dst;
+    uint64_t bytes, msgs;
+    i >> src >> dst >> bytes >> msgs;
+    USER_ASSERT(i, "Bad checkpoint file: comm totals.");
+    _totals.add(src, dst, bytes, msgs);
   }
   
-  if(ok)
-    cerr << "VERIFY SUCCESS\n";
+  checkpoint_expect(i, "end");
   
-  return ok;
+  // events before the checkpoint were never defined here
+  _resumed = true;
+}
+
+void TracerXml::_dump_totals() {
+  ofstream ofs;
+  ostream *os;
+  if (_totals_file == "-") {
+    os = &std::cout;
+  } else {
+    ofs.open(_totals_file, ios::out | ios::binary);
+    os = &ofs;
+  }
+
+  if (_totals_format == "mtx")
+    _totals.build(_rank_n).write_mtx(*os);
+  else if (_totals_format == "csr")
+    _totals.build(_rank_n).write_csr(*os);
+  else // the dense table spans the ranks seen, as it always has
+    _totals.build().write_tsv(*os);
+  os->flush();
+}
+
+#if KNOB_XML_VERIFY
+
+// the verifier keeps two bits per id ever defined, which a streamed
+// trace of any length would outgrow, so streaming leaves checking to
+// verifyevents on the finished trace
+void TracerXml::_event_define(uint64_t id, const uint64_t *dep_ids, size_t dep_n) {
+  if(!flag_stream)
+    _verifier.define(id, dep_ids, dep_n);
+}
+
+bool TracerXml::verify() {
+  if(_resumed) {
+    cerr << "VERIFY SKIPPED: resumed from a checkpoint.\n";
+    return true;
+  }
+  if(flag_stream) {
+    cerr << "VERIFY SKIPPED: streaming, check the trace with verifyevents.\n";
+    return true;
+  }
+  return _verifier.counts().report(cerr);
 }
 
 #else
 
-void TracerXml::_event_define(uint64_t id, vector<uint64_t> &&deps) {}
+void TracerXml::_event_define(uint64_t id, const uint64_t *dep_ids, size_t dep_n) {}
 bool TracerXml::verify() { return true; }
 
 #endif
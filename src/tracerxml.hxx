@@ -2,9 +2,15 @@
 #define _3126fdfc_a126_464d_8960_b6d102baedcc
 
 # include "tracer.hxx"
+# include "eventwriter.hxx"
+# include "verifier.hxx"
+# include "teamtable.hxx"
+# include "commmatrix.hxx"
+# include "lowlevel/idmap.hxx"
 # include "lowlevel/intset.hxx"
 # include "lowlevel/digest.hxx"
 
+# include <memory>
 # include <unordered_map>
 # include <unordered_set>
 
@@ -16,20 +22,36 @@ namespace programr {
     };
     struct Task {
       int rank;
-      std::string note;
+      TaskNote note;
     };
     int _rank_n;
     std::uint64_t _comm_id_next;
     std::unordered_map<std::uint64_t,Data> _datas;
-    std::unordered_map<std::uint64_t,Task> _tasks;
-    std::ostream *_file;
+    IdMap<Task> _tasks;
+    // which ranks participate in a reduction: reduction -> team id, each
+    // holding its team until retire_rdxn()
+    TeamTable _teams;
+    std::unordered_map<std::uint64_t,std::uint32_t> _rdxn_teams;
+    std::unique_ptr<EventWriter> _writer;
     bool _flag_totals;
-    const std::string _totals_file  = "comm_totals.tsv";
-    std::unordered_map<std::pair<int, int>, size_t> _totals;
+    // commtotals_format: tsv (dense), mtx or csr, see commmatrix.hxx
+    std::string _totals_format;
+    std::string _totals_file;
+    CommMatrixBuilder _totals;
     std::uint64_t _comp_epoch;
+    // picks the senders of control messages, kept here rather than in
+    // rand() so a checkpoint can save it and nothing else perturbs it
+    std::uint64_t _rand_state = 0x853c49e6748fea9bu;
+    bool _resumed = false;
+    // reused by each task to avoid allocating
+    std::vector<std::uint64_t> _scratch_deps, _scratch_comm_deps, _scratch_rdxns;
+    std::vector<int> _scratch_team;
   
   public:
+    // writes events.xml to `file`
     TracerXml(int rank_n, std::ostream *file);
+    // writes events through `writer`, taking ownership
+    TracerXml(int rank_n, EventWriter *writer);
     ~TracerXml();
     
     void task(
@@ -38,10 +60,15 @@ namespace programr {
       std::uint64_t data_id,
       const std::vector<TaskDepTask> &dep_tasks,
       const std::vector<std::uint64_t> &dep_rdxns,
-      std::string note,
+      TaskNote note,
       double seconds
     );
     
+    void task_batch(
+      const Tasks &tasks,
+      const std::vector<std::uint64_t> &dep_rdxns
+    );
+    
     void reduction(
       std::uint64_t rdxn_id,
       std::size_t bytes,
@@ -50,28 +77,38 @@ namespace programr {
     );
     
     void retire(std::uint64_t data_id);
+    void retire_rdxn(std::uint64_t rdxn_id) override;
 
     void post_compute_exec() override;
+    Live live() const override;
+    
+    // saves the output offset, the comm dedup tables and what is known of
+    // live tasks and reduction teams. load() truncates nothing, it just
+    // seeks the output back to the saved offset.
+    void checkpoint_save(std::ostream &o) override;
+    void checkpoint_load(std::istream &i) override;
 
   private:
 # if KNOB_XML_VERIFY
-    struct Event {
-      std::size_t dep_n;
-      std::vector<std::uint64_t> sats;
-    };
-    
-    std::unordered_map<std::uint64_t, Event> _events;
-    std::unordered_set<std::uint64_t> _ready;
-    bool _ok_id_reused = true;
-    bool _ok_dep_not_defined = true;
-    bool _ok_dep_redundant = true;
-# endif    
+    EventVerifier _verifier;
+# endif
     
     void _log_comm(int src, int dst, size_t byte_n) {
-      _totals[{src,dst}] += byte_n;
+      _totals.add(src, dst, byte_n);
     }
     void _dump_totals();
-    void _event_define(std::uint64_t id, std::vector<uint64_t> &&deps);
+    bool _rank_in_rdxn_team(std::uint64_t rdxn_id, std::uint64_t rank);
+    std::uint64_t _rand_team_rank(std::uint64_t rdxn_id);
+    void _task(
+      std::uint64_t task_id,
+      int rank,
+      Data &data,
+      const TaskDepTask *dep_tasks, std::size_t dep_n,
+      const std::vector<std::uint64_t> &dep_rdxns,
+      TaskNote note,
+      double seconds
+    );
+    void _event_define(std::uint64_t id, const std::uint64_t *deps, std::size_t dep_n);
     
   public:
     bool verify();
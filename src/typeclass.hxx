@@ -2,6 +2,7 @@
 #define _b61286c5_ccd4_4f8b_b1fc_fd318d666f5e
 
 # include <array>
+# include <functional>
 # include <utility>
 # include <tuple>
 # include <type_traits>
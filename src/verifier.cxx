@@ -0,0 +1,183 @@
+#include "verifier.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  inline bool bit_get(const vector<uint64_t> &bits, uint64_t i) {
+    return (i >> 6) < bits.size() && (bits[i >> 6] >> (i & 63) & 1);
+  }
+
+  inline void bit_set(vector<uint64_t> &bits, uint64_t i) {
+    if((i >> 6) >= bits.size())
+      bits.resize(std::max((i >> 6) + 1, 2*bits.size()), 0);
+    bits[i >> 6] |= uint64_t(1) << (i & 63);
+  }
+
+  // true if `deps` lists some id twice, `scratch` is clobbered
+  bool has_repeat(const uint64_t *deps, size_t dep_n, vector<uint64_t> &scratch) {
+    if(dep_n < 2)
+      return false;
+    if(dep_n == 2)
+      return deps[0] == deps[1];
+    scratch.assign(deps, deps + dep_n);
+    std::sort(scratch.begin(), scratch.end());
+    return std::adjacent_find(scratch.begin(), scratch.end()) != scratch.end();
+  }
+}
+
+bool VerifyCounts::report(ostream &o) const {
+  if(dep_repeated_n != 0)
+    o << "VERIFY FAILED: dependency list contains duplicate ids (" << dep_repeated_n << " events).\n";
+  if(id_reused_n != 0)
+    o << "VERIFY FAILED: id reused (" << id_reused_n << " events).\n";
+  if(dep_undefined_n != 0)
+    o << "VERIFY FAILED: dependency id not previously defined (" << dep_undefined_n << " deps).\n";
+  if(stuck_n != 0)
+    o << "VERIFY FAILED: cycle detected! " << stuck_n << " of " << event_n << " events can never run.\n";
+  if(ok())
+    o << "VERIFY SUCCESS\n";
+  return ok();
+}
+
+////////////////////////////////////////////////////////////////////////
+// EventVerifier
+
+void EventVerifier::define(uint64_t id, const uint64_t *deps, size_t dep_n) {
+  if(has_repeat(deps, dep_n, _scratch))
+    _counts.dep_repeated_n += 1;
+
+  if(bit_get(_defined, id)) {
+    _counts.id_reused_n += 1;
+    return;
+  }
+  _counts.event_n += 1;
+
+  // undefined deps are already failures, like verify_event_graph they
+  // don't also hold the event back
+  bool ready = true;
+  for(size_t i=0; i < dep_n; i++) {
+    if(!bit_get(_defined, deps[i]))
+      _counts.dep_undefined_n += 1;
+    else
+      ready = ready && bit_get(_ready, deps[i]);
+  }
+
+  bit_set(_defined, id);
+  if(ready) {
+    bit_set(_ready, id);
+    _ready_n += 1;
+  }
+}
+
+VerifyCounts EventVerifier::counts() const {
+  VerifyCounts c = _counts;
+  c.stuck_n = c.event_n - _ready_n;
+  return c;
+}
+
+VerifyCounts programr::verify_event_graph(const EventGraph &g, Workers &pool) {
+  const size_t n = g.size();
+  const size_t grain = 1024;
+  const int64_t none = -1;
+  VerifyCounts c;
+
+  // event index by id, first definition wins
+  vector<int64_t> ix = g.index_by_id();
+  vector<bool> live(n, false);
+  for(size_t i=0; i < n; i++) {
+    if(ix[g.ids[i]] == int64_t(i)) {
+      live[i] = true;
+      c.event_n += 1;
+    }
+    else
+      c.id_reused_n += 1;
+  }
+
+  auto dep_ix = [&](uint64_t dep)->int64_t {
+    return dep < ix.size() ? ix[dep] : none;
+  };
+
+  // waits = defined deps, and per worker problem counts
+  unique_ptr<atomic<uint32_t>[]> waits(new atomic<uint32_t>[n]);
+  vector<VerifyCounts> wc(pool.size());
+  pool.parallel_for(n, grain, [&](size_t i, int w) {
+    thread_local vector<uint64_t> scratch;
+    const uint64_t *deps = g.deps.data() + g.dep_at[i];
+    size_t dep_n = g.dep_at[i+1] - g.dep_at[i];
+
+    if(has_repeat(deps, dep_n, scratch))
+      wc[w].dep_repeated_n += 1;
+
+    uint32_t defined = 0;
+    for(size_t d=0; d < dep_n; d++) {
+      if(dep_ix(deps[d]) == none)
+        wc[w].dep_undefined_n += 1;
+      else
+        defined += 1;
+    }
+    waits[i].store(defined, memory_order_relaxed);
+  });
+  for(const VerifyCounts &x: wc) {
+    c.dep_repeated_n += x.dep_repeated_n;
+    c.dep_undefined_n += x.dep_undefined_n;
+  }
+
+  // who waits on each event, CSR like the deps
+  vector<size_t> sat_at(n+1, 0);
+  for(size_t i=0; i < n; i++) {
+    for(size_t d=g.dep_at[i]; d < g.dep_at[i+1]; d++) {
+      int64_t j = dep_ix(g.deps[d]);
+      if(j != none)
+        sat_at[j+1] += 1;
+    }
+  }
+  for(size_t i=0; i < n; i++)
+    sat_at[i+1] += sat_at[i];
+  vector<uint64_t> sats(sat_at[n]);
+  {
+    vector<size_t> fill(sat_at.begin(), sat_at.end()-1);
+    for(size_t i=0; i < n; i++) {
+      for(size_t d=g.dep_at[i]; d < g.dep_at[i+1]; d++) {
+        int64_t j = dep_ix(g.deps[d]);
+        if(j != none)
+          sats[fill[j]++] = i;
+      }
+    }
+  }
+
+  // topological walk, a frontier at a time
+  vector<uint64_t> frontier;
+  for(size_t i=0; i < n; i++) {
+    if(live[i] && waits[i].load(memory_order_relaxed) == 0)
+      frontier.push_back(i);
+  }
+
+  uint64_t ran_n = 0;
+  vector<vector<uint64_t>> next(pool.size());
+  while(!frontier.empty()) {
+    ran_n += frontier.size();
+
+    pool.parallel_for(frontier.size(), grain, [&](size_t f, int w) {
+      uint64_t i = frontier[f];
+      for(size_t s=sat_at[i]; s < sat_at[i+1]; s++) {
+        uint64_t j = sats[s];
+        if(live[j] && 1 == waits[j].fetch_sub(1, memory_order_acq_rel))
+          next[w].push_back(j);
+      }
+    });
+
+    frontier.clear();
+    for(vector<uint64_t> &x: next) {
+      frontier.insert(frontier.end(), x.begin(), x.end());
+      x.clear();
+    }
+  }
+
+  c.stuck_n = c.event_n - ran_n;
+  return c;
+}
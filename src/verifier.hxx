@@ -0,0 +1,52 @@
+#ifndef _075fab77_6188_43dd_b011_f70e818cc8e3
+#define _075fab77_6188_43dd_b011_f70e818cc8e3
+
+# include "eventgraph.hxx"
+# include "lowlevel/workers.hxx"
+
+# include <cstdint>
+# include <iostream>
+# include <string>
+# include <vector>
+
+/* Checks that an event trace is a well formed dependency graph: no id
+ * defined twice, no dependency listed twice by one event, every
+ * dependency defined, and no cycles. Event ids are dense (3*n+kind), so
+ * everything is kept in arrays indexed by id rather than hash tables.
+ */
+namespace programr {
+  struct VerifyCounts {
+    std::uint64_t event_n = 0;
+    std::uint64_t id_reused_n = 0; // events whose id was already defined
+    std::uint64_t dep_repeated_n = 0; // events listing a dep more than once
+    std::uint64_t dep_undefined_n = 0; // deps naming no event
+    std::uint64_t stuck_n = 0; // events that can never run
+
+    bool ok() const {
+      return id_reused_n == 0 && dep_repeated_n == 0 && dep_undefined_n == 0 && stuck_n == 0;
+    }
+    // prints "VERIFY SUCCESS" or a "VERIFY FAILED" line per problem,
+    // returns ok()
+    bool report(std::ostream &o) const;
+  };
+
+  // Verifies events as they are emitted. An event must only depend on
+  // events defined before it, so an event can run once all its deps can,
+  // and counting those as they're defined is the whole topological walk.
+  // Costs two bits per id.
+  class EventVerifier {
+    std::vector<std::uint64_t> _defined, _ready; // bit per id
+    std::vector<std::uint64_t> _scratch;
+    VerifyCounts _counts;
+    std::uint64_t _ready_n = 0;
+
+  public:
+    void define(std::uint64_t id, const std::uint64_t *deps, std::size_t dep_n);
+    VerifyCounts counts() const;
+  };
+
+  // Verifies a whole graph, in any event order. Cycles are found with a
+  // topological walk run frontier by frontier over `pool`.
+  VerifyCounts verify_event_graph(const EventGraph &graph, Workers &pool);
+}
+#endif
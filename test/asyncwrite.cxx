@@ -0,0 +1,110 @@
+#include "lowlevel/asyncwrite.hxx"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  // accepts the first `limit` bytes written, fails on any more
+  struct FailingBuf: streambuf {
+    size_t limit, got = 0;
+
+    FailingBuf(size_t limit): limit(limit) {}
+
+    streamsize xsputn(const char *s, streamsize n) {
+      streamsize ok = std::min<streamsize>(n, limit - got);
+      got += ok;
+      return ok;
+    }
+    int_type overflow(int_type c) {
+      if(got == limit)
+        return traits_type::eof();
+      got += 1;
+      return traits_type::not_eof(c);
+    }
+  };
+
+  // the same writes and seeks, as resume and the trace writers make them
+  void scribble(ostream &o) {
+    uint64_t x = 99;
+    auto next = [&]() { x = x*6364136223846793005u + 1442695040888963407u; return x >> 33; };
+
+    for(int i=0; i < 2000; i++) {
+      switch(next() % 4) {
+      case 0:
+        o << "event " << i << '\n';
+        break;
+      case 1: // larger than several buffers at once
+        o << string(next() % 300, char('a' + i % 26));
+        break;
+      case 2:
+        o.put(char(i));
+        break;
+      case 3:
+        if(i % 50 == 0) {
+          // rewind_to: find the end, go back, overwrite from there
+          o.flush();
+          o.seekp(0, ios::end);
+          streamoff end = o.tellp();
+          o.seekp(end - streamoff(next() % (end + 1)));
+        }
+        break;
+      }
+    }
+  }
+}
+
+int main() {
+  stringstream direct;
+  scribble(direct);
+
+  for(size_t buf_bytes: {1, 7, 64, 4096}) {
+    for(int buf_n: {2, 3, 8}) {
+      stringbuf target;
+      streamoff end;
+      {
+        AsyncWriteBuf abuf(&target, buf_bytes, buf_n);
+        ostream o(&abuf);
+        scribble(o);
+        end = o.tellp();
+        if(!o)
+          cout << "BAD bytes=" << buf_bytes << " n=" << buf_n << " stream failed\n";
+        // anything still buffered is written by the destructor
+      }
+      if(end != streamoff(direct.tellp()))
+        cout << "BAD bytes=" << buf_bytes << " n=" << buf_n << " tellp=" << end << '\n';
+      if(target.str() != direct.str())
+        cout << "BAD bytes=" << buf_bytes << " n=" << buf_n << " output differs\n";
+    }
+  }
+
+  // a target that fails partway: flushing before destruction, as main
+  // does, reports it even when the failing bytes were the last buffered
+  for(size_t limit: {size_t(0), size_t(10), size_t(1000)}) {
+    for(size_t buf_bytes: {16, 1<<20}) {
+      FailingBuf target(limit);
+      {
+        AsyncWriteBuf abuf(&target, buf_bytes, 2);
+        ostream o(&abuf);
+        o << string(limit + 1, 'x');
+        o.flush();
+        if(o)
+          cout << "BAD limit=" << limit << " bytes=" << buf_bytes << " flush missed the failure\n";
+        // later writes keep failing rather than hanging
+        o.clear();
+        o << string(100, 'y');
+        o.flush();
+        if(o)
+          cout << "BAD limit=" << limit << " bytes=" << buf_bytes << " write after failure succeeded\n";
+      }
+      if(target.got != limit)
+        cout << "BAD limit=" << limit << " got=" << target.got << '\n';
+    }
+  }
+
+  cout << "done\n";
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include "eventwriter.hxx"
+
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  // writes the same pseudo random events to `w`
+  void write_events(EventWriter &w, int event_n) {
+    const double times[] = {0, 1, 2.5e-06, 3.14159265, 1e6, -0.0, 0.1};
+    const uint32_t ops[] = {TaskNote::intern("relax"), TaskNote::intern("restrict <2>")};
+    uint64_t x = 777;
+    auto next = [&]() { x = x*6364136223846793005u + 1442695040888963407u; return x >> 33; };
+
+    vector<uint64_t> deps;
+    vector<int> team;
+    for(int n=0; n < event_n; n++) {
+      int kind = next() % 3;
+      uint64_t id = 3*uint64_t(n) + kind;
+      uint64_t epoch = n/7 + (next() % 3 == 0); // mostly rising, sometimes back
+
+      deps.clear();
+      for(int d = next() % 5; d != 0; d--)
+        deps.push_back(next() % (id + 1));
+
+      if(kind == 0)
+        w.comm(id, deps.data(), deps.size(), int(next() % 64), int(next() % 64), next() % 100000, epoch);
+      else if(kind == 1) {
+        double secs = n % 4 == 0 ? double(next() % 1000)/7 : times[next() % 7];
+        TaskNote note{ops[n % 2], int(next() % 4) - 1, int(next() % 1000)};
+        w.comp(id, deps.data(), deps.size(), int(next() % 64), secs, epoch, n % 3 == 0 ? nullptr : &note);
+      }
+      else {
+        // a handful of distinct teams so most colls repeat one
+        team.clear();
+        for(int t = next() % 4; t >= 0; t--)
+          team.push_back(int(next() % 4)*16 + t);
+        w.coll(id, deps.data(), deps.size(), team.data(), team.size(), next() % 64, epoch);
+      }
+    }
+    w.finish();
+  }
+
+  bool to_xml(const string &bin, string &xml, string &err) {
+    istringstream in(bin);
+    ostringstream out;
+    XmlEventWriter w(&out);
+    bool ok = read_binary_events(in, w, err);
+    xml = out.str();
+    return ok;
+  }
+}
+
+int main() {
+  for(int event_n: {0, 1, 100, 20000}) {
+    ostringstream want, bin;
+    { XmlEventWriter w(&want); write_events(w, event_n); }
+    { BinaryEventWriter w(&bin); write_events(w, event_n); }
+
+    string xml, err;
+    if(!to_xml(bin.str(), xml, err))
+      cout << "BAD n=" << event_n << " read failed: " << err << '\n';
+    else if(xml != want.str())
+      cout << "BAD n=" << event_n << " converted trace differs\n";
+  }
+
+  ostringstream bin;
+  { BinaryEventWriter w(&bin); write_events(w, 300); }
+  const string good = bin.str();
+  string xml, err;
+
+  // every truncation fails cleanly
+  for(size_t n=0; n < good.size(); n++) {
+    if(to_xml(good.substr(0, n), xml, err) || err.empty())
+      cout << "BAD accepted truncation at " << n << '\n';
+  }
+
+  // a comm whose dep count claims far more deps than there are bytes
+  const size_t header_n = 40;
+  string huge = good.substr(0, header_n);
+  huge += char(BinaryEventWriter::tag_comm);
+  huge += char(0); // id
+  huge += string(9, char(0xff)) + char(0x01); // dep count of 2^64-1
+  huge += string(100, char(0));
+  huge += char(BinaryEventWriter::tag_end);
+  if(to_xml(huge, xml, err) || err != "truncated record")
+    cout << "BAD huge dep count: " << err << '\n';
+
+  // likewise a new team with a huge rank count, and a rank past int
+  string team = good.substr(0, header_n);
+  team += char(BinaryEventWriter::tag_coll);
+  team += string(2, char(0)); // id, no deps
+  team += char(0); // new team
+  team += string(8, char(0xff)) + char(0x7f);
+  team += string(100, char(0));
+  if(to_xml(team, xml, err) || err != "truncated record")
+    cout << "BAD huge team: " << err << '\n';
+
+  string rank = good.substr(0, header_n);
+  rank += char(BinaryEventWriter::tag_comm);
+  rank += string(2, char(0)); // id, no deps
+  rank += string(5, char(0xff)) + char(0x01); // from 2^42-1
+  rank += string(3, char(0));
+  rank += char(BinaryEventWriter::tag_end);
+  if(to_xml(rank, xml, err) || err != "truncated record")
+    cout << "BAD huge rank: " << err << '\n';
+
+  cout << "done\n";
+  return 0;
+}
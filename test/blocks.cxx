@@ -0,0 +1,176 @@
+#include "blockwriter.hxx"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  const char *idx_file = "blocks.test.idx";
+  const int epoch_n = 60;
+
+  // what TracerXml sends a writer over `epoch_n` compute epochs: comms
+  // and colls stamped with the compute epoch, comps with the next one
+  void trace(EventWriter &w) {
+    uint64_t x = 7;
+    auto next = [&]() { x = x*6364136223846793005u + 1442695040888963407u; return x >> 33; };
+    uint64_t id = 0;
+    int team[4] = {0, 3, 5, 6};
+
+    for(uint64_t c=0; c < epoch_n; c++) {
+      if(c != 0)
+        w.epoch_begin(c);
+      // some epochs are empty, some bigger than a block
+      int n = c % 7 == 3 ? 0 : c % 11 == 5 ? 80 : int(next() % 12);
+      for(int i=0; i < n; i++, id++) {
+        uint64_t dep = id / 2;
+        switch(next() % 3) {
+        case 0: w.comm(3*id + 1, &dep, id != 0, int(next() % 8), int(next() % 8), 64, c); break;
+        case 1: w.comp(3*id, &dep, id != 0, int(next() % 8), 0.5, c + 1, nullptr); break;
+        case 2: w.coll(3*id + 2, &dep, id != 0, team, 1 + next() % 4, 8, c); break;
+        }
+      }
+    }
+    w.finish();
+  }
+
+  // `xml`'s events with an epoch in [lo,hi]
+  string window(const string &xml, uint64_t lo, uint64_t hi) {
+    istringstream in(xml);
+    string line, got = "<events>\n";
+    while(getline(in, line)) {
+      size_t at = line.find(" epoch=\"");
+      if(at == string::npos)
+        continue;
+      uint64_t e = strtoull(line.c_str() + at + 8, nullptr, 10);
+      if(lo <= e && e <= hi)
+        got += line + '\n';
+    }
+    return got + "</events>\n";
+  }
+
+  // true if reading `file`'s blocks aborts, as USER_ASSERT does
+  bool read_aborts(const string &file) {
+    pid_t pid = fork();
+    if(pid == 0) {
+      int null = open("/dev/null", O_WRONLY);
+      dup2(null, 2);
+      istringstream in(file);
+      string err, raw;
+      uint64_t epoch;
+      read_block_header(in, err);
+      while(read_block(in, raw, epoch, err)) {}
+      _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+  }
+
+  void put_u32(string &s, size_t at, uint32_t x) {
+    for(int b=0; b < 4; b++)
+      s[at + b] = char(x >> 8*b);
+  }
+}
+
+int main() {
+  ostringstream plain;
+  {
+    XmlEventWriter w(&plain);
+    trace(w);
+  }
+
+  ostringstream packed;
+  {
+    BlockEventWriter w(&packed, idx_file, 1500);
+    trace(w);
+  }
+  const string file = packed.str();
+
+  vector<BlockIndexEntry> blocks;
+  string err;
+  {
+    ifstream idx(idx_file);
+    if(!read_block_index(idx, blocks, err))
+      cout << "BAD index: " << err << '\n';
+  }
+  if(blocks.size() < 5)
+    cout << "BAD only " << blocks.size() << " blocks\n";
+
+  // the whole file decompresses to the plain trace
+  {
+    istringstream in(file);
+    string raw, all;
+    uint64_t epoch;
+    size_t b = 0;
+    if(!read_block_header(in, err))
+      cout << "BAD header: " << err << '\n';
+    for(; b < blocks.size(); b++) {
+      if(uint64_t(in.tellg()) != blocks[b].offset)
+        cout << "BAD block " << b << " offset\n";
+      if(!read_block(in, raw, epoch, err) || epoch != blocks[b].epoch || raw.size() != blocks[b].raw_n)
+        cout << "BAD block " << b << ": " << err << '\n';
+      all += raw;
+    }
+    if(read_block(in, raw, epoch, err) || !err.empty())
+      cout << "BAD end of file: " << err << '\n';
+    if(all != plain.str())
+      cout << "BAD round trip differs\n";
+  }
+
+  // every window of up to 4 epochs, and the whole range, gives just its
+  // events. many cross a block boundary, and some start or end on one.
+  vector<pair<uint64_t,uint64_t>> windows = {{0, epoch_n + 1}, {epoch_n + 5, epoch_n + 9}};
+  for(uint64_t lo=0; lo <= epoch_n + 1; lo++) {
+    for(uint64_t hi=lo; hi < lo + 4; hi++)
+      windows.push_back({lo, hi});
+  }
+  for(size_t b=1; b < blocks.size(); b++)
+    windows.push_back({blocks[b-1].epoch + 1, blocks[b].epoch + 1});
+
+  for(const auto &w: windows) {
+    istringstream in(file);
+    ostringstream out;
+    if(!read_block_window(in, blocks, w.first, w.second, out, err))
+      cout << "BAD window " << w.first << ' ' << w.second << ": " << err << '\n';
+    else if(out.str() != window(plain.str(), w.first, w.second))
+      cout << "BAD window " << w.first << ' ' << w.second << " events differ\n";
+  }
+
+  // a block claiming more than the file holds, or sizes no block could
+  // have, is refused before allocating for it
+  const size_t head = BlockEventWriter::header_bytes;
+  {
+    string bad = file;
+    put_u32(bad, head + 4, blocks[0].packed_n + uint32_t(file.size()));
+    put_u32(bad, head, 200*(blocks[0].packed_n + uint32_t(file.size())));
+    if(!read_aborts(bad))
+      cout << "BAD accepted block past the end\n";
+    bad = file;
+    put_u32(bad, head, 0xffffffffu);
+    if(!read_aborts(bad))
+      cout << "BAD accepted 4GB block\n";
+    bad = file;
+    put_u32(bad, head, 1u << 20);
+    if(!read_aborts(bad))
+      cout << "BAD accepted raw size packed data can't reach\n";
+    if(read_aborts(file))
+      cout << "BAD refused a good file\n";
+  }
+
+  std::remove(idx_file);
+
+  cout << "done\n";
+  return 0;
+}
@@ -0,0 +1,61 @@
+#include "tracer.hxx"
+
+#include <iostream>
+
+using namespace programr;
+using namespace std;
+
+struct Num: Result {
+  int val;
+  Num(int val): val(val) {}
+  void datas(std::vector<Data*> &add_to) const {}
+};
+
+// a chain of n continuations ending in `val`
+Ex<Num> countdown(int n, int val) {
+  if(n == 0)
+    return ex_result(Ref<Num>(new Num(val)));
+  return ex_meta<Num>({}, [=](const MetaEnv &env) {
+    return countdown(n-1, val);
+  });
+}
+
+// `n` chains consumed by one expr summing their results
+Ex<Num> fan_in(int n, int len) {
+  vector<Ref<Expr>> deps;
+  for(int i=0; i < n; i++)
+    deps.push_back(countdown(len + i, i));
+
+  return ex_meta<Num>(deps, [=](const MetaEnv &env) {
+    int sum = 0;
+    for(const Ref<Expr> &d: deps)
+      sum += env[Ex<Num>(d)]->val;
+    return ex_result(Ref<Num>(new Num(sum)));
+  });
+}
+
+int main() {
+  for(bool elim: {false, true}) {
+    for(int len: {1, 2, 10, 1000}) {
+      TracerStdout tr;
+      tr.flag_chain_elim = elim;
+
+      Ex<Num> root = fan_in(4, len);
+      tr.run(root);
+
+      int want = 0+1+2+3;
+      if(!root.result() || root.result()->val != want)
+        cout << "BAD elim=" << elim << " len=" << len << " result\n";
+
+      if(!elim && tr.chain_hops_removed != 0)
+        cout << "BAD elim=0 len=" << len << " hops=" << tr.chain_hops_removed << '\n';
+      if(elim && len >= 10 && tr.chain_hops_removed == 0)
+        cout << "BAD elim=1 len=" << len << " no hops removed\n";
+
+      cout << "elim=" << elim << " len=" << len << " hops_removed=" << tr.chain_hops_removed << '\n';
+    }
+  }
+
+  cout << "done\n";
+  return 0;
+}
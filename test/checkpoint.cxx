@@ -0,0 +1,163 @@
+#include "tracerxml.hxx"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  const int rank_n = 4;
+  const char *ckpt_file = "checkpoint.test.ckpt";
+
+  struct Step: Result {
+    Ref<Data> data;
+    vector<uint64_t> tasks; // by rank
+
+    void datas(vector<Data*> &add_to) const {
+      add_to.push_back(data);
+    }
+  };
+
+  // one compute epoch: a task per rank reading the previous step's task
+  // on the next rank
+  struct Expr_Step: Expr {
+    Ref<Expr> prev;
+    int k;
+
+    Expr_Step(Ref<Expr> prev, int k): prev(std::move(prev)), k(k) {}
+
+    void subexs(vector<Expr*> &add_to) const {
+      if(prev)
+        add_to.push_back(prev);
+    }
+
+    void show(ostream &o) const {
+      o << "Expr_Step(" << k << ")";
+    }
+
+    void execute(ExecCxt &cxt) {
+      Step *p = prev ? static_cast<Step*>((Result*)prev->result) : nullptr;
+      Ref<Step> s = new Step;
+      s->data = new Data;
+
+      for(int rank=0; rank < rank_n; rank++) {
+        vector<Dependency> deps;
+        if(p) {
+          Digest<128> dig;
+          dig.w0 = k;
+          dig.w1 = rank % 2;
+          deps.push_back({p->tasks[(rank + 1) % rank_n], dig, size_t(8*(k % 5 + 1))});
+        }
+        TaskNote note{TaskNote::intern("step"), 0, rank};
+        s->tasks.push_back(cxt.task(rank, s->data->id, deps, note, 1.0 + k % 3));
+      }
+
+      this->result = s;
+      this->prev = nullptr; // prune
+    }
+  };
+
+  // a reduction among the ranks 0 and 1 of a step, passing the step on
+  struct Expr_Reduce: Expr {
+    Ref<Expr> step;
+
+    Expr_Reduce(Ref<Expr> step): step(std::move(step)) {}
+
+    void subexs(vector<Expr*> &add_to) const {
+      add_to.push_back(step);
+    }
+
+    void show(ostream &o) const {
+      o << "Expr_Reduce";
+    }
+
+    void execute(ExecCxt &cxt) {
+      Step *s = static_cast<Step*>((Result*)step->result);
+      cxt.reduction(8, {s->tasks[0], s->tasks[1]});
+      this->result = s;
+      this->step = nullptr; // prune
+    }
+  };
+
+  // the trace of `step_n` steps. with `resume` it is written over `text`
+  // from the checkpoint, otherwise from scratch, checkpointing every
+  // `every` epochs if nonzero.
+  string trace(int step_n, int every, bool resume, string text="") {
+    // as though each run were a fresh process
+    Data::_id_next = 0;
+
+    stringstream out(text, ios::in | ios::out | ios::binary);
+    streamoff end;
+    {
+      TracerXml tr(rank_n, new XmlEventWriter(&out));
+      tr.checkpoint_every = every;
+      tr.checkpoint_file = ckpt_file;
+      tr.flag_resume = resume;
+
+      Ref<Expr> x;
+      // every third step is reduced, so the next step's tasks on ranks 2
+      // and 3 are sent control messages from a randomly picked member
+      for(int k=0; k < step_n; k++) {
+        x = new Expr_Step(x, k);
+        if(k % 3 == 0)
+          x = new Expr_Reduce(x);
+      }
+      tr.run(x);
+
+      if(!resume && !tr.verify())
+        cout << "BAD verify every=" << every << '\n';
+    }
+    end = out.tellp();
+    return out.str().substr(0, end);
+  }
+
+  // the output offset saved in the checkpoint
+  uint64_t ckpt_offset() {
+    ifstream i(ckpt_file);
+    string line;
+    while(getline(i, line)) {
+      if(line.compare(0, 4, "xml ") == 0)
+        return std::stoull(line.substr(4));
+    }
+    return 0;
+  }
+}
+
+int main() {
+  const int step_n = 40;
+  string whole = trace(step_n, 0, false);
+  if(whole.find("<coll") == string::npos || whole.find("size=\"0\"") == string::npos)
+    cout << "BAD trace lacks colls or control messages\n";
+
+  for(int every: {1, 7, 25, 39}) {
+    // the only checkpoint left is the last one made
+    string ckpted = trace(step_n, every, false);
+    if(ckpted != whole)
+      cout << "BAD every=" << every << " checkpointing changed the trace\n";
+
+    uint64_t offset = ckpt_offset();
+    if(offset == 0 || offset > whole.size())
+      cout << "BAD every=" << every << " offset=" << offset << '\n';
+
+    // as if killed somewhere after the checkpoint, with later output
+    // partly written, or written over with garbage
+    for(uint64_t cut: {offset, (offset + whole.size())/2, uint64_t(whole.size())}) {
+      string crashed = ckpted.substr(0, cut);
+      if(cut == whole.size())
+        crashed.replace(offset, cut - offset, cut - offset, '#');
+
+      string resumed = trace(step_n, every, true, crashed);
+      if(resumed != whole)
+        cout << "BAD every=" << every << " cut=" << cut << " resumed trace differs\n";
+    }
+  }
+
+  std::remove(ckpt_file);
+
+  cout << "done\n";
+  return 0;
+}
@@ -0,0 +1,118 @@
+#include "commmatrix.hxx"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  // serves `data` with no seeking, like a pipe
+  struct PipeBuf: streambuf {
+    string data;
+    PipeBuf(string d): data(std::move(d)) {
+      setg(&data[0], &data[0], &data[0] + data.size());
+    }
+  };
+
+  void put_at(string &csr, size_t at, uint64_t x, int byte_n) {
+    for(int b=0; b < byte_n; b++)
+      csr[at + b] = char(x >> 8*b);
+  }
+
+  // offsets into a written csr: header, then row_at, then cols
+  const size_t nnz_at = 24, row_at_at = 32;
+  size_t cols_at(int rank_n) { return row_at_at + 8*(rank_n + 1); }
+
+  void expect_bad(const string &what, const string &csr, const string &want) {
+    CommMatrix m;
+    string err;
+    istringstream in(csr);
+    if(CommMatrix::read_csr(in, m, err) || err.find(want) == string::npos)
+      cout << "BAD accepted " << what << " (" << err << ")\n";
+    PipeBuf pb(csr);
+    istream pipe(&pb);
+    err = "";
+    if(CommMatrix::read_csr(pipe, m, err) || err.find(want) == string::npos)
+      cout << "BAD accepted piped " << what << " (" << err << ")\n";
+  }
+}
+
+int main() {
+  // enough repeats of a few pairs to compact many times
+  CommMatrixBuilder a, b;
+  for(int i=0; i < 10000; i++) {
+    a.add(i % 3, (i + 1) % 3, 10);
+    b.add(5, 0, 1);
+  }
+  a.merge(b);
+  if(a.entries().size() != 4)
+    cout << "BAD pairs " << a.entries().size() << '\n';
+
+  CommMatrix m = a.build(8);
+  if(m.rank_n != 8 || m.nnz() != 4 || m.row_at.size() != 9)
+    cout << "BAD shape " << m.rank_n << ' ' << m.nnz() << '\n';
+  if(m.bytes_at(0, 1) != 33340 || m.bytes_at(2, 0) != 33330 || m.bytes_at(5, 0) != 10000)
+    cout << "BAD bytes " << m.bytes_at(0, 1) << ' ' << m.bytes_at(2, 0) << ' ' << m.bytes_at(5, 0) << '\n';
+  if(m.bytes_at(1, 0) != 0 || m.bytes_at(7, 7) != 0 || m.bytes_at(9, 0) != 0)
+    cout << "BAD absent pairs\n";
+
+  ostringstream csr;
+  m.write_csr(csr);
+  CommMatrix back;
+  string err;
+  istringstream in(csr.str());
+  if(!CommMatrix::read_csr(in, back, err) || back.row_at != m.row_at || back.cols != m.cols ||
+     back.bytes != m.bytes || back.msgs != m.msgs)
+    cout << "BAD csr round trip " << err << '\n';
+  PipeBuf pb(csr.str());
+  istream pipe(&pb);
+  if(!CommMatrix::read_csr(pipe, back, err) || back.cols != m.cols || back.msgs != m.msgs)
+    cout << "BAD piped csr round trip " << err << '\n';
+  expect_bad("truncated csr", csr.str().substr(0, csr.str().size() - 1), "truncated");
+
+  // counts far beyond the data must fail without allocating for them
+  string huge = csr.str();
+  put_at(huge, nnz_at, uint64_t(1) << 60, 8);
+  expect_bad("huge nnz", huge, "truncated");
+
+  // a row with two columns, 4 and 6, to garble
+  CommMatrixBuilder two;
+  two.add(3, 4, 1);
+  two.add(3, 6, 1);
+  ostringstream two_csr;
+  two.build(8).write_csr(two_csr);
+  const size_t col0 = cols_at(8), col1 = cols_at(8) + 4;
+  {
+    string s = two_csr.str();
+    put_at(s, col1, 8, 4);
+    expect_bad("column past rank_n", s, "columns out of range or order");
+    s = two_csr.str();
+    put_at(s, col0, 6, 4);
+    put_at(s, col1, 4, 4);
+    expect_bad("columns out of order", s, "columns out of range or order");
+    s = two_csr.str();
+    put_at(s, col0, 6, 4);
+    expect_bad("repeated column", s, "columns out of range or order");
+    // row 3 claiming entries past nnz, row 4 back in range
+    s = two_csr.str();
+    put_at(s, row_at_at + 8*4, 100, 8);
+    expect_bad("row past nnz", s, "rows out of order");
+  }
+
+  ostringstream mtx;
+  m.write_mtx(mtx);
+  if(mtx.str().find("\n8 8 4\n1 2 33340\n") == string::npos)
+    cout << "BAD mtx:\n" << mtx.str();
+
+  ostringstream tsv;
+  CommMatrixBuilder c;
+  c.add(1, 0, 7);
+  c.build().write_tsv(tsv);
+  if(tsv.str() != "\t0\t1\n0\t0\t0\n1\t7\t0\n")
+    cout << "BAD tsv:\n" << tsv.str();
+
+  cout << "done\n";
+  return 0;
+}
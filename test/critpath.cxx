@@ -0,0 +1,76 @@
+#include "tracercritpath.hxx"
+
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  void expect(const char *what, double got, double want) {
+    if(std::fabs(got - want) > 1e-9)
+      cout << "BAD " << what << ": " << got << " want " << want << '\n';
+  }
+}
+
+int main() {
+  SimParams p;
+  p.latency = 1;
+  p.overhead = 0.1;
+  p.byte_time = 0.01;
+
+  TaskNote smooth{TaskNote::intern("smooth"), 0, 0};
+  TaskNote halo{TaskNote::intern("halo"), 1, 0};
+  Digest<128> dig;
+
+  ostringstream report;
+  TracerCritPath tr(p, &report);
+
+  // two long smooths on rank 0 and a short one on rank 1
+  tr.task(0, 0, 100, {}, {}, smooth, 3.0);
+  tr.task(1, 0, 100, {}, {}, smooth, 2.0);
+  tr.task(2, 1, 101, {}, {}, smooth, 1.0);
+
+  // a halo on rank 1 reading 100 bytes from task 0: done at
+  // 3 + 1 + 0.2 + 1 + 0.5
+  vector<Tracer::TaskDepTask> deps{{0, 100, dig}, {2, 100, dig}};
+  tr.task(3, 1, 102, deps, {}, halo, 0.5);
+  tr.retire(100);
+  tr.retire(101);
+  if(tr.live().tasks != 1)
+    cout << "BAD live tasks " << tr.live().tasks << '\n';
+
+  // task 4 is done long before the halo, so the reduction over ranks 0
+  // and 1 starts at 5.7 and takes one round of 1 + 0.2 + 0.08
+  tr.task(4, 0, 103, {}, {}, smooth, 1.0);
+  tr.reduction(0, 8, {3, 4}, {});
+  // a task on rank 2 isn't in the team so pays an empty message
+  tr.task(5, 2, 104, {}, {0}, smooth, 0.25);
+  tr.retire_rdxn(0);
+  tr.finish();
+
+  double halo_done = 3 + 1.2 + 1 + 0.5;
+  double rdxn_done = halo_done + 1.28;
+  expect("length", tr.length(), rdxn_done + 1.2 + 0.25);
+  expect("work", tr.work(), 7.75);
+
+  double compute = 0, message = 0, allreduce = 0;
+  for(const TracerCritPath::Part &part: tr.critical()) {
+    compute += part.compute;
+    message += part.message;
+    allreduce += part.allreduce;
+    if(part.op == halo.op) {
+      expect("halo message", part.message, 2.2);
+      expect("halo allreduce", part.allreduce, 1.28);
+    }
+  }
+  expect("compute", compute, 3.75);
+  expect("message", message, 2.2 + 1.2);
+  expect("allreduce", allreduce, 1.28);
+  if(report.str().compare(0, 14, "critical_path ") != 0)
+    cout << "BAD report: " << report.str() << '\n';
+
+  cout << "done\n";
+  return 0;
+}
@@ -0,0 +1,40 @@
+#include "tracergraph.hxx"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace programr;
+using namespace std;
+
+int main() {
+  ostringstream table;
+  {
+    TracerGraph tr(4, &table);
+    Digest<128> dig;
+    TaskNote fine{TaskNote::intern("smooth"), 1, 0};
+    TaskNote coarse{TaskNote::intern("smooth"), 0, 0};
+
+    // epoch 0: level 1 all on rank 0, level 0 spread evenly
+    tr.task(0, 0, 10, {}, {}, fine, 2.0);
+    tr.task(1, 0, 11, {}, {}, fine, 2.0);
+    for(int r=0; r < 4; r++)
+      tr.task(2 + r, r, 12 + r, {}, {}, coarse, 1.0);
+    tr.post_compute_exec();
+
+    // epoch 1: rank 1 reads 100 bytes from each of level 1's tasks
+    vector<Tracer::TaskDepTask> deps{{0, 100, dig}, {1, 100, dig}};
+    tr.task(6, 1, 16, deps, {}, fine, 1.0);
+  }
+
+  string want =
+    "epoch\tlev\ttasks\tmsgs\tcomp_max\tcomp_mean\timbalance\tsent_max\tsent_mean\trecv_max\trecv_mean\n"
+    "0\t0\t4\t0\t1\t1\t1\t0\t0\t0\t0\n"
+    "0\t1\t2\t0\t4\t1\t4\t0\t0\t0\t0\n"
+    "1\t1\t1\t2\t1\t0.25\t4\t200\t50\t200\t50\n";
+  if(table.str() != want)
+    cout << "BAD table:\n" << table.str();
+
+  cout << "done\n";
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include "eventgraph.hxx"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  // a few ranks' worth of every kind of event, with repeated teams
+  void emit(EventWriter &w) {
+    vector<uint64_t> ids;
+    for(uint64_t i=0; i < 3000; i++) {
+      uint64_t epoch = 1 + i/50;
+      uint64_t deps[2] = {i ? ids[i-1] : 0, ids.empty() ? 0 : ids[(i-1)/2]};
+      size_t dep_n = i == 0 ? 0 : i % 3 == 0 && i > 2 ? 2 : 1;
+      uint64_t id;
+      if(i % 7 == 3) {
+        int team[4] = {int(i%5), 1, 7, int(i%3)};
+        id = 2 + 3*i;
+        w.coll(id, deps, dep_n, team, 4, 8, epoch);
+      }
+      else if(i % 2) {
+        id = 1 + 3*i;
+        w.comm(id, deps, dep_n, int(i%16), int((i+1)%16), 1024*(i%4), epoch);
+      }
+      else {
+        id = 3*i;
+        w.comp(id, deps, dep_n, int(i%16), i % 5 ? 0.25 : 1.5e-7, epoch + 1, nullptr);
+      }
+      ids.push_back(id);
+    }
+    w.finish();
+  }
+
+  bool same(const EventGraph &a, const EventGraph &b) {
+    if(a.ids != b.ids || a.dep_at != b.dep_at || a.deps != b.deps ||
+       a.kinds != b.kinds || a.ranks != b.ranks || a.peers != b.peers ||
+       a.sizes != b.sizes || a.times != b.times || a.epochs != b.epochs ||
+       a.team.size() != b.team.size())
+      return false;
+    for(size_t i=0; i < a.size(); i++) {
+      if((a.team[i] == EventGraph::no_team) != (b.team[i] == EventGraph::no_team))
+        return false;
+      if(a.team[i] != EventGraph::no_team && a.teams.ranks(a.team[i]) != b.teams.ranks(b.team[i]))
+        return false;
+    }
+    return true;
+  }
+}
+
+int main() {
+  EventGraphWriter want;
+  emit(want);
+
+  for(bool refs: {false, true}) {
+    ostringstream o;
+    XmlEventWriter w(&o, refs);
+    o << "<events>\n";
+    emit(w);
+    o << "</events>\n";
+    string xml = o.str();
+
+    for(int thread_n: {1, 4}) {
+      Workers pool(thread_n);
+      EventGraph got;
+      string err;
+      if(!parse_event_graph_xml(xml.data(), xml.size(), pool, got, err) || !same(got, want.graph))
+        cout << "BAD xml refs=" << refs << " threads=" << thread_n << ' ' << err << '\n';
+    }
+  }
+
+  { // binary, from a file
+    const char *path = "eventgraph.tmp.bin";
+    {
+      ofstream f(path, ios::out | ios::binary);
+      BinaryEventWriter w(&f, 16);
+      emit(w);
+    }
+    Workers pool(2);
+    EventGraph got;
+    string err;
+    if(!read_event_graph(path, pool, got, err) || !same(got, want.graph))
+      cout << "BAD binary " << err << '\n';
+    std::remove(path);
+  }
+
+  { // dep indices
+    Workers pool(2);
+    vector<int64_t> dix = want.graph.dep_indices(pool);
+    for(size_t d=0; d < dix.size(); d++) {
+      if(dix[d] < 0 || want.graph.ids[dix[d]] != want.graph.deps[d]) {
+        cout << "BAD dep index " << d << '\n';
+        break;
+      }
+    }
+  }
+
+  { // malformed
+    Workers pool(1);
+    EventGraph got;
+    string err;
+    string xml = "<comp id=\"e0\" dep=\"e1,x\" at=\"0\" />\n";
+    if(parse_event_graph_xml(xml.data(), xml.size(), pool, got, err))
+      cout << "BAD accepted bad dep list\n";
+    xml = "<coll id=\"e2\" dep=\"\" team=\"t0\" size=\"8\" epoch=\"1\" />\n";
+    if(parse_event_graph_xml(xml.data(), xml.size(), pool, got, err))
+      cout << "BAD accepted undefined team\n";
+  }
+
+  cout << "done\n";
+  return 0;
+}
@@ -0,0 +1,58 @@
+#include "lowlevel/lz.hxx"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace programr;
+using namespace std;
+
+int main() {
+  uint64_t x = 1;
+  auto next = [&]() { x = x*6364136223846793005u + 1442695040888963407u; return x >> 33; };
+
+  vector<string> ins = {"", "a", "abcd", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", "abcabcabcabcabcabcabcabc!"};
+  {
+    string s; // random bytes, nothing to match
+    for(int i=0; i < 100000; i++) s.push_back(char(next()));
+    ins.push_back(s);
+  }
+  {
+    string s; // xml-ish lines, long runs and far matches
+    for(int i=0; i < 20000; i++)
+      s += "<comm id=\"e" + to_string(3*i+1) + "\" dep=\"e" + to_string(i) + "\" size=\"" + to_string(next()%600) + "\" />\n";
+    s += string(70000, 'z');
+    ins.push_back(s);
+  }
+  {
+    string s; // few symbols, lots of short matches of all lengths
+    for(int i=0; i < 200000; i++) s.push_back("ab\n"[next()%3]);
+    ins.push_back(s);
+  }
+
+  for(const string &in: ins) {
+    string packed;
+    lz_compress(in.data(), in.size(), packed);
+
+    string out(in.size(), '\0');
+    if(!lz_decompress(packed.data(), packed.size(), &out[0], out.size()) || out != in)
+      cout << "BAD round trip n=" << in.size() << '\n';
+
+    // the wrong size must be refused
+    string longer(in.size() + 1, '\0');
+    if(lz_decompress(packed.data(), packed.size(), &longer[0], longer.size()))
+      cout << "BAD accepted wrong size n=" << in.size() << '\n';
+
+    // damage must never write out of bounds, whatever it returns
+    for(int k=0; k < 50 && !packed.empty(); k++) {
+      string bad = packed;
+      bad[next() % bad.size()] ^= char(1 + next()%255);
+      lz_decompress(bad.data(), bad.size(), &out[0], out.size());
+      lz_decompress(bad.data(), bad.size()/2, &out[0], out.size());
+    }
+  }
+
+  cout << "done\n";
+  return 0;
+}
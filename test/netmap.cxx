@@ -0,0 +1,67 @@
+#include "netmap.hxx"
+
+#include <iostream>
+#include <vector>
+
+using namespace programr;
+using namespace std;
+
+int main() {
+  vector<uint32_t> route;
+
+  // (0,0,0) to (2,3,1) on a 4x4x4 torus: 2 up in x, 1 down in y round
+  // the wrap, 1 up in z
+  Topology torus = Topology::make("3dt:4x4x4", 64);
+  torus.route(0, 2 + 4*3 + 16*1, route);
+  if(route.size() != 4 || route[0] != 6*0 + 0 || route[2] != 6*(2 + 0) + 2 + 1)
+    cout << "BAD torus route of " << route.size() << '\n';
+
+  // group 0 reaches group 2 through router 1's global link and lands on
+  // router 0 of group 2
+  Topology dfly = Topology::make("dfly:3x2x1", 6);
+  route.clear();
+  dfly.route(0, 2*2 + 1, route);
+  if(route.size() != 3)
+    cout << "BAD dragonfly route of " << route.size() << '\n';
+  route.clear();
+  dfly.route(3, 3, route);
+  if(!route.empty())
+    cout << "BAD route to self\n";
+
+  Topology fit = Topology::make("dfly-edi", 1000);
+  if(fit.groups != 3 || fit.node_n() < 1000)
+    cout << "BAD dfly-edi fit " << fit.groups << '\n';
+  fit = Topology::make("3dt-exa", 1000);
+  if(fit.router_n() != 1000)
+    cout << "BAD 3dt-exa fit " << fit.dims[0] << 'x' << fit.dims[1] << 'x' << fit.dims[2] << '\n';
+
+  // ranks 0 and 1 share node 0; rank 2 is node 1 and rank 3 node 3 on a
+  // ring of 4 routers
+  CommMatrixBuilder b;
+  b.add(0, 1, 1000);   // same node
+  b.add(0, 2, 100, 2); // one hop
+  b.add(1, 2, 50);     // the same hop
+  b.add(2, 3, 10);     // two hops
+  CommMatrix m = b.build(4);
+  vector<int> node_of_rank{0, 0, 1, 3};
+  Topology ring = Topology::make("3dt:4x1x1", 4);
+  for(int threads: {1, 3}) {
+    Workers pool(threads);
+    MappingScore s = score_mapping(m, node_of_rank, ring, pool);
+    if(s.msgs != 5 || s.bytes != 1160 || s.offnode_bytes != 160)
+      cout << "BAD totals " << s.msgs << ' ' << s.bytes << ' ' << s.offnode_bytes << '\n';
+    if(s.hop_bytes != 170 || s.max_dilation != 2 || s.mean_dilation != 5.0/5)
+      cout << "BAD hops " << s.hop_bytes << ' ' << s.max_dilation << ' ' << s.mean_dilation << '\n';
+    if(s.max_link_load != 150 || s.links_used != 3)
+      cout << "BAD loads " << s.max_link_load << ' ' << s.links_used << '\n';
+  }
+
+  vector<int> shuffled = place_ranks(8, 2, true, 1);
+  for(int r=0; r < 8; r += 2) {
+    if(shuffled[r] != shuffled[r+1] || shuffled[r] >= 4)
+      cout << "BAD placement of rank " << r << '\n';
+  }
+
+  cout << "done\n";
+  return 0;
+}
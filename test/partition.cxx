@@ -0,0 +1,84 @@
+#include "amr/partition.hxx"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace programr;
+using namespace programr::amr;
+using namespace std;
+
+int main() {
+  if(morton_key(1, 0, 0) != 4 || morton_key(0, 0, 1) != 1 || morton_key(3, 3, 3) != 63)
+    cout << "BAD morton keys\n";
+
+  { // consecutive hilbert keys are unit steps apart and cover the cube
+    const int bits = 3, side = 1 << bits;
+    vector<int> at(side*side*side, -1);
+    for(int x=0; x < side; x++)
+    for(int y=0; y < side; y++)
+    for(int z=0; z < side; z++) {
+      uint64_t k = hilbert_key(x, y, z, bits);
+      if(k < at.size())
+        at[k] = x*side*side + y*side + z;
+    }
+    for(size_t k=0; k < at.size(); k++) {
+      if(at[k] < 0) {
+        cout << "BAD hilbert misses " << k << '\n';
+        break;
+      }
+      if(k == 0)
+        continue;
+      int a = at[k-1], b = at[k];
+      int step = abs(a/(side*side) - b/(side*side)) + abs(a/side%side - b/side%side) + abs(a%side - b%side);
+      if(step != 1) {
+        cout << "BAD hilbert step at " << k << '\n';
+        break;
+      }
+    }
+  }
+
+  vector<boxtree::Level> levels;
+  Box dom;
+  tie(levels, dom) = boxtree::make_octree_full(3, 8);
+  int box_n = 0;
+  for(const auto &lev: levels)
+    box_n += lev.boxes->size();
+
+  for(int threads: {1, 3})
+  for(const char *name: {"morton", "hilbert", "knapsack"})
+  for(bool per_level: {false, true}) {
+    Workers pool(threads);
+    vector<Ref<BoxMap<int>>> maps = partition(levels, 8, partition_method(name), per_level, pool, perf::smooth);
+
+    // every level's boxes are equally sized, so balance is by count
+    vector<vector<int>> counts(levels.size(), vector<int>(8, 0));
+    for(size_t l=0; l < levels.size(); l++) {
+      maps[l]->for_key_val([&](const Box &box, int rank) {
+        if(rank < 0 || rank >= 8)
+          cout << "BAD rank " << rank << '\n';
+        else
+          counts[l][rank] += 1;
+      });
+    }
+    int most = 0, fewest = box_n;
+    for(int r=0; r < 8; r++) {
+      int n = 0;
+      for(size_t l=0; l < levels.size(); l++)
+        n += counts[l][r];
+      most = std::max(most, n);
+      fewest = std::min(fewest, n);
+    }
+    // spread on its own, the finest level's 64 boxes go 8 to a rank
+    for(int r=0; r < 8 && per_level; r++) {
+      if(counts.back()[r] != 8)
+        cout << "BAD " << name << " finest level gives rank " << r << ' ' << counts.back()[r] << '\n';
+    }
+    if(most - fewest > 2)
+      cout << "BAD " << name << " per_level=" << per_level << " threads=" << threads
+           << " boxes per rank " << fewest << ".." << most << '\n';
+  }
+
+  cout << "done\n";
+  return 0;
+}
@@ -0,0 +1,98 @@
+#include "lowlevel/ref.hxx"
+#include "lowlevel/region.hxx"
+
+#include <iostream>
+#include <vector>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  // built with PROGRAMR_KNOB_REGION=1 every Referent comes from the
+  // region allocator, otherwise the test routes just its own objects there
+  struct Obj: Referent {
+    int val;
+    char pad[100];
+    Obj(int val): val(val) {}
+#if !KNOB_REGION
+    static void* operator new(std::size_t size) { return region_alloc(size); }
+    static void operator delete(void *p) { region_dealloc(p); }
+#endif
+  };
+  
+  void expect_live(const char *what, uint64_t want) {
+    if(Region::live_n != want)
+      cout << "BAD " << what << ": live regions=" << Region::live_n << " want " << want << '\n';
+  }
+}
+
+int main() {
+  // three regions of enough objects to span several pages each, the
+  // way Tracer::run ages them every region_exprs executions
+  const int region_n = 3, obj_n = 20000;
+  vector<vector<Ref<Obj>>> objs(region_n);
+  
+  for(int r=0; r < region_n; r++) {
+    Region *region = Region::open();
+    {
+      Region::Scope scope(region);
+      for(int i=0; i < obj_n; i++)
+        objs[r].push_back(new Obj(r*obj_n + i));
+    }
+    region->close();
+  }
+  expect_live("all allocated", region_n);
+  
+  // made with no current region, comes from malloc
+  Ref<Obj> loose = new Obj(-1);
+  expect_live("loose object", region_n);
+  
+  // drop region 1 all but its last object, and region 2 entirely but
+  // for one weak reference. interleave the regions' drops out of order.
+  // a weak reference frees its object's storage through Referent, which
+  // only goes back to the region with the knob on.
+#if KNOB_REGION
+  RefWeak<Obj> weak = objs[2][obj_n/2];
+#endif
+  for(int i=obj_n; i--;) {
+    if(i != obj_n/3)
+      objs[1][i] = nullptr;
+    objs[2][(i*7919) % obj_n] = nullptr;
+  }
+#if KNOB_REGION
+  expect_live("last object and weak ref left", region_n);
+  
+  if(!weak.is_dead())
+    cout << "BAD weak ref still alive\n";
+  weak = RefWeak<Obj>();
+#endif
+  expect_live("region 2 dropped", region_n-1);
+  
+  if(objs[1][obj_n/3]->val != obj_n + obj_n/3)
+    cout << "BAD last object of region 1 damaged\n";
+  objs[1][obj_n/3] = nullptr;
+  expect_live("region 1 emptied", region_n-2);
+  
+  // region 0 from the back, survives until its first object goes
+  for(int i=obj_n; i-- > 1;)
+    objs[0][i] = nullptr;
+  expect_live("first object left", 1);
+  objs[0][0] = nullptr;
+  expect_live("all dropped", 0);
+  
+  // an open region outlives its objects until closed
+  Region *open = Region::open();
+  {
+    Region::Scope scope(open);
+    Ref<Obj> x = new Obj(0);
+  }
+  expect_live("open region", 1);
+  open->close();
+  expect_live("open region closed", 0);
+  
+  if(loose->val != -1)
+    cout << "BAD loose object damaged\n";
+  
+  cout << "done\n";
+  return 0;
+}
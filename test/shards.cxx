@@ -0,0 +1,193 @@
+#include "shardwriter.hxx"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  const int rank_n = 300;
+
+  struct Event {
+    int kind; // 0=comm 1=comp 2=coll
+    uint64_t id;
+    vector<uint64_t> deps;
+    int a, b; // comm from, to or comp at
+    vector<int> team;
+  };
+
+  vector<Event> make_events(int n) {
+    vector<Event> evs;
+    uint64_t x = 4242;
+    auto next = [&]() { x = x*6364136223846793005u + 1442695040888963407u; return x >> 33; };
+
+    for(int i=0; i < n; i++) {
+      Event e;
+      e.kind = next() % 3;
+      e.id = 3*uint64_t(i) + e.kind;
+      for(int d = next() % 3; d != 0; d--)
+        e.deps.push_back(next() % (e.id + 1));
+      e.a = int(next() % rank_n);
+      e.b = next() % 4 == 0 ? e.a : int(next() % rank_n); // some comms stay in a rank
+      for(int t = next() % 6; t >= 0; t--)
+        e.team.push_back(int(next() % rank_n));
+      evs.push_back(e);
+    }
+    return evs;
+  }
+
+  void write(EventWriter &w, const Event &e) {
+    if(e.kind == 0)
+      w.comm(e.id, e.deps.data(), e.deps.size(), e.a, e.b, 64, e.id/100);
+    else if(e.kind == 1)
+      w.comp(e.id, e.deps.data(), e.deps.size(), e.a, 1.5, e.id/100, nullptr);
+    else
+      w.coll(e.id, e.deps.data(), e.deps.size(), e.team.data(), e.team.size(), 8, e.id/100);
+  }
+
+  // the line the plain trace has for `e`
+  string line_of(const Event &e) {
+    ostringstream o;
+    XmlEventWriter w(&o);
+    o.str("");
+    write(w, e);
+    w.offset();
+    return o.str().substr(string("<events>\n").size());
+  }
+
+  string slurp(const string &path) {
+    ifstream f(path, ios::binary);
+    ostringstream o;
+    o << f.rdbuf();
+    return o.str();
+  }
+
+  // checks the shard files and manifest under `dir` against `evs`
+  void check(const string &what, const string &dir, const string &manifest, int shard_ranks, const vector<Event> &evs) {
+    int shard_n = (rank_n + shard_ranks-1) / shard_ranks;
+    vector<string> want(shard_n, "<events>\n");
+    vector<uint64_t> comm_n(shard_n), comp_n(shard_n), coll_n(shard_n);
+
+    for(const Event &e: evs) {
+      string line = line_of(e);
+      vector<int> in;
+      if(e.kind == 0) {
+        in.push_back(e.a / shard_ranks);
+        if(e.b / shard_ranks != e.a / shard_ranks)
+          in.push_back(e.b / shard_ranks);
+      }
+      else if(e.kind == 1)
+        in.push_back(e.a / shard_ranks);
+      else {
+        for(int r: e.team) {
+          bool seen = false;
+          for(int s: in)
+            seen |= s == r / shard_ranks;
+          if(!seen)
+            in.push_back(r / shard_ranks);
+        }
+      }
+      for(int s: in) {
+        want[s] += line;
+        (e.kind == 0 ? comm_n : e.kind == 1 ? comp_n : coll_n)[s] += 1;
+      }
+    }
+
+    istringstream m(manifest);
+    string word;
+    int got_rank_n, got_shard_ranks, got_shard_n;
+    m >> word >> word >> word >> got_rank_n >> word >> got_shard_ranks >> word >> got_shard_n;
+    if(!m || got_rank_n != rank_n || got_shard_ranks != shard_ranks || got_shard_n != shard_n)
+      cout << "BAD " << what << " manifest header\n";
+
+    for(int s=0; s < shard_n; s++) {
+      int id, lo, hi;
+      string name;
+      uint64_t comms, comps, colls;
+      m >> id >> lo >> hi >> name >> comms >> comps >> colls;
+      if(!m || id != s || lo != s*shard_ranks || hi != std::min(lo + shard_ranks, rank_n) - 1 ||
+         name != "events." + to_string(s) + ".xml")
+        cout << "BAD " << what << " manifest line " << s << '\n';
+      if(comms != comm_n[s] || comps != comp_n[s] || colls != coll_n[s])
+        cout << "BAD " << what << " shard " << s << " counts " << comms << ' ' << comps << ' ' << colls << '\n';
+
+      if(slurp(dir + "/" + name) != want[s] + "</events>\n")
+        cout << "BAD " << what << " shard " << s << " contents\n";
+    }
+  }
+
+  string trace(const string &dir, int shard_ranks, const vector<Event> &evs) {
+    ostringstream manifest;
+    ShardedEventWriter w(&manifest, dir, "events", rank_n, shard_ranks, 3);
+    for(const Event &e: evs)
+      write(w, e);
+    w.finish();
+    return manifest.str();
+  }
+}
+
+int main() {
+  char dir_tmpl[] = "/tmp/programr-shards.XXXXXX";
+  string dir = mkdtemp(dir_tmpl);
+
+  // more shards than the process may open files at once, which once
+  // failed with every shard held open
+  struct rlimit lim;
+  getrlimit(RLIMIT_NOFILE, &lim);
+  lim.rlim_cur = 64;
+  setrlimit(RLIMIT_NOFILE, &lim);
+
+  vector<Event> evs = make_events(20000);
+
+  for(int shard_ranks: {1, 7, 300}) {
+    string what = "shard_ranks=" + to_string(shard_ranks);
+    check(what, dir, trace(dir, shard_ranks, evs), shard_ranks, evs);
+  }
+
+  // checkpoint partway, carry on writing as a run that then dies would,
+  // and resume from the checkpoint
+  for(size_t cut: {size_t(0), size_t(1), evs.size()/2, evs.size()}) {
+    string what = "resume at " + to_string(cut);
+    const int shard_ranks = 7;
+
+    stringstream manifest, ckpt;
+    uint64_t offset;
+    {
+      ShardedEventWriter w(&manifest, dir, "events", rank_n, shard_ranks, 3);
+      for(size_t i=0; i < cut; i++)
+        write(w, evs[i]);
+      offset = w.offset();
+      w.checkpoint_save(ckpt);
+      // dies before finishing, having written some events past the cut
+      for(size_t i=cut; i < evs.size(); i += 2)
+        write(w, evs[i]);
+      w.checkpoint_save(ckpt); // forces them out, not read back
+    }
+
+    {
+      ShardedEventWriter w(&manifest, dir, "events", rank_n, shard_ranks, 3, true);
+      w.checkpoint_load(ckpt, offset);
+      for(size_t i=cut; i < evs.size(); i++)
+        write(w, evs[i]);
+      w.finish();
+    }
+    // main truncates the manifest where the resumed run left off
+    check(what, dir, manifest.str().substr(0, manifest.tellp()), shard_ranks, evs);
+  }
+
+  for(int s=0; s < rank_n; s++)
+    std::remove((dir + "/events." + to_string(s) + ".xml").c_str());
+  rmdir(dir.c_str());
+
+  cout << "done\n";
+  return 0;
+}
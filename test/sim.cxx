@@ -0,0 +1,81 @@
+#include "simwriter.hxx"
+
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  void expect(const char *what, double got, double want) {
+    if(std::fabs(got - want) > 1e-9)
+      cout << "BAD " << what << ": " << got << " want " << want << '\n';
+  }
+}
+
+int main() {
+  SimParams p;
+  p.latency = 1;
+  p.overhead = 0.1;
+  p.gap = 0.5;
+  p.byte_time = 0.01;
+
+  ostringstream report;
+  SimEventWriter sim(2, p, &report);
+
+  // rank 0 computes twice in a row, 0..1 and 1..3
+  sim.comp(0, nullptr, 0, 0, 1.0, 1, nullptr);
+  sim.comp(3, nullptr, 0, 0, 2.0, 1, nullptr);
+
+  // 1000 bytes to rank 1 sent at 1: injected by 11.1, lands at 12.1,
+  // done at 12.2
+  uint64_t e0 = 0;
+  sim.comm(1, &e0, 1, 0, 1, 1000, 1);
+  // an empty message right behind it waits for the nic until 11.1,
+  // lands at 12.2 and is done at 12.3
+  sim.comm(4, &e0, 1, 0, 1, 0, 1);
+  // to self is free
+  sim.comm(7, &e0, 1, 0, 0, 1000, 1);
+
+  uint64_t msgs[3] = {1, 4, 7};
+  sim.comp(6, msgs, 3, 1, 0.5, 2, nullptr);
+
+  // one round between two ranks once rank 1 is done at 12.8
+  int team[2] = {0, 1};
+  uint64_t last[2] = {3, 6};
+  sim.coll(2, last, 2, team, 2, 8, 2);
+  sim.finish();
+
+  expect("makespan", sim.makespan(), 12.8 + 1 + 0.2 + 0.08);
+  expect("busy 0", sim.busy(0), 3.0);
+  expect("busy 1", sim.busy(1), 0.5);
+  if(report.str().compare(0, 9, "makespan ") != 0)
+    cout << "BAD report: " << report.str() << '\n';
+
+  // done times are dropped as events retire
+  if(sim.live_n() != 7)
+    cout << "BAD live " << sim.live_n() << '\n';
+  for(uint64_t id: {0, 1, 2, 3, 4, 6, 7, 1000})
+    sim.retire(id);
+  if(sim.live_n() != 0)
+    cout << "BAD live after retiring " << sim.live_n() << '\n';
+
+  // a long chain retiring as it goes holds one done time at a time
+  {
+    ostringstream r;
+    SimEventWriter chain(1, p, &r);
+    for(uint64_t n=0; n < 100000; n++) {
+      uint64_t prev = 3*(n-1);
+      chain.comp(3*n, &prev, n != 0, 0, 1.0, n, nullptr);
+      if(n != 0)
+        chain.retire(prev);
+      if(chain.live_n() != 1)
+        cout << "BAD chain live " << chain.live_n() << " at " << n << '\n';
+    }
+    expect("chain makespan", chain.makespan(), 100000.0);
+  }
+
+  cout << "done\n";
+  return 0;
+}
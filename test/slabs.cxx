@@ -0,0 +1,76 @@
+#include "amr/partition.hxx"
+#include "amr/slab.hxx"
+#include "tracerxml.hxx"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace programr;
+using namespace programr::amr;
+using namespace std;
+
+namespace {
+  const int rank_n = 8;
+
+  // two V-cycles over the levels, so the slab ops run their per box
+  // queries on the worker pool both cold and with the memo filled
+  Ref<Expr> vcycles(Ref<Boundary> bdry, const vector<boxtree::Level> &levels, const vector<Ref<BoxMap<int>>> &ranks) {
+    int top = int(levels.size()) - 1;
+    vector<Ex<Slab>> x;
+    for(int l=0; l <= top; l++)
+      x.push_back(slab_literal(bdry, levels[l], ranks[l], sizeof(double), "literal"));
+
+    for(int cycle=0; cycle < 2; cycle++) {
+      for(int l=top; l > 0; l--) {
+        Ex<Slab> h = l % 2 ? slab_halo(x[l], x[l-1], 1, 1, "halo")
+                           : slab_halo2(x[l], x[l-1], x[l-1], 1, 1, "halo2");
+        x[l] = slab_stencil(h, 1, "stencil");
+        x[l-1] = slab_op({x[l-1], slab_restrict(x[l-1], x[l], false, "restrict")}, -1, "update");
+      }
+      for(int l=1; l <= top; l++)
+        x[l] = slab_op({x[l], slab_prolong(x[l], x[l-1], 1, "prolong")}, -1, "update");
+    }
+    return x[top];
+  }
+
+  string trace(int threads, Ref<Boundary> bdry, const vector<boxtree::Level> &levels, const vector<Ref<BoxMap<int>>> &ranks) {
+    // as though each run were a fresh process
+    Data::_id_next = 0;
+
+    ostringstream out;
+    {
+      TracerXml tr(rank_n, new XmlEventWriter(&out));
+      tr.thread_n = threads;
+      // the program must go before the tracer its data report to
+      tr.run(vcycles(bdry, levels, ranks));
+    }
+    return out.str();
+  }
+}
+
+int main() {
+  vector<boxtree::Level> levels;
+  Box dom;
+  tie(levels, dom) = boxtree::make_octree_full(4, 8);
+
+  Workers pool(1);
+  vector<Ref<BoxMap<int>>> ranks = partition(levels, rank_n, partition_method("morton"), false, pool);
+  Ref<Boundary> bdry = new BoundaryPeriodic(dom);
+
+  // threads=4 first, so its queries find the memo empty
+  string parallel = trace(4, bdry, levels, ranks);
+  string serial = trace(1, bdry, levels, ranks);
+  string again = trace(4, bdry, levels, ranks);
+
+  if(serial.find("<comm") == string::npos || serial.size() < 100000)
+    cout << "BAD trace too small: " << serial.size() << " bytes\n";
+  if(parallel != serial)
+    cout << "BAD threads=4 trace differs from threads=1\n";
+  if(again != serial)
+    cout << "BAD threads=4 trace differs once memoized\n";
+
+  cout << "done\n";
+  return 0;
+}
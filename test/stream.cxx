@@ -0,0 +1,155 @@
+#include "tracerxml.hxx"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  const int rank_n = 4;
+
+  struct Step: Result {
+    Ref<Data> data;
+    vector<uint64_t> tasks; // by rank
+
+    void datas(vector<Data*> &add_to) const {
+      add_to.push_back(data);
+    }
+  };
+
+  // one compute epoch: a task per rank reading the previous step's task
+  // on the next rank
+  struct Expr_Step: Expr {
+    Ref<Expr> prev;
+    int k;
+
+    Expr_Step(Ref<Expr> prev, int k): prev(std::move(prev)), k(k) {}
+
+    void subexs(vector<Expr*> &add_to) const {
+      if(prev)
+        add_to.push_back(prev);
+    }
+
+    void show(ostream &o) const {
+      o << "Expr_Step(" << k << ")";
+    }
+
+    void execute(ExecCxt &cxt) {
+      Step *p = prev ? static_cast<Step*>((Result*)prev->result) : nullptr;
+      Ref<Step> s = new Step;
+      s->data = new Data;
+
+      for(int rank=0; rank < rank_n; rank++) {
+        vector<Dependency> deps;
+        if(p) {
+          Digest<128> dig;
+          dig.w0 = k;
+          dig.w1 = rank;
+          deps.push_back({p->tasks[(rank + 1) % rank_n], dig, size_t(8*(k % 5 + 1))});
+        }
+        TaskNote note{TaskNote::intern("step"), 0, rank};
+        s->tasks.push_back(cxt.task(rank, s->data->id, deps, note, 1.0));
+      }
+
+      this->result = s;
+      this->prev = nullptr; // prune
+    }
+  };
+
+  // a reduction among ranks 0 and 1 of a step, passing the step on, so
+  // the next step's tasks on ranks 2 and 3 wait on a control message
+  struct Expr_Reduce: Expr {
+    Ref<Expr> step;
+
+    Expr_Reduce(Ref<Expr> step): step(std::move(step)) {}
+
+    void subexs(vector<Expr*> &add_to) const {
+      add_to.push_back(step);
+    }
+
+    void show(ostream &o) const {
+      o << "Expr_Reduce";
+    }
+
+    void execute(ExecCxt &cxt) {
+      Step *s = static_cast<Step*>((Result*)step->result);
+      cxt.reduction(8, {s->tasks[0], s->tasks[1]});
+      this->result = s;
+      this->step = nullptr; // prune
+    }
+  };
+
+  // writes xml, noting the most tasks and reductions the tracer held at
+  // any epoch boundary
+  struct WatchedWriter: XmlEventWriter {
+    const Tracer *tracer = nullptr;
+    size_t most_tasks = 0, most_rdxns = 0, most_teams = 0;
+
+    WatchedWriter(ostream *o): XmlEventWriter(o) {}
+
+    void epoch_begin(uint64_t comp_epoch) {
+      Tracer::Live lv = tracer->live();
+      most_tasks = std::max(most_tasks, lv.tasks);
+      most_rdxns = std::max(most_rdxns, lv.rdxns);
+      most_teams = std::max(most_teams, lv.teams);
+      XmlEventWriter::epoch_begin(comp_epoch);
+    }
+  };
+
+  string trace(int step_n, bool stream, size_t &most_tasks, size_t &most_rdxns, size_t &most_teams) {
+    // as though each run were a fresh process
+    Data::_id_next = 0;
+
+    ostringstream out;
+    {
+      WatchedWriter *w = new WatchedWriter(&out);
+      TracerXml tr(rank_n, w);
+      w->tracer = &tr;
+      tr.flag_stream = stream;
+      tr.stream_report = 0;
+
+      Ref<Expr> x;
+      for(int k=0; k < step_n; k++) {
+        x = new Expr_Step(x, k);
+        if(k % 2 == 0)
+          x = new Expr_Reduce(x);
+      }
+      tr.run(x);
+
+      most_tasks = w->most_tasks;
+      most_rdxns = w->most_rdxns;
+      most_teams = w->most_teams;
+    }
+    return out.str();
+  }
+}
+
+int main() {
+  const int step_n = 400;
+  size_t tasks, rdxns, teams, stream_tasks, stream_rdxns, stream_teams;
+
+  string whole = trace(step_n, false, tasks, rdxns, teams);
+  string streamed = trace(step_n, true, stream_tasks, stream_rdxns, stream_teams);
+
+  if(streamed != whole)
+    cout << "BAD streamed trace differs\n";
+  if(whole.find("<coll") == string::npos || whole.find("size=\"0\"") == string::npos)
+    cout << "BAD trace lacks colls or control messages\n";
+
+  // without streaming every reduction is kept, which is what stream=1
+  // exists to avoid
+  if(rdxns < size_t(step_n/2))
+    cout << "BAD unstreamed run held only " << rdxns << " reductions\n";
+
+  // streaming holds a step or two of each, however long the program
+  if(stream_tasks > size_t(4*rank_n))
+    cout << "BAD streamed run held " << stream_tasks << " tasks\n";
+  if(stream_rdxns > 2 || stream_teams > 1)
+    cout << "BAD streamed run held " << stream_rdxns << " reductions, " << stream_teams << " teams\n";
+
+  cout << "done\n";
+  return 0;
+}
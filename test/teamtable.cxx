@@ -0,0 +1,72 @@
+#include "teamtable.hxx"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+using namespace programr;
+using namespace std;
+
+int main() {
+  TeamTable tt;
+
+  const int a1[] = {5, 1, 70, 1};
+  const int a2[] = {70, 5, 1};
+  const int b[] = {2};
+  uint32_t a = tt.intern(a1, 4);
+  if(tt.intern(a2, 3) != a)
+    cout << "BAD equal teams got different ids\n";
+  uint32_t bi = tt.intern(b, 1);
+  if(bi == a || tt.size() != 2)
+    cout << "BAD distinct teams size=" << tt.size() << '\n';
+  if(tt.ranks(a) != vector<int>({1, 5, 70}))
+    cout << "BAD ranks not ascending\n";
+  if(!tt.has(a, 70) || tt.has(a, 2) || tt.has(a, 6400) || tt.has(a, -1))
+    cout << "BAD membership\n";
+
+  // a is held twice, so one release keeps it
+  tt.release(a);
+  if(tt.size() != 2 || tt.intern(a2, 3) != a)
+    cout << "BAD team dropped while held\n";
+  tt.release(a);
+  tt.release(a);
+  if(tt.size() != 1)
+    cout << "BAD released team kept, size=" << tt.size() << '\n';
+
+  // the next new team reuses a's id, and a comes back as a new team
+  const int c[] = {3, 4};
+  uint32_t ci = tt.intern(c, 2);
+  if(ci != a || tt.ranks(ci) != vector<int>({3, 4}) || tt.has(ci, 70))
+    cout << "BAD freed id not reused cleanly\n";
+  uint32_t a_again = tt.intern(a1, 4);
+  if(a_again == ci || a_again == bi || tt.ranks(a_again) != vector<int>({1, 5, 70}))
+    cout << "BAD reinterned team\n";
+
+  // a stream of reductions over many teams, each retired a little
+  // later: the table stays the size of the teams in flight
+  vector<uint32_t> held;
+  vector<int> team;
+  size_t most = 0;
+  for(int i=0; i < 100000; i++) {
+    team.clear();
+    for(int r=0; r < 1 + i % 5; r++)
+      team.push_back((i*7 + r*13) % 1000);
+    held.push_back(tt.intern(team.data(), team.size()));
+    if(!std::is_sorted(tt.ranks(held.back()).begin(), tt.ranks(held.back()).end()))
+      cout << "BAD ranks at " << i << '\n';
+    if(held.size() > 20) {
+      tt.release(held.front());
+      held.erase(held.begin());
+    }
+    most = std::max(most, tt.size());
+  }
+  if(most > 23)
+    cout << "BAD table grew to " << most << " teams\n";
+
+  tt.clear();
+  if(tt.size() != 0 || tt.intern(b, 1) != 0)
+    cout << "BAD clear\n";
+
+  cout << "done\n";
+  return 0;
+}
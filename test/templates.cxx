@@ -0,0 +1,139 @@
+#include "templatewriter.hxx"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  // a setup segment and then `iter_n` iterations of a solver on 4 ranks,
+  // each a compute segment and a communicate and reduce segment
+  void emit(EventWriter &w, int iter_n) {
+    TaskNote note{TaskNote::intern("smooth"), 0, 0};
+    uint64_t task = 0, comm = 0, rdxn = 0;
+    uint64_t epoch = 0;
+    vector<uint64_t> last(4);
+
+    for(int r=0; r < 4; r++) {
+      last[r] = 3*task++;
+      note.box = r;
+      w.comp(last[r], nullptr, 0, r, 0, epoch + 1, &note);
+    }
+
+    uint64_t sum = 0;
+    for(int it=0; it < iter_n; it++) {
+      w.epoch_begin(++epoch);
+      for(int r=0; r < 4; r++) {
+        uint64_t deps[2] = {last[r], sum};
+        uint64_t id = 3*task++;
+        note.box = r;
+        w.comp(id, deps, it ? 2 : 1, r, 1.25e-6, epoch + 1, &note);
+        last[r] = id;
+      }
+
+      w.epoch_begin(++epoch);
+      for(int r=0; r < 4; r++) {
+        uint64_t id = 1 + 3*comm++;
+        w.comm(id, &last[r], 1, r, (r+1) % 4, 4096, epoch);
+        last[r] = id;
+      }
+      int team[4] = {0, 1, 2, 3};
+      sum = 2 + 3*rdxn++;
+      w.coll(sum, last.data(), 4, team, 4, 8, epoch);
+    }
+    w.finish();
+  }
+
+  // `epoch_n` segments of one task per rank reading the rank's last task
+  // and task 0, with a skeleton that comes back every `period` epochs
+  void emit_drift(EventWriter &w, int epoch_n, int period) {
+    uint64_t task = 1;
+    vector<uint64_t> last(4, 0);
+    w.comp(0, nullptr, 0, 0, 0, 1, nullptr);
+
+    for(int e=1; e <= epoch_n; e++) {
+      w.epoch_begin(e);
+      for(int r=0; r < 4; r++) {
+        uint64_t deps[2] = {last[r], 0};
+        uint64_t id = 3*task++;
+        w.comp(id, deps, last[r] ? 2 : 1, r, 1e-6*(e % period), e + 1, nullptr);
+        last[r] = id;
+      }
+    }
+    w.finish();
+  }
+}
+
+int main() {
+  for(bool refs: {false, true}) {
+    ostringstream plain;
+    {
+      XmlEventWriter w(&plain, refs);
+      emit(w, 100);
+    }
+
+    ostringstream templated;
+    TemplateEventWriter w(&templated, refs);
+    emit(w, 100);
+    // setup, the first iteration's two segments and the next compute
+    // segment, whose deps now include the previous reduction
+    if(w.shape_n() != 4)
+      cout << "BAD refs=" << refs << " shapes " << w.shape_n() << '\n';
+    if(templated.str().size()*5 > plain.str().size())
+      cout << "BAD refs=" << refs << " templated " << templated.str().size() << " of " << plain.str().size() << " bytes\n";
+
+    istringstream in(templated.str());
+    ostringstream expanded;
+    XmlEventWriter x(&expanded, refs);
+    string err;
+    if(!read_templated_events(in, x, err) || expanded.str() != plain.str())
+      cout << "BAD refs=" << refs << " expand " << err << '\n';
+  }
+
+  // skeletons that don't repeat, or not within the window, are
+  // forgotten but still expand to the same trace
+  for(int period: {3, 40, 1000000}) {
+    const int keep = 16;
+    ostringstream plain;
+    {
+      XmlEventWriter w(&plain);
+      emit_drift(w, 2000, period);
+    }
+
+    ostringstream templated;
+    TemplateEventWriter w(&templated, false, keep);
+    emit_drift(w, 2000, period);
+    if(w.last_n() > 2*keep + 1)
+      cout << "BAD period=" << period << " kept " << w.last_n() << " skeletons\n";
+    // skeletons seen within the window repeat as they would unbounded
+    ostringstream unbounded;
+    TemplateEventWriter wu(&unbounded, false, uint64_t(1) << 40);
+    emit_drift(wu, 2000, period);
+    if(period == 3 && w.shape_n() != wu.shape_n())
+      cout << "BAD period=" << period << " shapes " << w.shape_n() << " of " << wu.shape_n() << '\n';
+    if(period == 40 && w.shape_n() <= wu.shape_n())
+      cout << "BAD period=" << period << " window didn't apply\n";
+
+    istringstream in(templated.str());
+    ostringstream expanded;
+    XmlEventWriter x(&expanded);
+    string err;
+    if(!read_templated_events(in, x, err) || expanded.str() != plain.str())
+      cout << "BAD period=" << period << " expand " << err << '\n';
+  }
+
+  { // a repeat of a shape never defined
+    istringstream in("<events>\n<repeat shape=\"s0\" epoch=\"1\" />\n</events>\n");
+    ostringstream o;
+    XmlEventWriter x(&o);
+    string err;
+    if(read_templated_events(in, x, err))
+      cout << "BAD accepted undefined shape\n";
+  }
+
+  cout << "done\n";
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include "tracerrecord.hxx"
+#include "tracergraph.hxx"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  // writes each call it gets on a line of its own
+  struct TracerLog: Tracer {
+    ostringstream log;
+
+    void task(
+        uint64_t task_id, int rank, uint64_t data_id,
+        const vector<TaskDepTask> &dep_tasks,
+        const vector<uint64_t> &dep_rdxns,
+        TaskNote note, double seconds
+      ) {
+      log << "task " << task_id << ' ' << rank << ' ' << data_id << ' ' << note.lev << ' ' << note.box << ' ' << seconds;
+      for(const TaskDepTask &d: dep_tasks)
+        log << " t" << d.task << ':' << d.bytes;
+      for(uint64_t r: dep_rdxns)
+        log << " r" << r;
+      log << '\n';
+    }
+    void reduction(uint64_t rdxn_id, size_t bytes, const vector<uint64_t> &dep_tasks, const vector<uint64_t> &dep_rdxns) {
+      log << "rdxn " << rdxn_id << ' ' << bytes << ' ' << dep_tasks.size() << ' ' << dep_rdxns.size() << '\n';
+    }
+    void retire(uint64_t data_id) { log << "retire " << data_id << '\n'; }
+    void retire_rdxn(uint64_t rdxn_id) override { log << "retire_rdxn " << rdxn_id << '\n'; }
+    void post_compute_exec() override { log << "epoch\n"; }
+  };
+
+  // a task on each of boxes 0..3, then tasks on boxes 0 and 1 reading
+  // the same sends from the others
+  template<class T>
+  void program(T &tr) {
+    Digest<128> dig;
+    TaskNote note{TaskNote::intern("smooth"), -1, 0};
+    int ranks[4] = {0, 1, 2, 3};
+    double seconds[4] = {1, 2, 3, 4.5};
+    TaskNote notes[4] = {note, note, note, note};
+    size_t dep_off[5] = {0, 0, 0, 0, 0};
+    Tracer::Tasks batch{0, 10, 4, ranks, seconds, notes, dep_off, nullptr};
+    tr.task_batch(batch, {});
+    tr.post_compute_exec();
+
+    tr.task(4, 0, 11, {{1, 100, dig}, {2, 100, dig}, {3, 100, dig}}, {}, note, 1.0);
+    tr.task(5, 1, 11, {{2, 100, dig}, {3, 100, dig}}, {}, note, 1.0);
+    tr.reduction(0, 8, {4, 5}, {});
+    tr.task(6, 3, 12, {}, {0}, note, 0.5);
+    tr.retire_rdxn(0);
+    tr.retire(10);
+  }
+
+  string matrix(const TracerRecord &rec, const vector<int> &rank_of, int rank_n) {
+    TracerGraph g(rank_n);
+    rec.replay(g, rank_of);
+    CommMatrix m = g.comm_matrix(rank_n);
+    ostringstream o;
+    for(int r=0; r < m.rank_n; r++) {
+      for(uint64_t k=m.row_at[r]; k < m.row_at[r+1]; k++)
+        o << r << "->" << m.cols[k] << ':' << m.msgs[k] << '/' << m.bytes[k] << ' ';
+    }
+    return o.str();
+  }
+}
+
+int main() {
+  TracerRecord rec;
+  program(rec);
+  if(rec.rank_n() != 4)
+    cout << "BAD rank_n " << rec.rank_n() << '\n';
+
+  // replaying as recorded makes the same calls
+  TracerLog direct, replayed;
+  program(direct);
+  rec.replay(replayed, {0, 1, 2, 3});
+  if(direct.log.str() != replayed.log.str())
+    cout << "BAD replay:\n" << replayed.log.str() << "want:\n" << direct.log.str();
+
+  // ranks are translated
+  TracerLog moved;
+  rec.replay(moved, {3, 2, 1, 0});
+  if(moved.log.str().find("task 6 0 12") == string::npos)
+    cout << "BAD translated ranks:\n" << moved.log.str();
+
+  // the reduction over ranks 0 and 1 becomes a message each way
+  string got = matrix(rec, {0, 1, 2, 3}, 4);
+  string want = "0->1:1/8 1->0:2/108 2->0:1/100 2->1:1/100 3->0:1/100 3->1:1/100 ";
+  if(got != want)
+    cout << "BAD identity: " << got << '\n';
+
+  // boxes 2 and 3 share rank 1: the second read of each is a repeat, the
+  // reads within rank 0 and the reduction's messages are dropped
+  got = matrix(rec, {0, 0, 1, 1}, 2);
+  want = "1->0:2/200 ";
+  if(got != want)
+    cout << "BAD paired: " << got << '\n';
+
+  got = matrix(rec, {0, 0, 0, 0}, 1);
+  if(got != "")
+    cout << "BAD one rank: " << got << '\n';
+
+  cout << "done\n";
+  return 0;
+}
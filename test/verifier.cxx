@@ -0,0 +1,80 @@
+#include "verifier.hxx"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  struct Ev { uint64_t id; vector<uint64_t> deps; };
+
+  void expect(const char *what, VerifyCounts got, uint64_t reused, uint64_t repeated, uint64_t undefined, uint64_t stuck) {
+    if(got.id_reused_n != reused || got.dep_repeated_n != repeated ||
+       got.dep_undefined_n != undefined || got.stuck_n != stuck) {
+      cout << "BAD " << what << ": reused=" << got.id_reused_n << " repeated=" << got.dep_repeated_n
+           << " undefined=" << got.dep_undefined_n << " stuck=" << got.stuck_n << '\n';
+    }
+  }
+
+  void check(const char *what, const vector<Ev> &evs, bool in_order, uint64_t reused, uint64_t repeated, uint64_t undefined, uint64_t stuck) {
+    EventGraph g;
+    string xml = "<events>\n";
+    for(const Ev &e: evs) {
+      g.add(e.id, e.deps.data(), e.deps.size());
+      xml += "<comp id=\"e" + to_string(e.id) + "\" dep=\"";
+      for(size_t i=0; i < e.deps.size(); i++)
+        xml += (i ? ",e" : "e") + to_string(e.deps[i]);
+      xml += "\" at=\"0\" time=\"0\" epoch=\"1\" />\n";
+    }
+    xml += "</events>\n";
+
+    for(int thread_n: {1, 3}) {
+      Workers pool(thread_n);
+      expect(what, verify_event_graph(g, pool), reused, repeated, undefined, stuck);
+
+      EventGraph parsed;
+      string err;
+      if(!parse_event_graph_xml(xml.data(), xml.size(), pool, parsed, err) ||
+         parsed.ids != g.ids || parsed.deps != g.deps || parsed.dep_at != g.dep_at)
+        cout << "BAD " << what << ": xml parse " << err << '\n';
+    }
+
+    // online, events only see what came before them
+    if(in_order) {
+      EventVerifier v;
+      for(const Ev &e: evs)
+        v.define(e.id, e.deps.data(), e.deps.size());
+      expect(what, v.counts(), reused, repeated, undefined, stuck);
+    }
+  }
+}
+
+int main() {
+  check("empty", {}, true, 0, 0, 0, 0);
+  check("chain", {{0,{}}, {1,{0}}, {2,{1,0}}, {5,{2}}}, true, 0, 0, 0, 0);
+  check("reused", {{0,{}}, {1,{0}}, {1,{}}}, true, 1, 0, 0, 0);
+  check("repeated", {{0,{}}, {1,{0,0}}, {2,{1,0,1}}}, true, 0, 2, 0, 0);
+  check("undefined", {{0,{}}, {1,{7}}, {2,{1}}}, true, 0, 0, 1, 0);
+  // out of order is fine for the whole graph check
+  check("backwards", {{3,{0}}, {0,{}}, {6,{3}}}, false, 0, 0, 0, 0);
+  check("cycle", {{0,{}}, {1,{0,4}}, {4,{1}}, {7,{4}}, {9,{0}}}, false, 0, 0, 0, 3);
+
+  { // a long graph spanning many frontiers and grains
+    vector<Ev> evs;
+    for(uint64_t i=0; i < 50000; i++) {
+      Ev e{3*i, {}};
+      if(i) e.deps.push_back(3*(i-1));
+      if(i > 100) e.deps.push_back(3*(i-100));
+      evs.push_back(e);
+    }
+    check("long", evs, true, 0, 0, 0, 0);
+    evs[10].deps.push_back(3*20000);
+    check("long cycle", evs, false, 0, 0, 0, 50000-10);
+  }
+
+  cout << "done\n";
+  return 0;
+}
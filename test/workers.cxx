@@ -0,0 +1,43 @@
+#include "lowlevel/workers.hxx"
+
+#include <atomic>
+#include <iostream>
+#include <vector>
+
+using namespace programr;
+using namespace std;
+
+int main() {
+  for(int thread_n: {1, 2, 4, 7}) {
+    Workers pool(thread_n);
+
+    pool.parallel_for(10, 16, [&](size_t i, int worker) {});
+    if(pool.started() != 0)
+      cout << "BAD threads=" << thread_n << " started early\n";
+
+    for(size_t n: {0, 1, 10, 1000, 100000}) {
+      vector<int> hits(n, 0);
+      atomic<size_t> sum{0};
+
+      pool.parallel_for(n, 16, [&](size_t i, int worker) {
+        if(worker < 0 || worker >= thread_n)
+          cout << "BAD worker=" << worker << '\n';
+        hits[i] += 1;
+        sum += i;
+      });
+
+      for(size_t i=0; i < n; i++)
+        if(hits[i] != 1)
+          cout << "BAD threads=" << thread_n << " n=" << n << " i=" << i << " hits=" << hits[i] << '\n';
+
+      if(sum != n*(n ? n-1 : 0)/2)
+        cout << "BAD threads=" << thread_n << " n=" << n << " sum=" << sum << '\n';
+    }
+
+    if(pool.started() != thread_n-1)
+      cout << "BAD threads=" << thread_n << " started=" << pool.started() << '\n';
+  }
+
+  cout << "done\n";
+  return 0;
+}
@@ -0,0 +1,130 @@
+// Checks XmlEventWriter against formatting the same events with ostream
+// `<<`, the way events.xml used to be written, and reports events per
+// second for both.
+
+#include "eventwriter.hxx"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace programr;
+using namespace std;
+
+namespace {
+  struct Event {
+    int kind; // 0=comm 1=comp 2=coll
+    uint64_t id;
+    vector<uint64_t> deps;
+    int a, b;
+    size_t bytes;
+    double seconds;
+    uint64_t epoch;
+    TaskNote note;
+    vector<int> team;
+  };
+
+  void put_ids(ostream &o, const vector<uint64_t> &ids) {
+    for(size_t i=0; i < ids.size(); i++) {
+      if(i != 0) o << ',';
+      o << 'e' << ids[i];
+    }
+  }
+
+  void stream_events(ostream &o, const vector<Event> &evs, bool notes) {
+    o << "<events>\n";
+    for(const Event &e: evs) {
+      if(e.kind == 0) {
+        o << "<comm id=\"e" << e.id << "\" dep=\"";
+        put_ids(o, e.deps);
+        o << "\" from=\"" << e.a << "\" to=\"" << e.b << "\" size=\"" << e.bytes
+          << "\" epoch=\"" << e.epoch << "\" />\n";
+      }
+      else if(e.kind == 1) {
+        o << "<comp id=\"e" << e.id << "\" dep=\"";
+        put_ids(o, e.deps);
+        o << "\" at=\"" << e.a << "\" time=\"" << e.seconds << "\" epoch=\"" << e.epoch << "\" ";
+        if(notes)
+          o << "note=\"" << e.note << "\" ";
+        o << "/>\n";
+      }
+      else {
+        o << "<coll id=\"e" << e.id << "\" dep=\"";
+        put_ids(o, e.deps);
+        o << "\" type=\"ALLREDUCE\" team=\"";
+        for(size_t i=0; i < e.team.size(); i++) {
+          if(i != 0) o << ',';
+          o << e.team[i];
+        }
+        o << "\" size=\"" << e.bytes << "\" epoch=\"" << e.epoch << "\" />\n";
+      }
+    }
+    o << "</events>\n";
+  }
+
+  void write_events(ostream &o, const vector<Event> &evs, bool notes) {
+    XmlEventWriter w(&o);
+    for(const Event &e: evs) {
+      if(e.kind == 0)
+        w.comm(e.id, e.deps.data(), e.deps.size(), e.a, e.b, e.bytes, e.epoch);
+      else if(e.kind == 1)
+        w.comp(e.id, e.deps.data(), e.deps.size(), e.a, e.seconds, e.epoch, notes ? &e.note : nullptr);
+      else
+        w.coll(e.id, e.deps.data(), e.deps.size(), e.team.data(), e.team.size(), e.bytes, e.epoch);
+    }
+    w.finish();
+  }
+
+  template<class F>
+  double seconds_of(const F &f) {
+    auto t0 = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+  }
+}
+
+int main() {
+  const double times[] = {
+    0, 1, 2.5e-06, 0.000125, 3.14159265, 123456, 999999, 1e6, 4.2e7, -0.0, 1e-300, 0.1
+  };
+  const uint32_t ops[] = {TaskNote::intern("relax"), TaskNote::intern("restrict <2>")};
+
+  vector<Event> evs;
+  uint64_t x = 12345;
+  auto next = [&]() { x = x*6364136223846793005u + 1442695040888963407u; return x >> 33; };
+
+  for(uint64_t n=0; n < 300000; n++) {
+    Event e;
+    e.kind = n % 3;
+    e.id = 3*n + e.kind;
+    for(int d = next() % 4; d != 0; d--)
+      e.deps.push_back(next() % (e.id + 1));
+    e.a = int(next() % 512);
+    e.b = int(next() % 512);
+    e.bytes = next() % 100000;
+    e.seconds = n % 5 == 0 ? double(next() % 100000)/7 : times[next() % (sizeof(times)/sizeof(double))];
+    e.epoch = n/10;
+    e.note = TaskNote{ops[n % 2], int(next() % 4), int(next() % 1000)};
+    for(int t = next() % 9; t != 0; t--)
+      e.team.push_back(int(next() % 512));
+    evs.push_back(e);
+  }
+
+  for(bool notes: {false, true}) {
+    ostringstream old_o, new_o;
+    double old_s = seconds_of([&]() { stream_events(old_o, evs, notes); });
+    double new_s = seconds_of([&]() { write_events(new_o, evs, notes); });
+
+    if(old_o.str() != new_o.str())
+      cout << "BAD notes=" << notes << " output differs\n";
+
+    cout << "notes=" << notes
+         << " ostream: " << evs.size()/old_s << " events/s"
+         << " XmlEventWriter: " << evs.size()/new_s << " events/s\n";
+  }
+
+  cout << "done\n";
+  return 0;
+}
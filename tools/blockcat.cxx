@@ -0,0 +1,61 @@
+// Decompresses a compressed event trace (compress=1) to events.xml.
+//
+// usage: blockcat <events.xml.lz> [<first epoch> <last epoch>]
+//   writes the whole trace to stdout, or with an epoch range just the
+//   events whose epoch is in it, decompressing only the blocks that
+//   <events.xml.lz>.idx says can hold them.
+
+#include "blockwriter.hxx"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+using namespace programr;
+using namespace std;
+
+int main(int arg_n, char **args) {
+  if(arg_n != 2 && arg_n != 4) {
+    cerr << "usage: " << args[0] << " <events.xml.lz> [<first epoch> <last epoch>]\n";
+    return 2;
+  }
+
+  ifstream in(args[1], ios::in | ios::binary);
+  if(!in) {
+    cerr << "Could not open file: " << args[1] << '\n';
+    return 1;
+  }
+
+  string err, raw;
+  uint64_t epoch;
+  if(!read_block_header(in, err)) {
+    cerr << args[1] << ": " << err << '\n';
+    return 1;
+  }
+
+  if(arg_n == 2) {
+    while(read_block(in, raw, epoch, err))
+      cout.write(raw.data(), raw.size());
+  }
+  else {
+    uint64_t lo = strtoull(args[2], nullptr, 10);
+    uint64_t hi = strtoull(args[3], nullptr, 10);
+
+    string idx_file = string(args[1]) + ".idx";
+    ifstream idx(idx_file);
+    vector<BlockIndexEntry> blocks;
+    if(!idx || !read_block_index(idx, blocks, err)) {
+      cerr << idx_file << ": " << (idx ? err : "could not open") << '\n';
+      return 1;
+    }
+
+    read_block_window(in, blocks, lo, hi, cout, err);
+  }
+
+  if(!err.empty()) {
+    cerr << args[1] << ": " << err << '\n';
+    return 1;
+  }
+  cout.flush();
+  return cout ? 0 : 1;
+}
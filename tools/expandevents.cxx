@@ -0,0 +1,46 @@
+// Expands a templated event trace (templates=1) to plain events.xml.
+//
+// usage: expandevents <templated.xml> [<events.xml>]
+//   writes to stdout when no output file is given
+
+#include "templatewriter.hxx"
+
+#include <fstream>
+#include <iostream>
+
+using namespace programr;
+using namespace std;
+
+int main(int arg_n, char **args) {
+  if(arg_n < 2 || arg_n > 3) {
+    cerr << "usage: " << args[0] << " <templated.xml> [<events.xml>]\n";
+    return 2;
+  }
+  
+  ifstream in(args[1], ios::in | ios::binary);
+  if(!in) {
+    cerr << "Could not open file: " << args[1] << '\n';
+    return 1;
+  }
+  
+  ofstream out_file;
+  ostream *out = &cout;
+  if(arg_n == 3) {
+    out_file.open(args[2]);
+    if(!out_file) {
+      cerr << "Could not open file: " << args[2] << '\n';
+      return 1;
+    }
+    out = &out_file;
+  }
+  
+  XmlEventWriter xml(out);
+  string err;
+  if(!read_templated_events(in, xml, err)) {
+    cerr << args[1] << ": " << err << '\n';
+    return 1;
+  }
+  
+  out->flush();
+  return *out ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+// Loads event traces into an EventGraph and summarizes them: event and
+// dependency counts per kind, ranks, epochs, teams, bytes moved and
+// compute seconds, plus how fast the files were read. Several files, say
+// the shards of shards=<n>, are read as one trace.
+//
+// usage: traceinfo [-j<threads>] <events.xml|events.bin>...
+
+#include "eventgraph.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sys/stat.h>
+
+using namespace programr;
+using namespace std;
+
+int main(int arg_n, char **args) {
+  int thread_n = 4;
+  int arg = 1;
+  if(arg < arg_n && !strncmp(args[arg], "-j", 2))
+    thread_n = atoi(args[arg++] + 2);
+  if(arg == arg_n || thread_n < 1) {
+    cerr << "usage: " << args[0] << " [-j<threads>] <events.xml|events.bin>...\n";
+    return 2;
+  }
+
+  Workers pool(thread_n);
+  EventGraph g;
+  string err;
+  uint64_t file_bytes = 0;
+
+  auto t0 = chrono::steady_clock::now();
+  for(; arg < arg_n; arg++) {
+    if(!read_event_graph(args[arg], pool, g, err)) {
+      cerr << args[arg] << ": " << err << '\n';
+      return 1;
+    }
+    struct stat st;
+    if(stat(args[arg], &st) == 0)
+      file_bytes += st.st_size;
+  }
+  double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+  uint64_t n[3] = {0, 0, 0}, dep_n[3] = {0, 0, 0}, bytes[3] = {0, 0, 0};
+  double comp_secs = 0;
+  int rank_max = -1;
+  uint64_t epoch_lo = ~uint64_t(0), epoch_hi = 0;
+  for(size_t i=0; i < g.size(); i++) {
+    int k = int(g.kinds[i]);
+    n[k] += 1;
+    dep_n[k] += g.dep_n(i);
+    bytes[k] += g.sizes[i];
+    comp_secs += g.times[i];
+    rank_max = std::max(rank_max, std::max(g.ranks[i], g.peers[i]));
+    epoch_lo = std::min(epoch_lo, g.epochs[i]);
+    epoch_hi = std::max(epoch_hi, g.epochs[i]);
+  }
+  for(uint32_t t=0; t < g.teams.size(); t++) {
+    if(!g.teams.ranks(t).empty())
+      rank_max = std::max(rank_max, g.teams.ranks(t).back());
+  }
+
+  const char *kind_name[3] = {"comp", "comm", "coll"};
+  cout << "events " << g.size() << '\n';
+  for(int k=0; k < 3; k++)
+    cout << kind_name[k] << ' ' << n[k] << " deps " << dep_n[k] << " bytes " << bytes[k] << '\n';
+  cout << "ranks " << rank_max + 1 << '\n';
+  if(g.size() != 0)
+    cout << "epochs " << epoch_lo << ' ' << epoch_hi << '\n';
+  cout << "teams " << g.teams.size() << '\n';
+  cout << "comp seconds " << comp_secs << '\n';
+
+  cerr << "read " << file_bytes << " bytes in " << secs << "s, "
+       << (secs > 0 ? file_bytes/secs/(1<<20) : 0) << " MB/s\n";
+  return 0;
+}
@@ -0,0 +1,42 @@
+// Checks an event trace for dependencies on undefined events, ids
+// defined twice, repeated dependencies and cycles, the same checks
+// KNOB_XML_VERIFY makes while tracing.
+//
+// usage: verifyevents <events.xml|events.bin> [<threads>]
+//   exits 0 if the trace verifies, 1 if not
+
+#include "verifier.hxx"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace programr;
+using namespace std;
+
+int main(int arg_n, char **args) {
+  if(arg_n < 2 || arg_n > 3) {
+    cerr << "usage: " << args[0] << " <events.xml|events.bin> [<threads>]\n";
+    return 2;
+  }
+  int thread_n = arg_n == 3 ? atoi(args[2]) : 4;
+
+  auto t0 = chrono::steady_clock::now();
+
+  Workers pool(thread_n);
+  EventGraph graph;
+  string err;
+  if(!read_event_graph(args[1], pool, graph, err)) {
+    cerr << args[1] << ": " << err << '\n';
+    return 1;
+  }
+
+  auto t1 = chrono::steady_clock::now();
+  VerifyCounts counts = verify_event_graph(graph, pool);
+  auto t2 = chrono::steady_clock::now();
+
+  cerr << counts.event_n << " events, read in "
+       << chrono::duration<double>(t1 - t0).count() << "s, checked in "
+       << chrono::duration<double>(t2 - t1).count() << "s\n";
+  return counts.report(cout) ? 0 : 1;
+}